@@ -36,6 +36,7 @@
 #define DISABLE_JAVASCRIPT		"/apps/liferea/disable-javascript"
 #define SOCIAL_BM_SITE			"/apps/liferea/social-bm-site"
 #define ENABLE_PLUGINS			"/apps/liferea/enable-plugins"
+#define HTML_CACHE_SIZE			"/apps/liferea/html-cache-size"
 
 /* enclosure handling */
 #define ENCLOSURE_DOWNLOAD_TOOL		"/apps/liferea/enclosure-download-tool"
@@ -43,9 +44,20 @@
 
 /* feed handling settings */
 #define DEFAULT_MAX_ITEMS		"/apps/liferea/maxitemcount"
+#define RETENTION_MAX_AGE		"/apps/liferea/retention-max-age"
+#define RETENTION_MAX_DB_SIZE		"/apps/liferea/retention-max-db-size"
 #define DEFAULT_UPDATE_INTERVAL		"/apps/liferea/default-update-interval"
+#define ADAPTIVE_UPDATE			"/apps/liferea/adaptive-update"
 #define STARTUP_FEED_ACTION		"/apps/liferea/startup_feed_action"
 
+/* update processing settings */
+#define UPDATE_FETCH_CONCURRENCY	"/apps/liferea/update-fetch-concurrency"
+#define UPDATE_HOST_CONCURRENCY		"/apps/liferea/update-host-concurrency"
+#define UPDATE_FILTER_CONCURRENCY	"/apps/liferea/update-filter-concurrency"
+#define UPDATE_PARSE_CONCURRENCY	"/apps/liferea/update-parse-concurrency"
+#define UPDATE_COMMAND_TIMEOUT		"/apps/liferea/update-command-timeout"
+#define UPDATE_COMMAND_MAX_OUTPUT	"/apps/liferea/update-command-max-output"
+
 /* folder handling settings */
 #define FOLDER_DISPLAY_MODE		"/apps/liferea/folder-display-mode"
 #define FOLDER_DISPLAY_HIDE_READ	"/apps/liferea/folder-display-hide-read"
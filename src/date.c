@@ -36,7 +36,6 @@
 
 #include "date.h"
 
-#include <locale.h>
 #include <ctype.h>
 #include <string.h>
 
@@ -321,13 +320,49 @@ date_parse_rfc822_tz (char *token)
 	return 60 * ((offset / 100) * 60 + (offset % 100));
 }
 
+static const gchar *date_rfc822_months[] = {
+	"jan", "feb", "mar", "apr", "may", "jun",
+	"jul", "aug", "sep", "oct", "nov", "dec"
+};
+
+/* Returns a copy of the date with the English month name after the
+   day of month replaced by its number, or NULL if there is none.
+   This avoids switching the locale for strptime()'s %b, which is
+   not possible while feeds are parsed in worker threads. */
+static gchar *
+date_rfc822_numeric_month (const gchar *date)
+{
+	const gchar	*pos = date, *name;
+	guint		i;
+
+	while (g_ascii_isspace (*pos))
+		pos++;
+	while (g_ascii_isdigit (*pos))
+		pos++;
+	while (g_ascii_isspace (*pos))
+		pos++;
+
+	name = pos;
+	while (g_ascii_isalpha (*pos))
+		pos++;
+	if (pos - name < 3)
+		return NULL;
+
+	for (i = 0; i < G_N_ELEMENTS (date_rfc822_months); i++) {
+		if (0 == g_ascii_strncasecmp (name, date_rfc822_months[i], 3))
+			return g_strdup_printf ("%.*s%u%s", (int)(name - date), date, i + 1, pos);
+	}
+
+	return NULL;
+}
+
 time_t
 date_parse_RFC822 (const gchar *date)
 {
-	struct tm	tm;
+	struct tm	tm, tmp_tm;
 	time_t		t, t2;
-	char 		*oldlocale;
-	char		*pos;
+	gchar		*numeric;
+	char		*pos = NULL;
 	gboolean	success = FALSE;
 
 	memset (&tm, 0, sizeof (struct tm));
@@ -343,45 +378,43 @@ date_parse_RFC822 (const gchar *date)
 	if (pos)
 		date = ++pos;
 
-	/* we expect English month names, so we set the locale */
-	oldlocale = g_strdup (setlocale (LC_TIME, NULL));
-	setlocale (LC_TIME, "C");
-	
-	/* standard format with seconds and 4 digit year */
-	if (NULL != (pos = strptime ((const char *)date, " %d %b %Y %T", &tm)))
-		success = TRUE;
-	/* non-standard format without seconds and 4 digit year */
-	else if (NULL != (pos = strptime ((const char *)date, " %d %b %Y %H:%M", &tm)))
-		success = TRUE;
-	/* non-standard format with seconds and 2 digit year */
-	else if (NULL != (pos = strptime ((const char *)date, " %d %b %y %T", &tm)))
-		success = TRUE;
-	/* non-standard format without seconds 2 digit year */
-	else if (NULL != (pos = strptime ((const char *)date, " %d %b %y %H:%M", &tm)))
-		success = TRUE;
+	/* we expect English month names, which are converted to numbers */
+	numeric = date_rfc822_numeric_month (date);
+	if (numeric) {
+		/* standard format with seconds and 4 digit year */
+		if (NULL != (pos = strptime (numeric, " %d %m %Y %T", &tm)))
+			success = TRUE;
+		/* non-standard format without seconds and 4 digit year */
+		else if (NULL != (pos = strptime (numeric, " %d %m %Y %H:%M", &tm)))
+			success = TRUE;
+		/* non-standard format with seconds and 2 digit year */
+		else if (NULL != (pos = strptime (numeric, " %d %m %y %T", &tm)))
+			success = TRUE;
+		/* non-standard format without seconds 2 digit year */
+		else if (NULL != (pos = strptime (numeric, " %d %m %y %H:%M", &tm)))
+			success = TRUE;
+	}
 	
 	while (pos && *pos != '\0' && isspace ((int)*pos))       /* skip whitespaces before timezone */
 		pos++;
 	
-	if (oldlocale) {
-		setlocale (LC_TIME, oldlocale);	/* and reset it again */
-		g_free (oldlocale);
-	}
-	
 	if (success) {
 		if ((time_t)(-1) != (t = mktime (&tm))) {
 			/* GMT time, with no daylight savings time
 			   correction. (Usually, there is no daylight savings
 			   time since the input is GMT.) */
 			t = t - date_parse_rfc822_tz (pos);
-			t2 = mktime (gmtime(&t));
+			gmtime_r (&t, &tmp_tm);
+			t2 = mktime (&tmp_tm);
 			t = t - (t2 - t);
+			g_free (numeric);
 			return t;
 		} else {
 			debug0 (DEBUG_PARSING, "internal error! time conversion error! mktime failed!");
 		}
 	}
 	
+	g_free (numeric);
 	return 0;
 }
 
@@ -39,6 +39,32 @@ static sqlite3	*db = NULL;
 /** hash of all prepared statements */
 static GHashTable *statements = NULL;
 
+/** highest item id handed out so far (seeded from the DB on startup) */
+static gulong lastItemId = 0;
+
+/** nesting level of db_begin_transaction() calls */
+static guint transactionDepth = 0;
+
+/** TRUE if the full text index table could be set up */
+static gboolean ftsAvailable = FALSE;
+
+/** item counters of a node as preloaded by db_itemset_load_counters() */
+typedef struct itemsetCounters {
+	guint	itemCount;	/**< number of items of the node */
+	guint	unreadCount;	/**< number of unread items of the node */
+} *itemsetCountersPtr;
+
+/** node id to itemsetCounters cache, only set while preloaded */
+static GHashTable *itemsetCounters = NULL;
+
+/** number of metadata rows written by the multi-row metadata statement */
+#define DB_METADATA_BATCH_ROWS	16
+
+/* item columns as expected by db_load_item_from_columns() */
+#define DB_ITEM_LOAD_COLUMNS	"title,read,updated,popup,marked,source,source_id,valid_guid," \
+				"description,date,comment_feed_id,comment,item_id,parent_item_id," \
+				"node_id,parent_node_id"
+
 static void db_view_remove (const gchar *id);
 
 static void
@@ -116,6 +142,24 @@ db_table_exists (const gchar *name)
 	return (1 == res);
 }
 
+static gboolean
+db_fts_check (void)
+{
+	sqlite3_stmt	*stmt;
+
+	if (!db_table_exists ("items_fts"))
+		return FALSE;
+
+	/* The table might exist while the FTS module is not available */
+	if (SQLITE_OK != sqlite3_prepare_v2 (db, "SELECT docid FROM items_fts WHERE items_fts MATCH 'x'", -1, &stmt, NULL)) {
+		g_warning ("Full text index exists but cannot be used (%s)!", sqlite3_errmsg (db));
+		return FALSE;
+	}
+	sqlite3_finalize (stmt);
+
+	return TRUE;
+}
+
 static void
 db_set_schema_version (gint schemaVersion)
 {
@@ -151,12 +195,18 @@ db_get_schema_version (void)
 	return schemaVersion;
 }
 
+/* Transactions may be nested, only the outermost
+   begin and end do actually affect the DB. */
+
 static void
 db_begin_transaction (void)
 {
 	gchar	*sql, *err;
 	gint	res;
 	
+	if (transactionDepth++ > 0)
+		return;
+
 	sql = sqlite3_mprintf ("BEGIN");
 	res = sqlite3_exec (db, sql, NULL, NULL, &err);
 	if (SQLITE_OK != res) 
@@ -171,6 +221,10 @@ db_end_transaction (void)
 	gchar	*sql, *err;
 	gint	res;
 	
+	g_assert (transactionDepth > 0);
+	if (--transactionDepth > 0)
+		return;
+
 	sql = sqlite3_mprintf ("END");
 	res = sqlite3_exec (db, sql, NULL, NULL, &err);
 	if (SQLITE_OK != res) 
@@ -246,7 +300,53 @@ db_open (void)
 	db_exec("PRAGMA synchronous=NORMAL");
 }
 
-#define SCHEMA_TARGET_VERSION 9
+#define SCHEMA_TARGET_VERSION 10
+
+static int
+db_init_item_id_cb (void *user_data,
+                    int count,
+		    char **values,
+		    char **columns) 
+{
+	g_assert(NULL != values);
+
+	/* the result in *values should be MAX(item_id),
+	   an empty table causes no result in values[0]... */
+	if(values[0])
+		lastItemId = atol(values[0]); 
+	else
+		lastItemId = 0;
+
+	return 0;
+}
+
+/* Item ids are handed out from an in-memory counter that is
+   seeded once here, so inserting does not need a MAX() scan. */
+static void
+db_init_item_id (void) 
+{
+	gchar	*sql, *err;
+	gint	res;
+	
+	sql = sqlite3_mprintf ("SELECT MAX(item_id) FROM items");
+	res = sqlite3_exec (db, sql, db_init_item_id_cb, NULL, &err);
+	if (SQLITE_OK != res) 
+		g_warning ("Select failed (%s) SQL: %s", err, sql);
+	sqlite3_free (sql);
+	sqlite3_free (err);
+
+	debug1 (DEBUG_DB, "highest item id is %lu", lastItemId);
+}
+
+/* SQL function hashing the contents of existing items on migration */
+static void
+db_item_content_hash_func (sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	gchar	*hash;
+
+	hash = item_get_content_hash ((const gchar *)sqlite3_value_text (argv[0]), (const gchar *)sqlite3_value_text (argv[1]));
+	sqlite3_result_text (context, hash, -1, g_free);
+}
 
 /* opening or creation of database */
 void
@@ -254,6 +354,8 @@ db_init (void)
 {
 	gint		res;
 	GError          *error;
+	GString		*sql;
+	guint		i;
 		
 	debug_enter ("db_init");
 
@@ -416,6 +518,17 @@ db_init (void)
 				sqlite3_finalize (stmt);
 			}
 		}
+
+		if (db_get_schema_version () == 9) {
+			/* adding the content hash used for merging to the items relation */
+			debug0 (DEBUG_DB, "migrating from schema version 9 to 10 (hashing item contents)");
+			sqlite3_create_function (db, "item_content_hash", 2, SQLITE_UTF8, NULL, db_item_content_hash_func, NULL, NULL);
+			db_exec ("BEGIN; "
+			         "ALTER TABLE items ADD COLUMN content_hash TEXT; "
+			         "UPDATE items SET content_hash = item_content_hash(title, description); "
+			         "REPLACE INTO info (name, value) VALUES ('schemaVersion',10); "
+			         "END;");
+		}
 	}
 
 	if (SCHEMA_TARGET_VERSION != db_get_schema_version ())
@@ -448,6 +561,7 @@ db_init (void)
         	 "   date		INTEGER,"
         	 "   comment_feed_id	TEXT,"
 		 "   comment            INTEGER,"
+		 "   content_hash	TEXT,"
 		 "   PRIMARY KEY (item_id)"
         	 ");");
 
@@ -457,6 +571,7 @@ db_init (void)
 	db_exec ("CREATE INDEX items_idx4 ON items (item_id);");
 	db_exec ("CREATE INDEX items_idx5 ON items (parent_item_id);");
 	db_exec ("CREATE INDEX items_idx6 ON items (parent_node_id);");
+	db_exec ("CREATE INDEX items_idx7 ON items (date);");
 		
 	db_exec ("CREATE TABLE metadata ("
         	 "   item_id		INTEGER,"
@@ -467,6 +582,7 @@ db_init (void)
         	 ");");
 
 	db_exec ("CREATE INDEX metadata_idx ON metadata (item_id);");
+	db_exec ("CREATE INDEX metadata_idx2 ON metadata (key);");
 		
 	db_exec ("CREATE TABLE subscription ("
         	 "   node_id            STRING,"
@@ -508,6 +624,40 @@ db_init (void)
 		 "   PRIMARY KEY (node_id, item_id)"
 		 ");");
 
+	db_exec ("CREATE INDEX search_folder_items_idx ON search_folder_items (item_id);");
+
+	/* Persistent cache of rendered item HTML. The access column
+	   holds a sequence number for LRU expiration. */
+	db_exec ("CREATE TABLE html_cache ("
+	         "   item_id		INTEGER,"
+	         "   render_key		TEXT,"
+	         "   size		INTEGER,"
+	         "   access		INTEGER,"
+	         "   html		TEXT,"
+	         "   PRIMARY KEY (item_id, render_key)"
+	         ");");
+
+	db_exec ("CREATE INDEX html_cache_idx ON html_cache (access, size);");
+
+	/* Full text index of item titles and descriptions used by search
+	   folder text rules. It depends on the SQLite FTS3 module being
+	   available, without it text rules fall back to LIKE matching. 
+	   The removal trigger is never dropped so that the cleanup
+	   below keeps the index consistent too. */
+	if (!db_table_exists ("items_fts")) {
+		if (SQLITE_OK == sqlite3_exec (db, "CREATE VIRTUAL TABLE items_fts USING fts3 (title, description);", NULL, NULL, NULL)) {
+			debug0 (DEBUG_DB, "Creating full text index...");
+			db_exec ("INSERT INTO items_fts (docid, title, description) SELECT item_id, title, description FROM items;");
+			db_exec ("CREATE TRIGGER item_fts_removal DELETE ON items "
+			         "BEGIN "
+			         "   DELETE FROM items_fts WHERE docid = old.item_id; "
+			         "END;");
+		} else {
+			debug0 (DEBUG_DB, "No FTS3 support, full text index disabled.");
+		}
+	}
+	ftsAvailable = db_fts_check ();
+
 	db_end_transaction ();
 	debug_end_measurement (DEBUG_DB, "table setup");
 		
@@ -516,6 +666,12 @@ db_init (void)
 	db_exec ("DROP TRIGGER item_update;");
 	db_exec ("DROP TRIGGER item_removal;");
 	db_exec ("DROP TRIGGER subscription_removal;");
+	db_exec ("DROP TRIGGER html_cache_item_insert;");
+	db_exec ("DROP TRIGGER html_cache_duplicate_insert;");
+	db_exec ("DROP TRIGGER html_cache_item_update;");
+	db_exec ("DROP TRIGGER html_cache_item_removal;");
+	db_exec ("DROP TRIGGER html_cache_comment_insert;");
+	db_exec ("DROP TRIGGER html_cache_comment_removal;");
 		
 	/* 3. Cleanup of DB */
 
@@ -554,12 +710,58 @@ db_init (void)
 		 "   DELETE FROM subscription_metadata WHERE node_id = old.node_id; "
         	 "END;");
 
+	/* Cached renderings become invalid with any change of the item
+	   (db_item_update() does REPLACE, so the insert trigger catches
+	   it) and with new duplicates of it, which are listed in the
+	   rendering. Comments are part of the rendering of their parent
+	   item too. Popup status changes do not affect the rendering. */
+	db_exec ("CREATE TRIGGER html_cache_item_insert AFTER INSERT ON items "
+	         "BEGIN "
+	         "   DELETE FROM html_cache WHERE item_id = new.item_id; "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER html_cache_duplicate_insert AFTER INSERT ON items WHEN new.valid_guid = 1 "
+	         "BEGIN "
+	         "   DELETE FROM html_cache WHERE item_id IN "
+	         "      (SELECT item_id FROM items WHERE source_id = new.source_id); "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER html_cache_item_update AFTER UPDATE OF title, read, updated, marked, source, description, date ON items "
+	         "BEGIN "
+	         "   DELETE FROM html_cache WHERE item_id = old.item_id; "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER html_cache_item_removal DELETE ON items "
+	         "BEGIN "
+	         "   DELETE FROM html_cache WHERE item_id = old.item_id; "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER html_cache_comment_insert AFTER INSERT ON items WHEN new.comment = 1 "
+	         "BEGIN "
+	         "   DELETE FROM html_cache WHERE item_id = new.parent_item_id; "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER html_cache_comment_removal DELETE ON items WHEN old.comment = 1 "
+	         "BEGIN "
+	         "   DELETE FROM html_cache WHERE item_id = old.parent_item_id; "
+	         "END;");
+
 	/* Note: view counting triggers are set up in the view preparation code (see db_view_create()) */		
+
+	/* 5. Seed the item id counter */
+	db_init_item_id ();
+
+	/* 6. Connection local table for sorting the item list */
+	db_exec ("CREATE TEMP TABLE item_list_ids (item_id INTEGER PRIMARY KEY);");
+
 	/* prepare statements */
 	
 	db_new_statement ("itemsetLoadStmt",
 	                  "SELECT item_id FROM items WHERE node_id = ?");
 
+	db_new_statement ("itemsetLoadMergeInfoStmt",
+	                  "SELECT item_id,source_id,content_hash,read,marked,date FROM items WHERE node_id = ?");
+
 	db_new_statement ("itemsetLoadOffsetStmt",
 			  "SELECT item_id FROM items WHERE item_id >= ? limit ?");
 		       
@@ -570,6 +772,13 @@ db_init (void)
 	db_new_statement ("itemsetItemCountStmt",
 	                  "SELECT COUNT(*) FROM items "
 		          "WHERE node_id = ?");
+
+	db_new_statement ("itemsCountStmt",
+	                  "SELECT COUNT(*) FROM items");
+
+	db_new_statement ("itemsetCountersLoadStmt",
+	                  "SELECT node_id, COUNT(*), SUM(read = 0) FROM items "
+		          "GROUP BY node_id");
 		       
 	db_new_statement ("itemsetRemoveStmt",
 	                  "DELETE FROM items WHERE item_id = ? OR (comment = 1 AND parent_item_id = ?)");
@@ -577,28 +786,15 @@ db_init (void)
 	db_new_statement ("itemsetRemoveAllStmt",
 	                  "DELETE FROM items WHERE node_id = ? OR (comment = 1 AND parent_node_id = ?)");
 
+	db_new_statement ("itemsetExcessItemsStmt",
+	                  "SELECT item_id FROM items "
+	                  "WHERE node_id = ? AND marked = 0 ORDER BY date,item_id LIMIT ?");
+
 	db_new_statement ("itemsetMarkAllPopupStmt",
 	                  "UPDATE items SET popup = 0 WHERE node_id = ?");
 
 	db_new_statement ("itemLoadStmt",
-	                  "SELECT "
-	                  "title,"
-	                  "read,"
-	                  "updated,"
-	                  "popup,"
-	                  "marked,"
-	                  "source,"
-	                  "source_id,"
-	                  "valid_guid,"
-	                  "description,"
-	                  "date,"
-		          "comment_feed_id,"
-		          "comment,"
-		          "item_id,"
-			  "parent_item_id, "
-		          "node_id, "
-			  "parent_node_id "
-	                  " FROM items WHERE item_id = ?");      
+	                  "SELECT " DB_ITEM_LOAD_COLUMNS " FROM items WHERE item_id = ?");
 	
 	db_new_statement ("itemUpdateStmt",
 	                  "REPLACE INTO items ("
@@ -617,8 +813,9 @@ db_init (void)
 	                  "item_id,"
 	                  "parent_item_id,"
 	                  "node_id,"
-	                  "parent_node_id"
-	                  ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
+	                  "parent_node_id,"
+	                  "content_hash"
+	                  ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
 			
 	db_new_statement ("itemStateUpdateStmt",
 			  "UPDATE items SET read=?, marked=?, updated=? "
@@ -639,6 +836,24 @@ db_init (void)
 			
 	db_new_statement ("metadataUpdateStmt",
 	                  "REPLACE INTO metadata (item_id,nr,key,value) VALUES (?,?,?,?)");
+
+	/* multi-row variant using compound SELECT as multi-row VALUES needs SQLite 3.7.11 */
+	sql = g_string_new ("REPLACE INTO metadata (item_id,nr,key,value) SELECT ?,?,?,?");
+	for (i = 1; i < DB_METADATA_BATCH_ROWS; i++)
+		g_string_append (sql, " UNION ALL SELECT ?,?,?,?");
+	db_new_statement ("metadataBatchUpdateStmt", sql->str);
+	g_string_free (sql, TRUE);
+
+	db_new_statement ("metadataRemoveStmt",
+	                  "DELETE FROM metadata WHERE item_id = ?");
+
+	if (ftsAvailable) {
+		db_new_statement ("itemFtsInsertStmt",
+		                  "INSERT INTO items_fts (docid,title,description) VALUES (?,?,?)");
+
+		db_new_statement ("itemFtsRemoveStmt",
+		                  "DELETE FROM items_fts WHERE docid = ?");
+	}
 			
 	db_new_statement ("subscriptionUpdateStmt",
 	                  "REPLACE INTO subscription ("
@@ -672,6 +887,9 @@ db_init (void)
 			
 	db_new_statement ("subscriptionMetadataUpdateStmt",
 	                  "REPLACE INTO subscription_metadata (node_id,nr,key,value) VALUES (?,?,?,?)");
+
+	db_new_statement ("subscriptionMetadataRemoveStmt",
+	                  "DELETE FROM subscription_metadata WHERE node_id = ?");
 	
 	db_new_statement ("nodeUpdateStmt",
 	                  "REPLACE INTO node (node_id,parent_id,title,type,expanded,view_mode,sort_column,sort_reversed) VALUES (?,?,?,?,?,?,?,?)");
@@ -681,7 +899,39 @@ db_init (void)
 	                  
 	db_new_statement ("searchFolderLoadStmt",
 	                  "SELECT item_id FROM search_folder_items WHERE node_id = ?;");
+
+	db_new_statement ("searchFolderLoadUnreadStmt",
+	                  "SELECT search_folder_items.item_id FROM search_folder_items "
+	                  "INNER JOIN items ON items.item_id = search_folder_items.item_id "
+	                  "WHERE search_folder_items.node_id = ? AND items.read = 0;");
 			  
+	db_new_statement ("itemListIdsClearStmt",
+	                  "DELETE FROM item_list_ids");
+
+	db_new_statement ("itemListIdsInsertStmt",
+	                  "INSERT OR IGNORE INTO item_list_ids (item_id) VALUES (?)");
+
+	db_new_statement ("htmlCacheLoadStmt",
+	                  "SELECT html,access FROM html_cache WHERE item_id = ? AND render_key = ?");
+
+	db_new_statement ("htmlCacheTouchStmt",
+	                  "UPDATE html_cache SET access = ? WHERE item_id = ? AND render_key = ?");
+
+	db_new_statement ("htmlCacheStoreStmt",
+	                  "REPLACE INTO html_cache (item_id,render_key,size,access,html) VALUES (?,?,?,?,?)");
+
+	db_new_statement ("htmlCacheSizeStmt",
+	                  "SELECT total(size),max(access) FROM html_cache");
+
+	db_new_statement ("htmlCacheAccessStmt",
+	                  "SELECT access,size FROM html_cache ORDER BY access");
+
+	db_new_statement ("htmlCacheRemoveStmt",
+	                  "DELETE FROM html_cache WHERE item_id = ?");
+
+	db_new_statement ("htmlCacheExpireStmt",
+	                  "DELETE FROM html_cache WHERE access <= ?");
+
 	g_assert (sqlite3_get_autocommit (db));
 	
 	debug_exit ("db_init");
@@ -702,6 +952,8 @@ db_deinit (void)
 	if (FALSE == sqlite3_get_autocommit (db))
 		g_warning ("Fatal: DB not in auto-commit mode. This is a bug. Data may be lost!");
 	
+	db_itemset_unload_counters ();
+
 	if (statements) {
 		g_hash_table_foreach (statements, db_free_statements, NULL);
 		g_hash_table_destroy (statements);	
@@ -716,21 +968,35 @@ db_deinit (void)
 	debug_exit ("db_deinit");
 }
 
-static GSList *
-db_metadata_list_append (GSList *metadata, const char *key, const char *value)
+void
+db_begin_batch (void)
+{
+	db_begin_transaction ();
+}
+
+void
+db_end_batch (void)
+{
+	db_end_transaction ();
+}
+
+/* Values in the DB were checked when added, so they are
+   copied from the statement into the list unchanged */
+static metadataListPtr
+db_metadata_list_append (metadataListPtr metadata, const char *key, const char *value, gint length)
 {
 	if (metadata_is_type_registered (key))
-		metadata = metadata_list_append (metadata, key, value);
+		metadata = metadata_list_append_checked (metadata, key, value, length);
 	else
 		debug1 (DEBUG_DB, "Trying to load unregistered metadata type %s from DB.", key);
 
 	return metadata;
 }
 
-static GSList *
+static metadataListPtr
 db_item_metadata_load(itemPtr item) 
 {
-	GSList		*metadata = NULL;
+	metadataListPtr	metadata = NULL;
 	sqlite3_stmt 	*stmt;
 	gint		res;
 
@@ -745,7 +1011,7 @@ db_item_metadata_load(itemPtr item)
 		value = sqlite3_column_text(stmt, 1);
 		if (g_str_equal (key, "enclosure"))
 			item->hasEnclosure = TRUE;
-		metadata = db_metadata_list_append (metadata, key, value); 
+		metadata = db_metadata_list_append (metadata, key, value, sqlite3_column_bytes (stmt, 1)); 
 	}
 
 	return metadata;
@@ -771,16 +1037,57 @@ db_item_metadata_update_cb (const gchar *key,
 		g_warning ("Update in \"metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 }
 
+static void
+db_item_metadata_collect_cb (const gchar *key,
+                             const gchar *value,
+                             guint index,
+                             gpointer user_data) 
+{
+	GPtrArray	*rows = (GPtrArray *)user_data;
+
+	g_ptr_array_add (rows, (gpointer)key);
+	g_ptr_array_add (rows, (gpointer)value);
+}
+
 static void
 db_item_metadata_update(itemPtr item) 
 {
-	metadata_list_foreach(item->metadata, db_item_metadata_update_cb, item);
+	sqlite3_stmt	*stmt;
+	GPtrArray	*rows;
+	guint		count, i, j;
+	gint		res;
+
+	/* Collect all key/value pairs and write them with as few 
+	   multi-row statements as possible, the remainder is written
+	   row by row. Indices are 1-based as in metadata_list_foreach() */
+	rows = g_ptr_array_new ();
+	metadata_list_foreach (item->metadata, db_item_metadata_collect_cb, rows);
+	count = rows->len / 2;
+
+	for (i = 0; i + DB_METADATA_BATCH_ROWS <= count; i += DB_METADATA_BATCH_ROWS) {
+		stmt = db_get_statement ("metadataBatchUpdateStmt");
+		for (j = 0; j < DB_METADATA_BATCH_ROWS; j++) {
+			sqlite3_bind_int  (stmt, 4*j + 1, item->id);
+			sqlite3_bind_int  (stmt, 4*j + 2, i + j + 1);
+			sqlite3_bind_text (stmt, 4*j + 3, g_ptr_array_index (rows, 2*(i + j)), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_text (stmt, 4*j + 4, g_ptr_array_index (rows, 2*(i + j) + 1), -1, SQLITE_TRANSIENT);
+		}
+		res = sqlite3_step (stmt);
+		if (SQLITE_DONE != res) 
+			g_warning ("Update in \"metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	}
+
+	for (; i < count; i++)
+		db_item_metadata_update_cb (g_ptr_array_index (rows, 2*i), g_ptr_array_index (rows, 2*i + 1), i + 1, item);
+
+	g_ptr_array_free (rows, TRUE);
 }
 
 /* Item structure loading methods */
 
+/* Loads the item attributes except the metadata */
 static itemPtr
-db_load_item_from_columns (sqlite3_stmt *stmt) 
+db_load_item_columns (sqlite3_stmt *stmt) 
 {
 	const gchar	*tmp;
 
@@ -812,6 +1119,14 @@ db_load_item_from_columns (sqlite3_stmt *stmt)
 	else
 		item->description = g_strdup ("");
 
+	return item;
+}
+
+static itemPtr
+db_load_item_from_columns (sqlite3_stmt *stmt) 
+{
+	itemPtr item = db_load_item_columns (stmt);
+
 	item->metadata = db_item_metadata_load (item);
 
 	return item;
@@ -839,6 +1154,34 @@ db_itemset_load (const gchar *id)
 	return itemSet;
 }
 
+GList *
+db_itemset_load_merge_info (const gchar *id)
+{
+	sqlite3_stmt	*stmt;
+	GList		*infos = NULL;
+
+	debug1 (DEBUG_DB, "loading merge info for node \"%s\"", id);
+
+	stmt = db_get_statement ("itemsetLoadMergeInfoStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		itemMergeInfoPtr info = g_new0 (struct itemMergeInfo, 1);
+		info->id = sqlite3_column_int (stmt, 0);
+		info->sourceId = g_strdup (sqlite3_column_text (stmt, 1));
+		/* a missing hash never matches, so the item is updated once */
+		info->contentHash = g_strdup (sqlite3_column_text (stmt, 2)?(const gchar *)sqlite3_column_text (stmt, 2):"");
+		info->readStatus = sqlite3_column_int (stmt, 3)?TRUE:FALSE;
+		info->flagStatus = sqlite3_column_int (stmt, 4)?TRUE:FALSE;
+		info->time = sqlite3_column_int (stmt, 5);
+		infos = g_list_prepend (infos, info);
+	}
+
+	debug0 (DEBUG_DB, "loading of merge info finished");
+
+	return g_list_reverse (infos);
+}
+
 itemPtr
 db_item_load (gulong id) 
 {
@@ -863,45 +1206,104 @@ db_item_load (gulong id)
 	return item;
 }
 
-/* Item modification methods */
+/* number of item ids per statement in db_items_load_many()
+   and db_items_remove_many() */
+#define DB_ITEMS_BATCH_IDS	500
 
-static int
-db_item_set_id_cb (void *user_data,
-                   int count,
-		   char **values,
-		   char **columns) 
+/* Loads a batch of items with one items and one metadata query */
+static void
+db_items_load_batch (const gulong *ids, guint count, GHashTable *items)
 {
-	itemPtr	item = (itemPtr)user_data;
-	
-	g_assert(NULL != values);
-
-	if(values[0]) {
-		/* the result in *values should be MAX(item_id),
-		   so adding one should give a unique new id */
-		item->id = 1 + atol(values[0]); 
+	sqlite3_stmt	*stmt;
+	GString		*idList;
+	gchar		*sql;
+	itemPtr		item = NULL;
+	guint		i;
+
+	idList = g_string_new (NULL);
+	for (i = 0; i < count; i++)
+		g_string_append_printf (idList, "%s%lu", i?",":"", ids[i]);
+
+	sql = g_strdup_printf ("SELECT " DB_ITEM_LOAD_COLUMNS " FROM items WHERE item_id IN (%s)", idList->str);
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			item = db_load_item_columns (stmt);
+			g_hash_table_insert (items, GUINT_TO_POINTER (item->id), item);
+		}
+		sqlite3_finalize (stmt);
 	} else {
-		/* empty table causes no result in values[0]... */
-		item->id = 1;
+		g_warning ("Loading items failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
 	}
-	
-	debug2(DEBUG_DB, "new item id=%lu for \"%s\"", item->id, item->title);
-	return 0;
+	g_free (sql);
+
+	/* Metadata rows are sorted by item, so the item
+	   needs to be looked up only when the item changes */
+	item = NULL;
+	sql = g_strdup_printf ("SELECT item_id,key,value FROM metadata WHERE item_id IN (%s) ORDER BY item_id,nr", idList->str);
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			gulong		id = sqlite3_column_int (stmt, 0);
+			const char	*key = sqlite3_column_text (stmt, 1);
+
+			if (!item || item->id != id)
+				item = g_hash_table_lookup (items, GUINT_TO_POINTER (id));
+			if (!item || !key)
+				continue;
+
+			if (g_str_equal (key, "enclosure"))
+				item->hasEnclosure = TRUE;
+			item->metadata = db_metadata_list_append (item->metadata, key, sqlite3_column_text (stmt, 2), sqlite3_column_bytes (stmt, 2));
+		}
+		sqlite3_finalize (stmt);
+	} else {
+		g_warning ("Loading item metadata failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
+	}
+	g_free (sql);
+
+	g_string_free (idList, TRUE);
+}
+
+GSList *
+db_items_load_many (const gulong *ids, guint count)
+{
+	GHashTable	*items;
+	GSList		*result = NULL;
+	guint		i;
+
+	debug1 (DEBUG_DB, "loading %u items", count);
+	debug_start_measurement (DEBUG_DB);
+
+	items = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < count; i += DB_ITEMS_BATCH_IDS)
+		db_items_load_batch (ids + i, MIN (count - i, DB_ITEMS_BATCH_IDS), items);
+
+	/* Return the items in the requested order, each item only once */
+	for (i = count; i > 0; i--) {
+		itemPtr item = g_hash_table_lookup (items, GUINT_TO_POINTER (ids[i - 1]));
+		if (item) {
+			g_hash_table_remove (items, GUINT_TO_POINTER (ids[i - 1]));
+			result = g_slist_prepend (result, item);
+		}
+	}
+
+	g_hash_table_destroy (items);
+
+	debug_end_measurement (DEBUG_DB, "items load");
+
+	return result;
 }
 
+/* Item modification methods */
+
 static void
 db_item_set_id (itemPtr item) 
 {
-	gchar	*sql, *err;
-	gint	res;
-	
 	g_assert (0 == item->id);
 	
-	sql = sqlite3_mprintf ("SELECT MAX(item_id) FROM items");
-	res = sqlite3_exec (db, sql, db_item_set_id_cb, item, &err);
-	if (SQLITE_OK != res) 
-		g_warning ("Select failed (%s) SQL: %s", err, sql);
-	sqlite3_free (sql);
-	sqlite3_free (err);
+	item->id = ++lastItemId;
+	
+	debug2(DEBUG_DB, "new item id=%lu for \"%s\"", item->id, item->title);
 }
 
 static void
@@ -930,11 +1332,36 @@ db_item_search_folders_update (itemPtr item)
 	g_slist_free (iter);
 }
 
+static void
+db_item_fts_update (itemPtr item, gboolean isNew)
+{
+	sqlite3_stmt	*stmt;
+
+	if (!ftsAvailable)
+		return;
+
+	if (!isNew) {
+		stmt = db_get_statement ("itemFtsRemoveStmt");
+		sqlite3_bind_int (stmt, 1, item->id);
+		if (SQLITE_DONE != sqlite3_step (stmt))
+			g_warning ("full text index removal failed (%s)", sqlite3_errmsg (db));
+	}
+
+	stmt = db_get_statement ("itemFtsInsertStmt");
+	sqlite3_bind_int  (stmt, 1, item->id);
+	sqlite3_bind_text (stmt, 2, item->title, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, item->description, -1, SQLITE_TRANSIENT);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		g_warning ("full text index update failed (%s)", sqlite3_errmsg (db));
+}
+
 void
 db_item_update (itemPtr item) 
 {
 	sqlite3_stmt	*stmt;
+	gchar		*contentHash;
 	gint		res;
+	gboolean	isNew = FALSE;
 	
 	debug2 (DEBUG_DB, "update of item \"%s\" (id=%lu)", item->title, item->id);
 	debug_start_measurement (DEBUG_DB);
@@ -943,8 +1370,15 @@ db_item_update (itemPtr item)
 
 	if (!item->id) {
 		db_item_set_id (item);
+		isNew = TRUE;
 
 		debug1(DEBUG_DB, "insert into table \"items\": \"%s\"", item->title);	
+	} else {
+		/* drop old metadata, the new list might be shorter */
+		stmt = db_get_statement ("metadataRemoveStmt");
+		sqlite3_bind_int (stmt, 1, item->id);
+		if (SQLITE_DONE != sqlite3_step (stmt))
+			g_warning ("item metadata removal failed (%s)", sqlite3_errmsg (db));
 	}
 
 	/* Update the item... */
@@ -965,6 +1399,8 @@ db_item_update (itemPtr item)
 	sqlite3_bind_int  (stmt, 14, item->parentItemId);
 	sqlite3_bind_text (stmt, 15, item->nodeId, -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text (stmt, 16, item->parentNodeId, -1, SQLITE_TRANSIENT);
+	contentHash = item_get_content_hash (item_get_title (item), item_get_description (item));
+	sqlite3_bind_text (stmt, 17, contentHash, -1, g_free);
 
 	res = sqlite3_step (stmt);
 
@@ -972,7 +1408,11 @@ db_item_update (itemPtr item)
 		g_warning ("item update failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 	
 	db_item_metadata_update (item);
-	db_item_search_folders_update (item);
+	db_item_fts_update (item, isNew);
+
+	/* a new item cannot be in any search folder yet */
+	if (!isNew)
+		db_item_search_folders_update (item);
 	
 	db_end_transaction ();
 
@@ -1022,76 +1462,555 @@ db_item_remove (gulong id)
 		g_warning ("item remove failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 }
 
-GSList * 
-db_item_get_duplicates (const gchar *guid) 
+guint
+db_items_remove_many (const gulong *ids, guint count)
 {
-	GSList		*duplicates = NULL;
-	sqlite3_stmt	*stmt;
-	gint		res;
+	GString		*idList;
+	gchar		*sql;
+	guint		i, j, removed = 0;
 
+	debug1 (DEBUG_DB, "removing %u items", count);
 	debug_start_measurement (DEBUG_DB);
 
-	stmt = db_get_statement ("duplicatesFindStmt");
-	res = sqlite3_bind_text (stmt, 1, guid, -1, SQLITE_TRANSIENT);
-	if (SQLITE_OK != res)
-		g_error ("db_item_get_duplicates: sqlite bind failed (error code %d)!", res);
-
-	while (sqlite3_step (stmt) == SQLITE_ROW) 
-	{
-		gulong id = sqlite3_column_int (stmt, 0);
-		duplicates = g_slist_append (duplicates, GUINT_TO_POINTER (id));
+	for (i = 0; i < count; i += DB_ITEMS_BATCH_IDS) {
+		idList = g_string_new (NULL);
+		for (j = i; j < MIN (count, i + DB_ITEMS_BATCH_IDS); j++)
+			g_string_append_printf (idList, "%s%lu", (j > i)?",":"", ids[j]);
+
+		/* Comments of the items go with them, metadata, FTS
+		   and HTML cache rows are removed by triggers */
+		sql = g_strdup_printf ("DELETE FROM items WHERE item_id IN (%s) OR (comment = 1 AND parent_item_id IN (%s))", idList->str, idList->str);
+		if (SQLITE_OK == sqlite3_exec (db, sql, NULL, NULL, NULL))
+			removed += sqlite3_changes (db);
+		else
+			g_warning ("Removing items failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
+		g_free (sql);
+
+		sql = g_strdup_printf ("DELETE FROM search_folder_items WHERE item_id IN (%s)", idList->str);
+		db_exec (sql);
+		g_free (sql);
+
+		g_string_free (idList, TRUE);
 	}
 
-	debug_end_measurement (DEBUG_DB, "searching for duplicates");
-	
-	return duplicates;
+	debug_end_measurement (DEBUG_DB, "items remove");
+
+	return removed;
 }
 
-GSList *
-db_item_get_duplicate_nodes (const gchar *guid)
+GArray *
+db_itemset_get_excess_items (const gchar *id, guint max, guint limit)
 {
-	GSList		*duplicates = NULL;
 	sqlite3_stmt	*stmt;
-	gint		res;
+	GArray		*ids;
+	guint		count = 0;
 
-	debug_start_measurement (DEBUG_DB);
+	ids = g_array_new (FALSE, FALSE, sizeof (gulong));
 
-	stmt = db_get_statement ("duplicateNodesFindStmt");
-	res = sqlite3_bind_text (stmt, 1, guid, -1, SQLITE_TRANSIENT);
-	if (SQLITE_OK != res)
-		g_error ("db_item_get_duplicates: sqlite bind failed (error code %d)!", res);
+	stmt = db_get_statement ("itemsetItemCountStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		count = sqlite3_column_int (stmt, 0);
+	sqlite3_reset (stmt);
 
-	while (sqlite3_step (stmt) == SQLITE_ROW) 
-	{
-		gchar *id = g_strdup( sqlite3_column_text (stmt, 0));
-		duplicates = g_slist_append (duplicates, id);
+	if (count <= max)
+		return ids;
+
+	/* Flagged items count for the limit but are never returned */
+	stmt = db_get_statement ("itemsetExcessItemsStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int (stmt, 2, MIN (count - max, limit));
+	while (SQLITE_ROW == sqlite3_step (stmt)) {
+		gulong itemId = sqlite3_column_int (stmt, 0);
+		g_array_append_val (ids, itemId);
 	}
+	sqlite3_reset (stmt);
 
-	debug_end_measurement (DEBUG_DB, "searching for duplicates");
-	
-	return duplicates;
+	debug3 (DEBUG_DB, "%u items in item set %s exceed the limit of %u", ids->len, id, max);
+
+	return ids;
 }
 
-void 
-db_itemset_remove_all (const gchar *id) 
+GArray *
+db_items_get_oldest (glong before, GSList *excludeNodeIds, guint limit, GHashTable *nodeIds)
 {
 	sqlite3_stmt	*stmt;
-	gint		res;
-	
-	debug1(DEBUG_DB, "removing all items for item set with %s", id);
-		
-	stmt = db_get_statement ("itemsetRemoveAllStmt");
-	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
-	sqlite3_bind_text (stmt, 2, id, -1, SQLITE_TRANSIENT);
-	res = sqlite3_step (stmt);
+	GString		*sql;
+	GSList		*iter;
+	GArray		*ids;
 
-	if (SQLITE_DONE != res)
-		g_warning ("removing all items failed (error code=%d, %s)", res, sqlite3_errmsg (db));
-}
+	ids = g_array_new (FALSE, FALSE, sizeof (gulong));
 
-void 
-db_itemset_mark_all_popup (const gchar *id) 
-{
+	debug_start_measurement (DEBUG_DB);
+
+	/* Comments are removed with their parent item */
+	sql = g_string_new (NULL);
+	g_string_append_printf (sql, "SELECT item_id,node_id FROM items WHERE marked = 0 AND comment IS NOT 1 AND date < %ld", before);
+	if (excludeNodeIds) {
+		g_string_append (sql, " AND node_id NOT IN (");
+		for (iter = excludeNodeIds; iter; iter = g_slist_next (iter)) {
+			gchar *quoted = sqlite3_mprintf ("%Q", (gchar *)iter->data);
+			g_string_append_printf (sql, "%s%s", (iter == excludeNodeIds)?"":",", quoted);
+			sqlite3_free (quoted);
+		}
+		g_string_append (sql, ")");
+	}
+	g_string_append_printf (sql, " ORDER BY date,item_id LIMIT %u", limit);
+
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql->str, -1, &stmt, NULL)) {
+		while (SQLITE_ROW == sqlite3_step (stmt)) {
+			gulong		id = sqlite3_column_int (stmt, 0);
+			const char	*nodeId = sqlite3_column_text (stmt, 1);
+
+			g_array_append_val (ids, id);
+			if (nodeIds && nodeId && !g_hash_table_lookup (nodeIds, nodeId))
+				g_hash_table_insert (nodeIds, g_strdup (nodeId), GINT_TO_POINTER (1));
+		}
+		sqlite3_finalize (stmt);
+	} else {
+		g_warning ("Finding oldest items failed (%s) SQL: %s", sqlite3_errmsg (db), sql->str);
+	}
+	g_string_free (sql, TRUE);
+
+	debug_end_measurement (DEBUG_DB, "oldest items");
+
+	return ids;
+}
+
+static gint64
+db_get_pragma (const gchar *name)
+{
+	sqlite3_stmt	*stmt;
+	gchar		*sql;
+	gint64		value = 0;
+
+	sql = g_strdup_printf ("PRAGMA %s", name);
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		if (SQLITE_ROW == sqlite3_step (stmt))
+			value = sqlite3_column_int64 (stmt, 0);
+		sqlite3_finalize (stmt);
+	}
+	g_free (sql);
+
+	return value;
+}
+
+gint64
+db_get_used_size (void)
+{
+	return (db_get_pragma ("page_count") - db_get_pragma ("freelist_count")) * db_get_pragma ("page_size");
+}
+
+guint
+db_items_get_count (void)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+	guint		count = 0;
+
+	stmt = db_get_statement ("itemsCountStmt");
+	res = sqlite3_step (stmt);
+	if (SQLITE_ROW == res)
+		count = sqlite3_column_int (stmt, 0);
+	else
+		g_warning ("item counting failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+
+	return count;
+}
+
+GSList * 
+db_item_get_duplicates (const gchar *guid) 
+{
+	GSList		*duplicates = NULL;
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	debug_start_measurement (DEBUG_DB);
+
+	stmt = db_get_statement ("duplicatesFindStmt");
+	res = sqlite3_bind_text (stmt, 1, guid, -1, SQLITE_TRANSIENT);
+	if (SQLITE_OK != res)
+		g_error ("db_item_get_duplicates: sqlite bind failed (error code %d)!", res);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW) 
+	{
+		gulong id = sqlite3_column_int (stmt, 0);
+		duplicates = g_slist_append (duplicates, GUINT_TO_POINTER (id));
+	}
+
+	debug_end_measurement (DEBUG_DB, "searching for duplicates");
+	
+	return duplicates;
+}
+
+GSList *
+db_item_get_duplicate_nodes (const gchar *guid)
+{
+	GSList		*duplicates = NULL;
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	debug_start_measurement (DEBUG_DB);
+
+	stmt = db_get_statement ("duplicateNodesFindStmt");
+	res = sqlite3_bind_text (stmt, 1, guid, -1, SQLITE_TRANSIENT);
+	if (SQLITE_OK != res)
+		g_error ("db_item_get_duplicates: sqlite bind failed (error code %d)!", res);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW) 
+	{
+		gchar *id = g_strdup( sqlite3_column_text (stmt, 0));
+		duplicates = g_slist_append (duplicates, id);
+	}
+
+	debug_end_measurement (DEBUG_DB, "searching for duplicates");
+	
+	return duplicates;
+}
+
+/* item list rows */
+
+/* number of item ids per statement in db_item_list_rows_load() */
+#define DB_ITEM_LIST_ROWS_BATCH_IDS	500
+
+void
+db_item_list_row_free (itemListRowPtr row)
+{
+	g_free (row->title);
+	g_free (row->nodeId);
+	g_free (row);
+}
+
+GSList *
+db_item_list_rows_load (const gulong *ids, guint count)
+{
+	sqlite3_stmt	*stmt;
+	GString		*sql;
+	GSList		*rows = NULL;
+	guint		i, n;
+
+	debug_start_measurement (DEBUG_DB);
+
+	sql = g_string_new (NULL);
+	for (i = 0; i < count; i += DB_ITEM_LIST_ROWS_BATCH_IDS) {
+		g_string_assign (sql, "SELECT item_id,title,date,node_id,read,marked,"
+		                      "EXISTS (SELECT 1 FROM metadata WHERE metadata.item_id = items.item_id AND key = 'enclosure') "
+		                      "FROM items WHERE item_id IN (");
+		for (n = i; (n < count) && (n < i + DB_ITEM_LIST_ROWS_BATCH_IDS); n++)
+			g_string_append_printf (sql, "%s%lu", (n == i)?"":",", ids[n]);
+		g_string_append_c (sql, ')');
+
+		if (SQLITE_OK != sqlite3_prepare_v2 (db, sql->str, -1, &stmt, NULL)) {
+			g_warning ("Loading item list rows failed (%s)", sqlite3_errmsg (db));
+			break;
+		}
+
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			itemListRowPtr row = g_new0 (struct itemListRow, 1);
+			row->id = sqlite3_column_int (stmt, 0);
+			row->title = g_strdup ((const gchar *)sqlite3_column_text (stmt, 1));
+			row->time = sqlite3_column_int64 (stmt, 2);
+			row->nodeId = g_strdup ((const gchar *)sqlite3_column_text (stmt, 3));
+			row->readStatus = sqlite3_column_int (stmt, 4)?TRUE:FALSE;
+			row->flagStatus = sqlite3_column_int (stmt, 5)?TRUE:FALSE;
+			row->hasEnclosure = sqlite3_column_int (stmt, 6)?TRUE:FALSE;
+			rows = g_slist_prepend (rows, row);
+		}
+		sqlite3_finalize (stmt);
+	}
+	g_string_free (sql, TRUE);
+
+	debug_end_measurement (DEBUG_DB, "item list rows load");
+
+	return rows;
+}
+
+void
+db_item_list_entry_free (itemListEntryPtr entry)
+{
+	g_free (entry->nodeId);
+	g_free (entry->sourceId);
+	g_free (entry);
+}
+
+GSList *
+db_item_list_entries_load (GList *ids, const gchar *condition)
+{
+	sqlite3_stmt	*stmt;
+	GSList		*entries = NULL;
+	GList		*iter;
+	gchar		*sql;
+
+	if (!ids)
+		return NULL;
+
+	debug_start_measurement (DEBUG_DB);
+
+	db_begin_transaction ();
+
+	stmt = db_get_statement ("itemListIdsClearStmt");
+	sqlite3_step (stmt);
+
+	for (iter = ids; iter; iter = g_list_next (iter)) {
+		stmt = db_get_statement ("itemListIdsInsertStmt");
+		sqlite3_bind_int (stmt, 1, GPOINTER_TO_UINT (iter->data));
+		if (SQLITE_DONE != sqlite3_step (stmt))
+			g_warning ("Inserting item list id failed (%s)", sqlite3_errmsg (db));
+	}
+
+	/* Items without a valid GUID are grouped by their id, so
+	   only duplicates by GUID are merged into one entry */
+	sql = g_strdup_printf ("SELECT items.item_id,items.node_id,items.date,items.valid_guid,items.source_id,"
+	                       "ifnull(items.description,'') != '',"
+	                       "EXISTS (SELECT 1 FROM metadata WHERE metadata.item_id = items.item_id AND key = 'enclosure') "
+	                       "FROM items WHERE items.item_id IN "
+	                       "(SELECT MIN(items.item_id) FROM items "
+	                       "INNER JOIN item_list_ids ON items.item_id = item_list_ids.item_id "
+	                       "WHERE %s "
+	                       "GROUP BY items.valid_guid, CASE WHEN items.valid_guid = 1 THEN items.source_id ELSE items.item_id END)",
+	                       condition?condition:"1");
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			itemListEntryPtr entry = g_new0 (struct itemListEntry, 1);
+			entry->id = sqlite3_column_int (stmt, 0);
+			entry->nodeId = g_strdup ((const gchar *)sqlite3_column_text (stmt, 1));
+			entry->time = sqlite3_column_int64 (stmt, 2);
+			if (sqlite3_column_int (stmt, 3))
+				entry->sourceId = g_strdup ((const gchar *)sqlite3_column_text (stmt, 4));
+			entry->hasContent = sqlite3_column_int (stmt, 5)?TRUE:FALSE;
+			entry->hasEnclosure = sqlite3_column_int (stmt, 6)?TRUE:FALSE;
+			entries = g_slist_prepend (entries, entry);
+		}
+		sqlite3_finalize (stmt);
+	} else {
+		g_warning ("Loading item list entries failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
+	}
+	g_free (sql);
+
+	stmt = db_get_statement ("itemListIdsClearStmt");
+	sqlite3_step (stmt);
+
+	db_end_transaction ();
+
+	debug_end_measurement (DEBUG_DB, "item list entries load");
+
+	return entries;
+}
+
+GArray *
+db_item_list_sort (GArray *ids, nodeViewSortType sortType, gboolean reversed)
+{
+	sqlite3_stmt	*stmt;
+	GArray		*sorted;
+	const gchar	*order;
+	gchar		*orderBy, *sql;
+	guint		i;
+
+	switch (sortType) {
+		case NODE_VIEW_SORT_BY_TITLE:
+			order = "items.title COLLATE NOCASE %s, items.item_id %s";
+			break;
+		case NODE_VIEW_SORT_BY_PARENT:
+			order = "items.node_id %s, items.item_id %s";
+			break;
+		case NODE_VIEW_SORT_BY_STATE:
+			order = "(items.marked * 2 + (items.read = 0)) %s, items.item_id %s";
+			break;
+		case NODE_VIEW_SORT_BY_TIME:
+		default:
+			order = "items.date %s, items.item_id %s";
+			break;
+	}
+
+	debug_start_measurement (DEBUG_DB);
+
+	db_begin_transaction ();
+
+	stmt = db_get_statement ("itemListIdsClearStmt");
+	sqlite3_step (stmt);
+
+	for (i = 0; i < ids->len; i++) {
+		stmt = db_get_statement ("itemListIdsInsertStmt");
+		sqlite3_bind_int (stmt, 1, g_array_index (ids, gulong, i));
+		if (SQLITE_DONE != sqlite3_step (stmt))
+			g_warning ("Inserting item list id failed (%s)", sqlite3_errmsg (db));
+	}
+
+	sorted = g_array_sized_new (FALSE, FALSE, sizeof (gulong), ids->len);
+	orderBy = g_strdup_printf (order, reversed?"DESC":"ASC", reversed?"DESC":"ASC");
+	sql = g_strdup_printf ("SELECT items.item_id FROM items "
+	                       "INNER JOIN item_list_ids ON items.item_id = item_list_ids.item_id "
+	                       "ORDER BY %s", orderBy);
+	g_free (orderBy);
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			gulong id = sqlite3_column_int (stmt, 0);
+			g_array_append_val (sorted, id);
+		}
+		sqlite3_finalize (stmt);
+	} else {
+		g_warning ("Sorting the item list failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
+	}
+	g_free (sql);
+
+	stmt = db_get_statement ("itemListIdsClearStmt");
+	sqlite3_step (stmt);
+
+	db_end_transaction ();
+
+	debug_end_measurement (DEBUG_DB, "item list sort");
+
+	return sorted;
+}
+
+/* rendered HTML cache */
+
+/** last handed out HTML cache access sequence number (0 if not yet seeded) */
+static gint64 htmlCacheAccess = 0;
+
+/* Returns the total size of all cached renderings and
+   seeds the access sequence number on first use. */
+static gint64
+db_html_cache_get_size (void)
+{
+	sqlite3_stmt	*stmt;
+	gint64		size = 0;
+
+	stmt = db_get_statement ("htmlCacheSizeStmt");
+	if (SQLITE_ROW == sqlite3_step (stmt)) {
+		size = sqlite3_column_int64 (stmt, 0);
+		htmlCacheAccess = MAX (htmlCacheAccess, sqlite3_column_int64 (stmt, 1));
+	}
+	sqlite3_reset (stmt);
+
+	return size;
+}
+
+static gint64
+db_html_cache_next_access (void)
+{
+	if (!htmlCacheAccess)
+		db_html_cache_get_size ();
+
+	return ++htmlCacheAccess;
+}
+
+gchar *
+db_html_cache_get (gulong id, const gchar *key)
+{
+	sqlite3_stmt	*stmt;
+	gchar		*html = NULL;
+	gint64		access = 0;
+
+	debug_start_measurement (DEBUG_DB);
+
+	if (!htmlCacheAccess)
+		db_html_cache_get_size ();
+
+	stmt = db_get_statement ("htmlCacheLoadStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	sqlite3_bind_text (stmt, 2, key, -1, SQLITE_TRANSIENT);
+	if (SQLITE_ROW == sqlite3_step (stmt)) {
+		html = g_strdup ((const gchar *)sqlite3_column_text (stmt, 0));
+		access = sqlite3_column_int64 (stmt, 1);
+	}
+	sqlite3_reset (stmt);
+
+	/* Move the rendering to the end of the LRU order, but
+	   avoid writing for renderings that were just used */
+	if (html && (access < htmlCacheAccess)) {
+		stmt = db_get_statement ("htmlCacheTouchStmt");
+		sqlite3_bind_int64 (stmt, 1, db_html_cache_next_access ());
+		sqlite3_bind_int (stmt, 2, id);
+		sqlite3_bind_text (stmt, 3, key, -1, SQLITE_TRANSIENT);
+		if (SQLITE_DONE != sqlite3_step (stmt))
+			g_warning ("HTML cache access update failed (%s)", sqlite3_errmsg (db));
+	}
+
+	debug_end_measurement (DEBUG_DB, "HTML cache lookup");
+
+	return html;
+}
+
+void
+db_html_cache_store (gulong id, const gchar *key, const gchar *html)
+{
+	sqlite3_stmt	*stmt;
+	gsize		size = strlen (html);
+
+	stmt = db_get_statement ("htmlCacheStoreStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	sqlite3_bind_text (stmt, 2, key, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 3, size);
+	sqlite3_bind_int64 (stmt, 4, db_html_cache_next_access ());
+	sqlite3_bind_text (stmt, 5, html, size, SQLITE_STATIC);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		g_warning ("HTML cache store failed (%s)", sqlite3_errmsg (db));
+	sqlite3_reset (stmt);
+}
+
+void
+db_html_cache_remove (gulong id)
+{
+	sqlite3_stmt	*stmt;
+
+	stmt = db_get_statement ("htmlCacheRemoveStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		g_warning ("HTML cache removal failed (%s)", sqlite3_errmsg (db));
+	sqlite3_reset (stmt);
+}
+
+void
+db_html_cache_expire (gint64 maxSize)
+{
+	sqlite3_stmt	*stmt;
+	gint64		size, cutoff = 0;
+
+	size = db_html_cache_get_size ();
+	if (size <= maxSize)
+		return;
+
+	debug_start_measurement (DEBUG_DB);
+
+	/* Find the access number up to which the least recently
+	   used renderings have to be dropped. Shrinking to 3/4 of
+	   the limit avoids expiring on every store. */
+	stmt = db_get_statement ("htmlCacheAccessStmt");
+	while ((size > maxSize / 4 * 3) && (SQLITE_ROW == sqlite3_step (stmt))) {
+		cutoff = sqlite3_column_int64 (stmt, 0);
+		size -= sqlite3_column_int64 (stmt, 1);
+	}
+	sqlite3_reset (stmt);
+
+	stmt = db_get_statement ("htmlCacheExpireStmt");
+	sqlite3_bind_int64 (stmt, 1, cutoff);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		g_warning ("HTML cache expiration failed (%s)", sqlite3_errmsg (db));
+
+	debug_end_measurement (DEBUG_DB, "HTML cache expiration");
+}
+
+void 
+db_itemset_remove_all (const gchar *id) 
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+	
+	debug1(DEBUG_DB, "removing all items for item set with %s", id);
+		
+	stmt = db_get_statement ("itemsetRemoveAllStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, id, -1, SQLITE_TRANSIENT);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE != res)
+		g_warning ("removing all items failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+}
+
+void 
+db_itemset_mark_all_popup (const gchar *id) 
+{
 	sqlite3_stmt	*stmt;
 	gint		res;
 	
@@ -1125,6 +2044,157 @@ db_itemset_get (itemSetPtr itemSet, gulong id, guint limit)
 	return success;
 }
 
+gboolean
+db_fts_available (void)
+{
+	return ftsAvailable;
+}
+
+GList *
+db_itemset_query (const gchar *condition)
+{
+	sqlite3_stmt	*stmt;
+	gchar		*sql;
+	GList		*ids = NULL;
+
+	debug1 (DEBUG_DB, "querying items matching: %s", condition);
+	debug_start_measurement (DEBUG_DB);
+
+	sql = g_strdup_printf ("SELECT item_id FROM items WHERE (%s) ORDER BY item_id", condition);
+	if (SQLITE_OK != sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		g_warning ("Item query failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
+		g_free (sql);
+		return NULL;
+	}
+
+	while (sqlite3_step (stmt) == SQLITE_ROW)
+		ids = g_list_prepend (ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
+
+	sqlite3_finalize (stmt);
+	g_free (sql);
+
+	debug_end_measurement (DEBUG_DB, "item query");
+
+	return g_list_reverse (ids);
+}
+
+/* number of item ids per statement in db_items_mark_read() */
+#define DB_MARK_READ_BATCH_IDS	500
+
+/* Marks all unread items matching the given condition and all 
+   duplicates of them read. Before updating, the affected item ids
+   are added to the given hash of node ids to item id lists. */
+static void
+db_items_mark_read_where (const gchar *condition, GHashTable *changes)
+{
+	sqlite3_stmt	*stmt;
+	gchar		*where, *sql;
+
+	where = g_strdup_printf ("read = 0 AND ((%s) OR source_id IN "
+	                         "(SELECT source_id FROM items WHERE valid_guid = 1 AND read = 0 AND (%s)))",
+	                         condition, condition);
+
+	sql = g_strdup_printf ("SELECT item_id, node_id FROM items WHERE %s", where);
+	if (SQLITE_OK == sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL)) {
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			const gchar	*nodeId = (const gchar *)sqlite3_column_text (stmt, 1);
+			gpointer	key, ids = NULL;
+
+			if (!nodeId)
+				continue;
+
+			if (g_hash_table_lookup_extended (changes, nodeId, &key, &ids))
+				g_hash_table_steal (changes, nodeId);
+			else
+				key = g_strdup (nodeId);
+
+			ids = g_slist_prepend ((GSList *)ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
+			g_hash_table_insert (changes, key, ids);
+		}
+		sqlite3_finalize (stmt);
+	} else {
+		g_warning ("Finding unread items failed (%s) SQL: %s", sqlite3_errmsg (db), sql);
+	}
+	g_free (sql);
+
+	sql = g_strdup_printf ("UPDATE items SET read = 1, updated = 0 WHERE %s", where);
+	db_exec (sql);
+	g_free (sql);
+	g_free (where);
+}
+
+static GHashTable *
+db_items_mark_read_changes_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_slist_free);
+}
+
+GHashTable *
+db_itemset_mark_read (GSList *nodeIds)
+{
+	GHashTable	*changes = db_items_mark_read_changes_new ();
+	GString		*condition;
+	GSList		*iter;
+
+	if (!nodeIds)
+		return changes;
+
+	debug_start_measurement (DEBUG_DB);
+
+	condition = g_string_new ("node_id IN (");
+	for (iter = nodeIds; iter; iter = g_slist_next (iter)) {
+		gchar *quoted = sqlite3_mprintf ("%Q", (gchar *)iter->data);
+		g_string_append_printf (condition, "%s%s", (iter == nodeIds)?"":",", quoted);
+		sqlite3_free (quoted);
+	}
+	g_string_append (condition, ")");
+
+	db_begin_transaction ();
+	db_items_mark_read_where (condition->str, changes);
+	db_end_transaction ();
+
+	g_string_free (condition, TRUE);
+
+	debug_end_measurement (DEBUG_DB, "marking item sets read");
+
+	return changes;
+}
+
+GHashTable *
+db_items_mark_read (GList *ids)
+{
+	GHashTable	*changes = db_items_mark_read_changes_new ();
+	GString		*condition;
+	guint		count = 0;
+
+	debug_start_measurement (DEBUG_DB);
+
+	db_begin_transaction ();
+
+	condition = g_string_new (NULL);
+	while (ids) {
+		if (0 == count)
+			g_string_assign (condition, "item_id IN (");
+		else
+			g_string_append_c (condition, ',');
+		g_string_append_printf (condition, "%u", GPOINTER_TO_UINT (ids->data));
+
+		ids = g_list_next (ids);
+		if (++count == DB_MARK_READ_BATCH_IDS || !ids) {
+			g_string_append_c (condition, ')');
+			db_items_mark_read_where (condition->str, changes);
+			count = 0;
+		}
+	}
+	g_string_free (condition, TRUE);
+
+	db_end_transaction ();
+
+	debug_end_measurement (DEBUG_DB, "marking items read");
+
+	return changes;
+}
+
 /* Statistics interface */
 
 guint 
@@ -1136,6 +2206,11 @@ db_itemset_get_unread_count (const gchar *id)
 	
 	debug_start_measurement (DEBUG_DB);
 	
+	if (itemsetCounters) {
+		itemsetCountersPtr counters = g_hash_table_lookup (itemsetCounters, id);
+		return counters?counters->unreadCount:0;
+	}
+
 	stmt = db_get_statement ("itemsetReadCountStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
 	res = sqlite3_step (stmt);
@@ -1159,6 +2234,11 @@ db_itemset_get_item_count (const gchar *id)
 
 	debug_start_measurement (DEBUG_DB);
 	
+	if (itemsetCounters) {
+		itemsetCountersPtr counters = g_hash_table_lookup (itemsetCounters, id);
+		return counters?counters->itemCount:0;
+	}
+
 	stmt = db_get_statement ("itemsetItemCountStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
 	res = sqlite3_step (stmt);
@@ -1173,6 +2253,37 @@ db_itemset_get_item_count (const gchar *id)
 	return count;
 }
 
+void
+db_itemset_load_counters (void)
+{
+	sqlite3_stmt	*stmt;
+
+	db_itemset_unload_counters ();
+
+	debug_start_measurement (DEBUG_DB);
+
+	itemsetCounters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	stmt = db_get_statement ("itemsetCountersLoadStmt");
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		itemsetCountersPtr counters = g_new0 (struct itemsetCounters, 1);
+		counters->itemCount = sqlite3_column_int (stmt, 1);
+		counters->unreadCount = sqlite3_column_int (stmt, 2);
+		g_hash_table_insert (itemsetCounters, g_strdup ((const gchar *)sqlite3_column_text (stmt, 0)), counters);
+	}
+
+	debug_end_measurement (DEBUG_DB, "loading all item counters");
+}
+
+void
+db_itemset_unload_counters (void)
+{
+	if (itemsetCounters) {
+		g_hash_table_destroy (itemsetCounters);
+		itemsetCounters = NULL;
+	}
+}
+
 /* This method is only used for migration from old schema versions */
 static void
 db_view_remove_triggers (const gchar *id)
@@ -1271,6 +2382,24 @@ db_search_folder_load (const gchar *id)
 	return itemSet;
 }
 
+GList *
+db_search_folder_load_unread (const gchar *id)
+{
+	gint		res;
+	sqlite3_stmt	*stmt;
+	GList		*ids = NULL;
+
+	stmt = db_get_statement ("searchFolderLoadUnreadStmt");
+	res = sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	if (SQLITE_OK != res)
+		g_error ("db_search_folder_load_unread: sqlite bind failed (error code %d)!", res);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW)
+		ids = g_list_prepend (ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
+
+	return ids;
+}
+
 void
 db_search_folder_reset (const gchar *id) 
 {
@@ -1318,10 +2447,19 @@ db_search_folder_add_items (const gchar *id, GSList *items)
 	debug0 (DEBUG_DB, "adding items to search folder finished");
 }
 
-static GSList *
-db_subscription_metadata_load(const gchar *id) 
+/* The HTTP cache validators of a subscription are stored as
+   special subscription metadata keys which are not loaded into
+   the metadata list but into the subscription update state. */
+#define DB_SUBSCRIPTION_LASTMODIFIED	"lastModified"
+#define DB_SUBSCRIPTION_ETAG		"etag"
+#define DB_SUBSCRIPTION_UNCHANGED	"pollUnchangedCount"
+#define DB_SUBSCRIPTION_LASTARRIVAL	"pollLastArrival"
+#define DB_SUBSCRIPTION_ARRIVALINTERVAL	"pollArrivalInterval"
+
+static metadataListPtr
+db_subscription_metadata_load(const gchar *id, updateStatePtr updateState) 
 {
-	GSList		*metadata = NULL;
+	metadataListPtr	metadata = NULL;
 	sqlite3_stmt	*stmt;
 	gint		res;
 
@@ -1331,8 +2469,24 @@ db_subscription_metadata_load(const gchar *id)
 		g_error ("db_subscription_metadata_load: sqlite bind failed (error code %d)!", res);
 
 	while (sqlite3_step (stmt) == SQLITE_ROW) {
-		metadata = db_metadata_list_append (metadata, sqlite3_column_text(stmt, 0), 
-		                                           sqlite3_column_text(stmt, 1));
+		const gchar *key = sqlite3_column_text (stmt, 0);
+		const gchar *value = sqlite3_column_text (stmt, 1);
+
+		if (!key || !value)
+			continue;
+
+		if (g_str_equal (key, DB_SUBSCRIPTION_LASTMODIFIED))
+			update_state_set_lastmodified (updateState, atol (value));
+		else if (g_str_equal (key, DB_SUBSCRIPTION_ETAG))
+			update_state_set_etag (updateState, value);
+		else if (g_str_equal (key, DB_SUBSCRIPTION_UNCHANGED))
+			updateState->unchangedCount = atoi (value);
+		else if (g_str_equal (key, DB_SUBSCRIPTION_LASTARRIVAL))
+			updateState->lastArrival = atol (value);
+		else if (g_str_equal (key, DB_SUBSCRIPTION_ARRIVALINTERVAL))
+			updateState->arrivalInterval = atol (value);
+		else
+			metadata = db_metadata_list_append (metadata, key, value, sqlite3_column_bytes (stmt, 1));
 	}
 
 	return metadata;
@@ -1358,16 +2512,64 @@ db_subscription_metadata_update_cb (const gchar *key,
 		g_warning ("Update in \"subscription_metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 }
 
+static void
+db_subscription_metadata_update_number (const gchar *key, glong value, guint index, nodePtr node)
+{
+	gchar	*tmp;
+
+	if (!value)
+		return;
+
+	tmp = g_strdup_printf ("%ld", value);
+	db_subscription_metadata_update_cb (key, tmp, index, node);
+	g_free (tmp);
+}
+
+static void
+db_subscription_metadata_count_cb (const gchar *key,
+                                   const gchar *value,
+                                   guint index,
+                                   gpointer user_data)
+{
+	*(guint *)user_data = index;
+}
+
 static void
 db_subscription_metadata_update (subscriptionPtr subscription) 
 {
+	sqlite3_stmt	*stmt;
+	gint		res;
+	guint		count = 0;
+
+	/* Drop the old rows first, the list might have become shorter */
+	stmt = db_get_statement ("subscriptionMetadataRemoveStmt");
+	sqlite3_bind_text (stmt, 1, subscription->node->id, -1, SQLITE_TRANSIENT);
+	res = sqlite3_step (stmt);
+	if (SQLITE_DONE != res)
+		g_warning ("Could not remove subscription metadata for node id %s (error code %d)!", subscription->node->id, res);
+
 	metadata_list_foreach (subscription->metadata, db_subscription_metadata_update_cb, subscription->node);
+	metadata_list_foreach (subscription->metadata, db_subscription_metadata_count_cb, &count);
+
+	/* Append the cache validators after the regular metadata */
+	if (update_state_get_lastmodified (subscription->updateState)) {
+		gchar *tmp = g_strdup_printf ("%ld", update_state_get_lastmodified (subscription->updateState));
+		db_subscription_metadata_update_cb (DB_SUBSCRIPTION_LASTMODIFIED, tmp, ++count, subscription->node);
+		g_free (tmp);
+	}
+	if (update_state_get_etag (subscription->updateState))
+		db_subscription_metadata_update_cb (DB_SUBSCRIPTION_ETAG, update_state_get_etag (subscription->updateState), ++count, subscription->node);
+
+	/* and the item arrival statistics of the adaptive update interval */
+	db_subscription_metadata_update_number (DB_SUBSCRIPTION_UNCHANGED, subscription->updateState->unchangedCount, ++count, subscription->node);
+	db_subscription_metadata_update_number (DB_SUBSCRIPTION_LASTARRIVAL, subscription->updateState->lastArrival, ++count, subscription->node);
+	db_subscription_metadata_update_number (DB_SUBSCRIPTION_ARRIVALINTERVAL, subscription->updateState->arrivalInterval, ++count, subscription->node);
 }
 
 void
 db_subscription_load (subscriptionPtr subscription)
 {
-	subscription->metadata = db_subscription_metadata_load (subscription->node->id);
+	subscription->metadata = db_subscription_metadata_load (subscription->node->id, subscription->updateState);
 }
 
 void
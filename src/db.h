@@ -25,6 +25,7 @@
 
 #include "item.h"
 #include "itemset.h"
+#include "node_view.h"
 #include "subscription.h"
 #include "update.h"
 
@@ -38,6 +39,18 @@ void    db_init (void);
  */
 void    db_deinit (void);
 
+/**
+ * Starts a batch of DB writes. All writes until the matching
+ * db_end_batch() are committed with a single transaction.
+ * Batches may be nested.
+ */
+void	db_begin_batch (void);
+
+/**
+ * Ends a batch of DB writes started with db_begin_batch().
+ */
+void	db_end_batch (void);
+
 /* item set access (note: item sets are identified by the node id string) */
 
 /**
@@ -49,6 +62,18 @@ void    db_deinit (void);
  */
 itemSetPtr	db_itemset_load (const gchar *id);
 
+/**
+ * Loads the merge relevant state of all items of the given
+ * node id with a single query without loading the full items.
+ * The content hash is the one stored by db_item_update(), so
+ * titles and descriptions are not read.
+ *
+ * @param id	the node id
+ *
+ * @returns a list of itemMergeInfoPtr, to be free'd using itemset_merge_info_free()
+ */
+GList *		db_itemset_load_merge_info (const gchar *id);
+
 /**
  * Removes all items of the given item set from the DB.
  *
@@ -64,6 +89,28 @@ void	db_itemset_remove_all (const gchar *id);
  */
 void	db_itemset_mark_all_popup (const gchar *id);
 
+/**
+ * Marks all unread items of the given nodes and all duplicates
+ * of those items read with a single DB update.
+ *
+ * @param nodeIds	list of node ids (gchar *)
+ *
+ * @returns a hash table of the ids of all nodes whose items were
+ * changed to a GSList of the changed item ids (to be free'd 
+ * using g_hash_table_destroy())
+ */
+GHashTable * db_itemset_mark_read (GSList *nodeIds);
+
+/**
+ * Marks the given items and all duplicates of them read using
+ * set-based DB updates.
+ *
+ * @param ids		list of item ids
+ *
+ * @returns a hash table like db_itemset_mark_read()
+ */
+GHashTable * db_items_mark_read (GList *ids);
+
 /**
  * Returns the number of unread items for the given item set.
  *
@@ -82,6 +129,20 @@ guint	db_itemset_get_unread_count (const gchar *id);
  */
 guint   db_itemset_get_item_count (const gchar *id);
 
+/**
+ * Loads the item and unread counters of all item sets with a
+ * single query. Until db_itemset_unload_counters() is called
+ * db_itemset_get_unread_count() and db_itemset_get_item_count()
+ * answer from this snapshot instead of querying the DB. Only to
+ * be used while no items are changed (e.g. at startup).
+ */
+void	db_itemset_load_counters (void);
+
+/**
+ * Drops the counters loaded by db_itemset_load_counters().
+ */
+void	db_itemset_unload_counters (void);
+
 /**
  * Returns a batch of items starting with the given
  * id and no more than the given limit. If ids are not
@@ -97,6 +158,24 @@ guint   db_itemset_get_item_count (const gchar *id);
  */
 gboolean        db_itemset_get (itemSetPtr itemSet, gulong id, guint limit);
 
+/**
+ * Returns TRUE if the full text index of item titles and
+ * descriptions is available (requires SQLite FTS3 support).
+ *
+ * @returns TRUE if the table "items_fts" can be used in queries
+ */
+gboolean	db_fts_available (void);
+
+/**
+ * Returns the ids of all items matching the given SQL condition
+ * on the "items" table (as created by itemset_to_sql()).
+ *
+ * @param condition	SQL condition
+ *
+ * @returns a list of item ids sorted ascending (to be free'd using g_list_free())
+ */
+GList *		db_itemset_query (const gchar *condition);
+
 /* item access (note: items are identified by the numeric item id) */
 
 /**
@@ -108,6 +187,20 @@ gboolean        db_itemset_get (itemSetPtr itemSet, gulong id, guint limit);
  */
 itemPtr	db_item_load(gulong id);
 
+/**
+ * Loads the items specified by the given ids including their
+ * metadata from the DB. Instead of two queries per item only
+ * two queries per batch of ids are needed. Ids of items not
+ * in the DB are skipped.
+ *
+ * @param ids		array of item ids
+ * @param count		number of item ids
+ *
+ * @returns list of new item structures in the order of the
+ *          given ids, each must be free'd using item_unload()
+ */
+GSList *	db_items_load_many (const gulong *ids, guint count);
+
 /**
  * Updates all attributes of the item in the DB
  *
@@ -122,6 +215,57 @@ void	db_item_update(itemPtr item);
  */
 void	db_item_remove(gulong id);
 
+/**
+ * Removes the given items and their comments from the DB
+ * using one statement per batch of ids.
+ *
+ * @param ids		array of item ids
+ * @param count		number of item ids
+ *
+ * @returns number of removed item rows (including comments)
+ */
+guint	db_items_remove_many (const gulong *ids, guint count);
+
+/**
+ * Returns the ids of the oldest unflagged items of the given
+ * item set that exceed the given maximum item count.
+ *
+ * @param id		the item set id
+ * @param max		maximum number of items
+ * @param limit		maximum number of ids to return
+ *
+ * @returns array of item ids (to be free'd using g_array_free())
+ */
+GArray * db_itemset_get_excess_items (const gchar *id, guint max, guint limit);
+
+/**
+ * Returns the ids of the oldest unflagged items, ordered by date.
+ *
+ * @param before		only items older than this (seconds since epoch)
+ * @param excludeNodeIds	list of node ids whose items are skipped (or NULL)
+ * @param limit			maximum number of ids to return
+ * @param nodeIds		hash table the node ids of the items are
+ *				added to as keys (or NULL)
+ *
+ * @returns array of item ids (to be free'd using g_array_free())
+ */
+GArray * db_items_get_oldest (glong before, GSList *excludeNodeIds, guint limit, GHashTable *nodeIds);
+
+/**
+ * Returns the number of bytes used by the DB file
+ * excluding unused pages.
+ *
+ * @returns size in bytes
+ */
+gint64	db_get_used_size (void);
+
+/**
+ * Returns the number of item rows in the DB.
+ *
+ * @returns number of items
+ */
+guint	db_items_get_count (void);
+
 /**
  * Update the attributes related to item state only.
  *
@@ -147,6 +291,116 @@ GSList * db_item_get_duplicates(const gchar *guid);
  */
 GSList * db_item_get_duplicate_nodes(const gchar *guid);
 
+/** item attributes shown in the item list */
+typedef struct itemListRow {
+	gulong		id;		/**< item id */
+	gchar		*title;		/**< item title (or NULL) */
+	gint64		time;		/**< item date */
+	gchar		*nodeId;	/**< id of the item's node */
+	gboolean	readStatus;	/**< TRUE if the item is read */
+	gboolean	flagStatus;	/**< TRUE if the item is flagged */
+	gboolean	hasEnclosure;	/**< TRUE if the item has enclosures */
+} *itemListRowPtr;
+
+/**
+ * Loads the item list attributes of the given items without
+ * loading the complete items.
+ *
+ * @param ids		array of item ids
+ * @param count		number of item ids
+ *
+ * @returns list of rows in no particular order (to be free'd
+ *          using db_item_list_row_free())
+ */
+GSList * db_item_list_rows_load (const gulong *ids, guint count);
+
+/**
+ * Frees a row loaded with db_item_list_rows_load().
+ *
+ * @param row		the row
+ */
+void db_item_list_row_free (itemListRowPtr row);
+
+/** item attributes needed to add an item to the item list */
+typedef struct itemListEntry {
+	gulong		id;		/**< item id */
+	gchar		*nodeId;	/**< id of the item's node */
+	gint64		time;		/**< item date */
+	gchar		*sourceId;	/**< syndication item id if it is a valid GUID (or NULL) */
+	gboolean	hasEnclosure;	/**< TRUE if the item has enclosures */
+	gboolean	hasContent;	/**< TRUE if the item has a description */
+} *itemListEntryPtr;
+
+/**
+ * Loads the item list entries of those of the given items
+ * that match the given SQL condition without loading the
+ * complete items. Of items sharing a valid GUID only the
+ * one with the lowest id is returned.
+ *
+ * @param ids		list of item ids
+ * @param condition	SQL condition on the "items" table (or NULL)
+ *
+ * @returns list of entries in no particular order (to be free'd
+ *          using db_item_list_entry_free())
+ */
+GSList * db_item_list_entries_load (GList *ids, const gchar *condition);
+
+/**
+ * Frees an entry loaded with db_item_list_entries_load().
+ *
+ * @param entry		the entry
+ */
+void db_item_list_entry_free (itemListEntryPtr entry);
+
+/**
+ * Sorts the given item ids by the given item list sort criteria.
+ * Ids of items not in the DB are not part of the result.
+ *
+ * @param ids		array of item ids (gulong)
+ * @param sortType	the sort criteria
+ * @param reversed	TRUE for descending order
+ *
+ * @returns new array of sorted ids (to be free'd using g_array_free())
+ */
+GArray * db_item_list_sort (GArray *ids, nodeViewSortType sortType, gboolean reversed);
+
+/**
+ * Returns the cached rendering of the given item. Cached
+ * renderings are dropped automatically when the item changes.
+ *
+ * @param id		the item id
+ * @param key		render parameter key
+ *
+ * @returns the HTML (to be free'd using g_free()) or NULL
+ */
+gchar * db_html_cache_get (gulong id, const gchar *key);
+
+/**
+ * Adds or replaces the rendering of the given item.
+ *
+ * @param id		the item id
+ * @param key		render parameter key
+ * @param html		the rendered HTML
+ */
+void db_html_cache_store (gulong id, const gchar *key, const gchar *html);
+
+/**
+ * Drops all cached renderings of the given item. Needed for
+ * changes of rendered state that is not stored in the item
+ * row (e.g. the comment feed update state).
+ *
+ * @param id		the item id
+ */
+void db_html_cache_remove (gulong id);
+
+/**
+ * Drops the least recently used renderings when the
+ * cached HTML exceeds the given size.
+ *
+ * @param maxSize	maximum size in bytes
+ */
+void db_html_cache_expire (gint64 maxSize);
+
 /**
  * Returns an item set of all items for the given search folder id.
  *
@@ -156,6 +410,15 @@ GSList * db_item_get_duplicate_nodes(const gchar *guid);
  */
 itemSetPtr      db_search_folder_load (const gchar *id);
 
+/**
+ * Returns the ids of all unread items of the given search folder id.
+ *
+ * @param id		the search folder id
+ *
+ * @returns a list of item ids (to be free'd using g_list_free())
+ */
+GList * db_search_folder_load_unread (const gchar *id);
+
 /**
  * Removes all items from the given search folder
  *
@@ -238,12 +238,17 @@ feed_process_update_result (subscriptionPtr subscription, const struct updateRes
 	debug_enter ("feed_process_update_result");
 	
 	if (result->data) {
-		/* parse the new downloaded feed into feed and itemSet */
-		ctxt = feed_create_parser_ctxt ();
+		/* parse the new downloaded feed into feed and itemSet,
+		   a streamed result already carries the items */
+		if (result->stream)
+			ctxt = (feedParserCtxtPtr)xml_stream_parser_get_user_data (result->stream);
+		else
+			ctxt = feed_create_parser_ctxt ();
 		ctxt->feed = feed;
 		ctxt->data = result->data;
 		ctxt->dataLength = result->size;
 		ctxt->subscription = subscription;
+		ctxt->result = result;
 
 		/* try to parse the feed */
 		feed_parse (ctxt);
@@ -269,10 +274,12 @@ feed_process_update_result (subscriptionPtr subscription, const struct updateRes
 			/* merge the resulting items into the node's item set */
 			itemSet = node_get_itemset (node);
 			newCount = itemset_merge_items (itemSet, ctxt->items, ctxt->feed->valid, ctxt->feed->markAsRead);
+			ctxt->items = NULL;	/* list was consumed by the merge */
 			itemlist_merge_itemset (itemSet);
 			itemset_free (itemSet);
 
 			feedlist_node_was_updated (node, newCount);
+			subscription_record_new_items (subscription, newCount);
 			
 			/* restore user defined properties if necessary */
 			if ((flags & FEED_REQ_RESET_TITLE) && ctxt->title)
@@ -287,7 +294,9 @@ feed_process_update_result (subscriptionPtr subscription, const struct updateRes
 				notification_node_has_new_items (node, feed->enforcePopup);
 		}
 
-		feed_free_parser_ctxt (ctxt);
+		/* a streamed context is free'd with its request */
+		if (!result->stream)
+			feed_free_parser_ctxt (ctxt);
 	} else {
 		node->available = FALSE;
 
@@ -300,7 +309,19 @@ feed_process_update_result (subscriptionPtr subscription, const struct updateRes
 static gboolean
 feed_prepare_update_request (subscriptionPtr subscription, struct updateRequest *request)
 {
-	/* Nothing to do. Feeds require no subscription extra handling. */
+	feedParserCtxtPtr	ctxt;
+
+	/* Let the update parse stage build the DOM in a worker thread */
+	request->parseXml = TRUE;
+
+	/* Unfiltered feeds are passed to a streaming parser in the
+	   worker, which collects the items while the data arrives */
+	if (!request->filtercmd) {
+		ctxt = feed_create_parser_ctxt ();
+		ctxt->feed = (feedPtr)subscription->node->data;
+		ctxt->subscription = subscription;
+		request->stream = feed_parser_stream_new (ctxt, TRUE);
+	}
 	
 	return TRUE;
 }
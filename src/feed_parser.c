@@ -23,6 +23,7 @@
 #include "common.h"
 #include "debug.h"
 #include "html.h"
+#include "item.h"
 #include "metadata.h"
 #include "xml.h"
 #include "parsers/cdf_channel.h"
@@ -97,10 +98,126 @@ feed_free_parser_ctxt (feedParserCtxtPtr ctxt)
 		/* Don't free the itemset! */
 		g_hash_table_destroy (ctxt->tmpdata);
 		g_free (ctxt->title);
+		g_free (ctxt->streamHomepage);
+		g_free (ctxt->streamSubscriptionHomepage);
 		g_free (ctxt);
 	}
 }
 
+static void
+feed_parser_free_items (feedParserCtxtPtr ctxt)
+{
+	GList	*iter;
+
+	for (iter = ctxt->items; iter; iter = g_list_next (iter))
+		item_unload ((itemPtr)iter->data);
+	g_list_free (ctxt->items);
+	ctxt->items = NULL;
+}
+
+static void
+feed_parser_stream_free_ctxt (gpointer user_data)
+{
+	feedParserCtxtPtr ctxt = (feedParserCtxtPtr)user_data;
+
+	/* items are only left if the result was never merged */
+	feed_parser_free_items (ctxt);
+	feed_free_parser_ctxt (ctxt);
+}
+
+static gboolean
+feed_parser_stream_element (xmlNodePtr cur, gpointer user_data)
+{
+	feedParserCtxtPtr	ctxt = (feedParserCtxtPtr)user_data;
+	GSList			*iter;
+	gboolean		consumed;
+
+	if (!ctxt->streamStarted) {
+		/* The root element is complete with the first
+		   child element, so detect the format now. */
+		xmlNodePtr root = xmlDocGetRootElement (cur->doc);
+
+		ctxt->streamStarted = TRUE;
+		for (iter = feed_parsers_get_list (); iter; iter = iter->next) {
+			feedHandlerPtr handler = (feedHandlerPtr)iter->data;
+			if (handler->checkFormat && (*(handler->checkFormat))(cur->doc, root)) {
+				ctxt->streamHandler = handler;
+				break;
+			}
+		}
+
+		if (!ctxt->streamHandler || !ctxt->streamHandler->parseElement)
+			debug0 (DEBUG_PARSING, "no streaming support for feed format, keeping the DOM");
+	}
+
+	if (!ctxt->streamHandler || !ctxt->streamHandler->parseElement)
+		return FALSE;
+
+	/* The document is not known to be a valid feed yet, so the
+	   hooks keep what they find in the context, feed_parse()
+	   applies it after checking the format. */
+	ctxt->doc = cur->doc;
+	ctxt->streaming = TRUE;
+	consumed = (*(ctxt->streamHandler->parseElement))(ctxt, cur);
+	ctxt->streaming = FALSE;
+	ctxt->doc = NULL;
+
+	return consumed;
+}
+
+struct xmlStreamParser *
+feed_parser_stream_new (feedParserCtxtPtr ctxt, gboolean freeCtxt)
+{
+	g_assert (NULL != ctxt->feed);
+
+	/* The hooks may run in a parser worker thread, so set up
+	   the lazily created tables now and take what they need
+	   of the subscription along. */
+	feed_parsers_get_list ();
+	metadata_init ();
+
+	ctxt->streamStarted = FALSE;
+	ctxt->streamHandler = NULL;
+	ctxt->streamTime = 0;
+	g_free (ctxt->streamHomepage);
+	ctxt->streamHomepage = NULL;
+	g_free (ctxt->streamSubscriptionHomepage);
+	if (ctxt->subscription)
+		ctxt->streamSubscriptionHomepage = g_strdup (subscription_get_homepage (ctxt->subscription));
+
+	return xml_stream_parser_new (feed_parser_stream_element, ctxt, freeCtxt?feed_parser_stream_free_ctxt:NULL);
+}
+
+glong
+feed_parser_ctxt_get_time (feedParserCtxtPtr ctxt)
+{
+	if (ctxt->streaming)
+		return ctxt->streamTime;
+
+	return ctxt->feed->time;
+}
+
+const gchar *
+feed_parser_ctxt_get_homepage (feedParserCtxtPtr ctxt)
+{
+	if (ctxt->streaming)
+		return ctxt->streamHomepage?ctxt->streamHomepage:ctxt->streamSubscriptionHomepage;
+
+	return subscription_get_homepage (ctxt->subscription);
+}
+
+void
+feed_parser_ctxt_set_homepage (feedParserCtxtPtr ctxt, const gchar *homepage)
+{
+	if (ctxt->streaming) {
+		g_free (ctxt->streamHomepage);
+		ctxt->streamHomepage = g_strdup (homepage);
+		return;
+	}
+
+	subscription_set_homepage (ctxt->subscription, homepage);
+}
+
 /**
  * This function tries to find a feed link for a given HTTP URI. It
  * tries to download it. If it finds a valid feed source it parses
@@ -151,12 +268,11 @@ gboolean
 feed_parse (feedParserCtxtPtr ctxt)
 {
 	xmlNodePtr	cur;
+	GList		*iter;
 	gboolean	success = FALSE;
 
 	debug_enter("feed_parse");
 
-	g_assert(NULL == ctxt->items);
-	
 	ctxt->failed = TRUE;	/* reset on success ... */
 
 	if(ctxt->feed->parseErrors)
@@ -167,6 +283,8 @@ feed_parse (feedParserCtxtPtr ctxt)
 	/* try to parse buffer with XML and to create a DOM tree */	
 	do {
 		if(NULL == xml_parse_feed (ctxt)) {
+			/* drop items streamed before the parser gave up */
+			feed_parser_free_items (ctxt);
 			g_string_append_printf (ctxt->feed->parseErrors, _("XML error while reading feed! Feed \"%s\" could not be loaded!"), subscription_get_source (ctxt->subscription));
 			break;
 		}
@@ -205,9 +323,23 @@ feed_parse (feedParserCtxtPtr ctxt)
 				ctxt->subscription->metadata = NULL;
 				ctxt->failed = FALSE;
 
+				/* the format is known now, so apply what was found while
+				   streaming, the feed parser may override it */
+				if (ctxt->streamHomepage)
+					subscription_set_homepage (ctxt->subscription, ctxt->streamHomepage);
+				if (ctxt->streamTime)
+					ctxt->feed->time = ctxt->streamTime;
+
 				ctxt->feed->fhp = handler;
 				(*(handler->feedParser))(ctxt, cur);		/* parse it */
 
+				/* streamed items could not fall back to the feed time yet */
+				for(iter = ctxt->items; iter; iter = g_list_next(iter)) {
+					itemPtr item = (itemPtr)iter->data;
+					if(0 == item->time)
+						item->time = ctxt->feed->time;
+				}
+
 				break;
 			}
 			handlerIter = handlerIter->next;
@@ -235,7 +367,9 @@ feed_parse (feedParserCtxtPtr ctxt)
 	}
 	
 	if(ctxt->doc) {
-		xmlFreeDoc(ctxt->doc);
+		/* a DOM provided by the update result is freed with the result */
+		if(!ctxt->result || ctxt->result->doc != ctxt->doc)
+			xmlFreeDoc(ctxt->doc);
 		ctxt->doc = NULL;
 	}
 		
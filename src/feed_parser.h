@@ -41,7 +41,15 @@ typedef struct feedParserCtxt {
 	gsize		dataLength;	/**< length of the data buffer */
 
 	xmlDocPtr	doc;		/**< the parsed data buffer */
+	const struct updateResult *result;	/**< update result possibly providing a pre-parsed DOM (optional) */
 	gboolean	failed;		/**< TRUE if parsing failed because feed type could not be detected */
+
+	struct feedHandler *streamHandler;	/**< feed handler detected by the streaming parser (or NULL) */
+	gboolean	streamStarted;	/**< TRUE if the streaming parser checked the document format */
+	gboolean	streaming;	/**< TRUE while a streaming element hook runs */
+	glong		streamTime;	/**< feed time found while streaming (0 if none yet) */
+	gchar		*streamHomepage;/**< feed HTML URL found while streaming (or NULL) */
+	gchar		*streamSubscriptionHomepage;	/**< subscription HTML URL when streaming started (or NULL) */
 } *feedParserCtxtPtr;
 
 
@@ -63,11 +71,23 @@ typedef void 	(*feedParserFunc)	(feedParserCtxtPtr ctxt, xmlNodePtr cur);
  */
 typedef gboolean (*checkFormatFunc)	(xmlDocPtr doc, xmlNodePtr cur);
 
+/**
+ * Function type which is passed each completed element of
+ * a feed document while the document is still being parsed.
+ *
+ * @param ctxt	feed parsing context
+ * @param cur	the completed XML element
+ *
+ * @return TRUE if the element was consumed and can be dropped from the document
+ */
+typedef gboolean (*feedElementFunc)	(feedParserCtxtPtr ctxt, xmlNodePtr cur);
+
 /** feed handler interface */
 typedef struct feedHandler {
 	const gchar	*typeStr;	/**< string representation of the feed type */
 	feedParserFunc	feedParser;	/**< feed type parse function */
 	checkFormatFunc	checkFormat;	/**< Parser for the feed type*/
+	feedElementFunc	parseElement;	/**< streaming item parser (optional) */
 } *feedHandlerPtr;
 
 /**
@@ -85,6 +105,57 @@ feedParserCtxtPtr feed_create_parser_ctxt (void);
  */
 void feed_free_parser_ctxt (feedParserCtxtPtr ctxt);
 
+/**
+ * Creates a streaming XML parser for the given parser context.
+ * Items completed while the document is fed are added to the
+ * context's item list and dropped from the DOM. The rest of the
+ * document is left to feed_parse().
+ *
+ * The parser is to be created in the main thread, but may be fed
+ * in a worker thread. While fed the hooks touch nothing but the
+ * context and the new items, whatever concerns the subscription
+ * is applied by feed_parse().
+ *
+ * @param ctxt		feed parsing context with feed and subscription set
+ * @param freeCtxt	TRUE if the context and the items still in it
+ *			are to be free'd along with the parser
+ *
+ * @returns a new streaming parser (to be free'd using xml_stream_parser_free())
+ */
+struct xmlStreamParser * feed_parser_stream_new (feedParserCtxtPtr ctxt, gboolean freeCtxt);
+
+/**
+ * Returns the feed time to be used as item time fallback. While
+ * streaming this is the feed time found so far in the document,
+ * the feed itself is only changed by feed_parse().
+ *
+ * @param ctxt		feed parsing context
+ *
+ * @returns the feed time (or 0 if not yet known)
+ */
+glong feed_parser_ctxt_get_time (feedParserCtxtPtr ctxt);
+
+/**
+ * Returns the feed HTML URL to resolve relative links against.
+ * While streaming this is the URL found so far in the document
+ * falling back to the one the subscription had when streaming
+ * started.
+ *
+ * @param ctxt		feed parsing context
+ *
+ * @returns the feed HTML URL (or NULL)
+ */
+const gchar * feed_parser_ctxt_get_homepage (feedParserCtxtPtr ctxt);
+
+/**
+ * Sets the feed HTML URL. While streaming the URL is kept in the
+ * context until feed_parse() has checked the document format.
+ *
+ * @param ctxt		feed parsing context
+ * @param homepage	the feed HTML URL
+ */
+void feed_parser_ctxt_set_homepage (feedParserCtxtPtr ctxt, const gchar *homepage);
+
 /**
  * Lookup a feed type string from the feed type id.
  *
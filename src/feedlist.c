@@ -31,7 +31,9 @@
 #include "itemlist.h"
 #include "net_monitor.h"
 #include "node.h"
+#include "retention.h"
 #include "update.h"
+#include "update_scheduler.h"
 #include "vfolder.h"
 #include "ui/feed_list_view.h"
 #include "ui/itemview.h"
@@ -53,7 +55,6 @@ struct FeedListPrivate {
 					     display enabled) */
 
 	guint		saveTimer;	/**< timer id for delayed feed list saving */
-	guint		autoUpdateTimer; /**< timer id for auto update */
 
 	gboolean	loading;	/**< prevents the feed list being saved before it is completely loaded */
 };
@@ -80,8 +81,8 @@ static void
 feedlist_finalize (GObject *object)
 {
 	/* Stop all timer based activity */
-	if (feedlist->priv->autoUpdateTimer)
-		g_source_remove (feedlist->priv->autoUpdateTimer);
+	update_scheduler_stop ();
+	retention_deinit ();
 	if (feedlist->priv->saveTimer)
 		g_source_remove (feedlist->priv->saveTimer);
 
@@ -108,25 +109,36 @@ feedlist_class_init (FeedListClass *klass)
 	g_type_class_add_private (object_class, sizeof(FeedListPrivate));
 }
 
-static gboolean
-feedlist_auto_update (void *data)
+static void
+feedlist_schedule_node (nodePtr node)
 {
-	debug_enter ("feedlist_auto_update");
+	if (node->subscription)
+		update_scheduler_schedule (node->subscription);
 
-	if (network_monitor_is_online ())
-		node_auto_update_subscription (ROOTNODE);
-	else
-		debug0 (DEBUG_UPDATE, "no update processing because we are offline!");
-	
-	debug_exit ("feedlist_auto_update");
+	if (node->children)
+		node_foreach_child (node, feedlist_schedule_node);
+}
+
+static void
+feedlist_cancel_node_update (nodePtr node)
+{
+	if (node->subscription)
+		subscription_cancel_update (node->subscription);
 
-	return TRUE;
+	if (node->children)
+		node_foreach_child (node, feedlist_cancel_node_update);
 }
 
 static void
 on_network_status_changed (gpointer instance, gboolean online, gpointer data)
 {
-	if (online) feedlist_auto_update (NULL);
+	if (online) {
+		/* Spread the updates missed while being offline */
+		update_scheduler_reschedule_all ();
+	} else {
+		/* Abort all running subscription updates */
+		feedlist_foreach (feedlist_cancel_node_update);
+	}
 }
 
 /* This method is used to initialize the node states in the feed list */
@@ -138,8 +150,7 @@ feedlist_init_node (nodePtr node)
 	
 	if (node->subscription)
 		db_subscription_load (node->subscription);
-		
-	node_update_counters (node);
+	
 	ui_node_update (node->id);	/* Necessary to initially set folder unread counters */
 	
 	node_foreach_child (node, feedlist_init_node);
@@ -165,6 +176,13 @@ feedlist_init (FeedList *fl)
 
 	/* 3. Ensure folder expansion and unread count*/
 	debug0 (DEBUG_CACHE, "Initializing node state");
+
+	/* Counting recurses children first, so all folders are
+	   rolled up in a single pass over the preloaded counters. */
+	db_itemset_load_counters ();
+	node_update_counters (ROOTNODE);
+	db_itemset_unload_counters ();
+
 	feedlist_foreach (feedlist_init_node);
 
 	ui_tray_update ();
@@ -186,7 +204,9 @@ feedlist_init (FeedList *fl)
 	}
 
 	/* 5. Start automatic updating */
-	feedlist->priv->autoUpdateTimer = g_timeout_add_seconds (10, feedlist_auto_update, NULL);
+	feedlist_foreach (feedlist_schedule_node);
+	update_scheduler_start ();
+	retention_init ();
 	g_signal_connect (network_monitor_get (), "online-status-changed", G_CALLBACK (on_network_status_changed), NULL);
 
 	/* 6. Finally save the new feed list state */
@@ -257,12 +277,13 @@ feedlist_mark_all_read (nodePtr node)
 
 	feedlist_reset_new_item_count ();
 
-	if (node != ROOTNODE)
-		node_mark_all_read (node);
-	else 
-		node_foreach_child (ROOTNODE, node_mark_all_read);
-		
+	node_mark_all_read (node);
+
+	/* Refresh all counters, as duplicates in other 
+	   feeds might have been marked read too */
+	db_itemset_load_counters ();
 	feedlist_foreach (feedlist_update_node_counters);
+	db_itemset_unload_counters ();
 	itemview_update_all_items ();
 	itemview_update ();
 }
@@ -29,6 +29,7 @@
 #include <libxml/xpath.h>
 
 #include "common.h"
+#include "db.h"
 #include "debug.h"
 #include "feedlist.h"
 #include "item_state.h"
@@ -351,6 +352,33 @@ google_source_item_mark_read (nodePtr node, itemPtr item, gboolean newStatus)
 	item_read_state_changed (item, newStatus);
 }
 
+static void
+google_source_items_mark_read (nodePtr node, GSList *ids)
+{
+	nodePtr root = node_source_root_from_node (node);
+	GArray	*idArray;
+	GSList	*items, *iter;
+
+	idArray = g_array_new (FALSE, FALSE, sizeof (gulong));
+	for (; ids; ids = g_slist_next (ids)) {
+		gulong id = GPOINTER_TO_UINT (ids->data);
+		g_array_append_val (idArray, id);
+	}
+	items = db_items_load_many ((gulong *)idArray->data, idArray->len);
+	g_array_free (idArray, TRUE);
+
+	/* The edit actions are queued and processed one by one anyway */
+	for (iter = items; iter; iter = g_slist_next (iter)) {
+		itemPtr item = (itemPtr)iter->data;
+		const gchar* sourceUrl = metadata_list_get (item->metadata, "GoogleBroadcastOrigFeed");
+		if (!sourceUrl)
+			sourceUrl = node->subscription->source;
+		google_source_edit_mark_read ((GoogleSourcePtr)root->data, item->sourceId, sourceUrl, TRUE);
+		item_unload (item);
+	}
+	g_slist_free (items);
+}
+
 /* node source type definition */
 
 static struct nodeSourceType nst = {
@@ -375,7 +403,8 @@ static struct nodeSourceType nst = {
 	.item_mark_read      = google_source_item_mark_read,
 	.add_folder          = NULL, 
 	.add_subscription    = google_source_add_subscription,
-	.remove_node         = google_source_remove_node
+	.remove_node         = google_source_remove_node,
+	.items_mark_read     = google_source_items_mark_read
 };
 
 nodeSourceTypePtr
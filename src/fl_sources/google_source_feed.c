@@ -36,6 +36,9 @@
 #include "db.h"
 #include "item_state.h"
 
+/* number of items loaded at once when searching an item by source id */
+#define GOOGLE_SOURCE_LOAD_BATCH_SIZE	100
+
 /**
  * This is identical to xpath_foreach_match, except that it takes the context
  * as parameter.
@@ -58,22 +61,23 @@ google_source_xpath_foreach_match (const gchar* expr, xmlXPathContextPtr xpathCt
 		xmlXPathFreeObject (xpathObj);
 }
 
+static void
+google_source_migrate_item (itemPtr item)
+{
+	if (item->sourceId) {
+		if (!g_str_has_prefix(item->sourceId, "tag:google.com")) {
+			debug1(DEBUG_UPDATE, "Item with sourceId [%s] will be deleted.", item->sourceId);
+			db_item_remove(item->id);
+		} 
+	}
+}
+
 void
 google_source_migrate_node(nodePtr node) 
 {
 	/* scan the node for bad ID's, if so, brutally remove the node */
 	itemSetPtr itemset = node_get_itemset (node);
-	GList *iter = itemset->ids;
-	for (; iter; iter = g_list_next (iter)) {
-		itemPtr item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item && item->sourceId) {
-			if (!g_str_has_prefix(item->sourceId, "tag:google.com")) {
-				debug1(DEBUG_UPDATE, "Item with sourceId [%s] will be deleted.", item->sourceId);
-				db_item_remove(GPOINTER_TO_UINT(iter->data));
-			} 
-		}
-		if (item) item_unload (item);
-	}
+	itemset_foreach (itemset, google_source_migrate_item);
 
 	/* cleanup */
 	itemset_free (itemset);
@@ -143,6 +147,9 @@ google_source_load_item_from_sourceid (nodePtr node, gchar *sourceId, GHashTable
 	itemSetPtr  itemset;
 	int         num = g_hash_table_size (cache);
 	GList       *iter; 
+	GSList      *items, *liter;
+	gulong      ids[GOOGLE_SOURCE_LOAD_BATCH_SIZE];
+	guint       count;
 	itemPtr     item = NULL;
 
 	if (ret) return item_load (GPOINTER_TO_UINT (ret));
@@ -152,17 +159,30 @@ google_source_load_item_from_sourceid (nodePtr node, gchar *sourceId, GHashTable
 	iter = itemset->ids;
 	while (num--) iter = g_list_next (iter);
 
-	for (; iter; iter = g_list_next (iter)) {
-		item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item && item->sourceId) {
-			/* save to cache */
-			g_hash_table_insert (cache, g_strdup(item->sourceId), (gpointer) item->id);
-			if (g_str_equal (item->sourceId, sourceId)) {
-				itemset_free (itemset);
-				return item;
+	/* load the remaining items in batches until the item is found */
+	while (iter && !item) {
+		for (count = 0; iter && (count < GOOGLE_SOURCE_LOAD_BATCH_SIZE); iter = g_list_next (iter))
+			ids[count++] = GPOINTER_TO_UINT (iter->data);
+
+		items = db_items_load_many (ids, count);
+		for (liter = items; liter; liter = g_slist_next (liter)) {
+			itemPtr candidate = (itemPtr)liter->data;
+			if (candidate->sourceId) {
+				/* save to cache */
+				g_hash_table_insert (cache, g_strdup(candidate->sourceId), (gpointer) candidate->id);
+				if (!item && g_str_equal (candidate->sourceId, sourceId)) {
+					item = candidate;
+					continue;
+				}
 			}
+			item_unload (candidate);
 		}
-		item_unload (item);
+		g_slist_free (items);
+	}
+
+	if (item) {
+		itemset_free (itemset);
+		return item;
 	}
 
 	g_warning ("Could not find item for %s!", sourceId);
@@ -233,7 +253,7 @@ google_feed_subscription_process_update_result (subscriptionPtr subscription, co
 		resultCopy->source = g_strdup (result->source); 
 		resultCopy->httpstatus = result->httpstatus;
 		resultCopy->contentType = g_strdup (result->contentType);
-		g_free (resultCopy->updateState);
+		update_state_free (resultCopy->updateState);
 		resultCopy->updateState = update_state_copy (result->updateState);
 		
 		/* update the XML by removing 'read', 'reading-list' etc. as labels. */
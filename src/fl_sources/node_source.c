@@ -344,6 +344,16 @@ node_source_item_mark_read (nodePtr node, itemPtr item, gboolean newState)
 		item_read_state_changed (item, newState);
 }
 
+void
+node_source_items_mark_read (nodePtr node, GSList *ids)
+{
+	/* Batch read state changes are already applied locally,
+	   so there is nothing to do without remote syncing. */
+
+	if (NODE_SOURCE_TYPE (node)->items_mark_read)
+		NODE_SOURCE_TYPE (node)->items_mark_read (node, ids);
+}
+
 void
 node_source_item_set_flag (nodePtr node, itemPtr item, gboolean newState)
 {
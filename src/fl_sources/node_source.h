@@ -172,6 +172,16 @@ typedef struct nodeSourceType {
 	 */
 	void		(*remove_node) (nodePtr node, nodePtr child);
 
+	/**
+	 * Called after a batch of items of the given node was marked
+	 * read locally (e.g. by "Mark all read") to allow node source 
+	 * type implementations to synchronize the remote item states 
+	 * at once. item_mark_read() is not called for such items.
+	 *
+	 * This is an OPTIONAL method.
+	 */
+	void		(*items_mark_read) (nodePtr node, GSList *ids);
+
 } *nodeSourceTypePtr;
 
 /** feed list source instance */
@@ -266,6 +276,14 @@ nodePtr node_source_add_folder (nodePtr node, const gchar *title);
  */
 void node_source_item_mark_read (nodePtr node, itemPtr item, gboolean newState);
 
+/**
+ * Called after a batch of items was marked read locally.
+ *
+ * @param node		the node the items belong to
+ * @param ids		list of the ids of the affected items
+ */
+void node_source_items_mark_read (nodePtr node, GSList *ids);
+
 /**
  * Called when the flag state of an item changes.
  *
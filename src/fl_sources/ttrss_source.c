@@ -357,6 +357,45 @@ ttrss_source_item_mark_read (nodePtr node, itemPtr item, gboolean newStatus)
 	item_read_state_changed (item, newStatus);
 }
 
+static void
+ttrss_source_items_mark_read (nodePtr node, GSList *ids)
+{
+	nodePtr			root = node_source_root_from_node (node);
+	ttrssSourcePtr		source = (ttrssSourcePtr)root->data;
+	updateRequestPtr	request;
+	GString			*articleIds;
+	gchar			*url;
+
+	/* updateArticle accepts a comma separated list of ids */
+	articleIds = g_string_new (NULL);
+	while (ids) {
+		itemPtr item = item_load (GPOINTER_TO_UINT (ids->data));
+		if (item) {
+			if (articleIds->len)
+				g_string_append_c (articleIds, ',');
+			g_string_append (articleIds, item_get_id (item));
+			item_unload (item);
+		}
+		ids = g_slist_next (ids);
+	}
+
+	if (articleIds->len) {
+		request = update_request_new ();
+		request->options = update_options_copy (root->subscription->updateOptions);
+
+		url = g_strdup_printf (TTRSS_UPDATE_ITEM_UNREAD,
+		                       metadata_list_get (root->subscription->metadata, "ttrss-url"),
+		                       source->session_id,
+		                       articleIds->str, 0);
+		update_request_set_source (request, url);
+		g_free (url);
+
+		update_execute_request (source, request, ttrss_source_remote_update_cb, source, 0 /* flags */);
+	}
+
+	g_string_free (articleIds, TRUE);
+}
+
 /* node source type definition */
 
 static struct nodeSourceType nst = {
@@ -380,7 +419,8 @@ static struct nodeSourceType nst = {
 	.item_mark_read      = ttrss_source_item_mark_read,
 	.add_folder          = NULL,	/* not supported by current tt-rss JSON API (v1.5) */
 	.add_subscription    = NULL,	/* not supported by current tt-rss JSON API (v1.5) */
-	.remove_node         = NULL	/* not supported by current tt-rss JSON API (v1.5) */
+	.remove_node         = NULL,	/* not supported by current tt-rss JSON API (v1.5) */
+	.items_mark_read     = ttrss_source_items_mark_read
 };
 
 nodeSourceTypePtr
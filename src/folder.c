@@ -26,6 +26,7 @@
 #include "feedlist.h"
 #include "itemset.h"
 #include "node.h"
+#include "vfolder.h"
 #include "ui/icons.h"
 #include "ui/ui_folder.h"
 #include "ui/ui_node.h"
@@ -85,6 +86,10 @@ folder_add_child_update_counters (nodePtr node, gpointer user_data)
 {
 	guint	*unreadCount = (guint *)user_data;
 
+	/* Search folders only count items of other feeds */
+	if (IS_VFOLDER (node))
+		return;
+
 	*unreadCount += node->unreadCount;
 }
 
@@ -18,10 +18,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <locale.h>
 #include <string.h>
+#include <time.h>
 #include <libxml/uri.h>
 
 #include "common.h"
+#include "conf.h"
+#include "db.h"
 #include "debug.h"
 #include "feed.h"
 #include "folder.h"
@@ -32,6 +36,17 @@
 #include "vfolder.h"
 #include "ui/liferea_htmlview.h"
 
+/* Rendered items are kept in the chunk list of the displayed node
+   and additionally in the persistent HTML cache of the DB (see
+   db_html_cache_get()), so that switching back to a node or item
+   does not need to run the XSLT again. The DB cache is keyed by
+   item id and all rendering parameters, item changes drop cached
+   renderings by DB triggers and by htmlview_update_item(). */
+
+#define DEFAULT_HTML_CACHE_SIZE	16384	/**< default persistent HTML cache size in kB */
+
+#define COMBINED_VIEW_WINDOW_SIZE	500	/**< number of items added to the combined view at once */
+
 // FIXME: namespace clash of LifereaHtmlView *htmlview and htmlView_priv 
 // clearly shows the need to merge htmlview.c and src/ui/ui_htmlview.c,
 // maybe with a separate a HTML cache object...
@@ -39,30 +54,64 @@
 static struct htmlView_priv 
 {
 	GHashTable	*chunkHash;	/**< cache of HTML chunks of all displayed items */
-	GSList		*orderedChunks;	/**< ordered list of chunks */
+	GSequence	*orderedChunks;	/**< chunks sorted by date (newest first) */
+	guint		batch;		/**< nesting level of htmlview_begin_batch() */
+	gboolean	unsorted;	/**< TRUE if chunks were appended during a batch */
 	nodePtr		node;		/**< the node whose items are displayed */
 	guint		missingContent;	/**< counter for items without content */
+	gboolean	cacheChanged;	/**< TRUE if renderings were added to the persistent HTML cache */
+	guint		windowSize;	/**< number of newest items rendered in combined view */
 } htmlView_priv;
 
 typedef struct htmlChunk 
 {
 	gulong 		id;	/**< item id */
+	gchar		*nodeId;	/**< id of the item's node */
 	gchar		*html;	/**< the rendered HTML (or NULL if not yet rendered) */
 	time_t		date;	/**< date as sorting criteria */
+	GSequenceIter	*iter;	/**< position in the ordered chunks */
 } *htmlChunkPtr;
 
 static void
 htmlview_chunk_free (htmlChunkPtr chunk) 
 {
+	g_free (chunk->nodeId);
 	g_free (chunk->html);
 	g_free (chunk);
 }
 
 static gint
 htmlview_chunk_sort (gconstpointer a,
-                     gconstpointer b) 
+                     gconstpointer b,
+                     gpointer user_data) 
 {
-	return (((htmlChunkPtr)a)->date) - (((htmlChunkPtr)b)->date);
+	htmlChunkPtr	c1 = (htmlChunkPtr)a;
+	htmlChunkPtr	c2 = (htmlChunkPtr)b;
+
+	/* newest first, the item id makes the order unique */
+	if (c1->date != c2->date)
+		return (c1->date > c2->date)?-1:1;
+	if (c1->id != c2->id)
+		return (c1->id > c2->id)?-1:1;
+
+	return 0;
+}
+
+/* Returns the iterators of the given window of the ordered
+   chunks, the end iterator points behind the window. */
+static void
+htmlview_get_chunk_window (guint offset,
+                           guint count,
+                           GSequenceIter **begin,
+                           GSequenceIter **end)
+{
+	guint	length = g_sequence_get_length (htmlView_priv.orderedChunks);
+
+	offset = MIN (offset, length);
+	count = MIN (count, length - offset);
+
+	*begin = g_sequence_get_iter_at_pos (htmlView_priv.orderedChunks, offset);
+	*end = g_sequence_get_iter_at_pos (htmlView_priv.orderedChunks, offset + count);
 }
 
 void 
@@ -70,6 +119,8 @@ htmlview_init (void)
 {
 	htmlView_priv.chunkHash = NULL;
 	htmlView_priv.orderedChunks = NULL;
+	htmlView_priv.batch = 0;
+	htmlView_priv.windowSize = COMBINED_VIEW_WINDOW_SIZE;
 	htmlview_clear ();
 }
 
@@ -79,18 +130,13 @@ htmlview_clear (void)
 	if (htmlView_priv.chunkHash)
 		g_hash_table_destroy (htmlView_priv.chunkHash);
 
-	GSList	*iter = htmlView_priv.orderedChunks;
-	while (iter)
-	{
-		htmlview_chunk_free (iter->data);
-		iter = g_slist_next (iter);
-	}
-
+	/* frees all chunks */
 	if (htmlView_priv.orderedChunks)
-		g_slist_free (htmlView_priv.orderedChunks);
+		g_sequence_free (htmlView_priv.orderedChunks);
 	
 	htmlView_priv.chunkHash = g_hash_table_new (g_direct_hash, g_direct_equal);
-	htmlView_priv.orderedChunks = NULL;
+	htmlView_priv.orderedChunks = g_sequence_new ((GDestroyNotify)htmlview_chunk_free);
+	htmlView_priv.unsorted = FALSE;
 	htmlView_priv.missingContent = 0;
 }
 
@@ -99,22 +145,40 @@ htmlview_set_displayed_node (nodePtr node)
 {
 	g_assert (0 == g_hash_table_size (htmlView_priv.chunkHash));
 	htmlView_priv.node = node;
+	htmlView_priv.windowSize = COMBINED_VIEW_WINDOW_SIZE;
 }
 
 void
-htmlview_add_item (itemPtr item) 
+htmlview_show_more (void)
+{
+	htmlView_priv.windowSize += COMBINED_VIEW_WINDOW_SIZE;
+}
+
+void
+htmlview_add_entry (itemListEntryPtr entry) 
 {
 	htmlChunkPtr	chunk;
 	
-	debug1 (DEBUG_HTML, "HTML view: adding \"%s\"", item_get_title (item));
+	if (g_hash_table_lookup (htmlView_priv.chunkHash, GUINT_TO_POINTER (entry->id)))
+		return;
+
+	debug1 (DEBUG_HTML, "HTML view: adding item %lu", entry->id);
 
 	chunk = g_new0 (struct htmlChunk, 1);
-	chunk->id = item->id;
-	g_hash_table_insert (htmlView_priv.chunkHash, GUINT_TO_POINTER (item->id), chunk);
+	chunk->id = entry->id;
+	chunk->nodeId = g_strdup (entry->nodeId);
+	chunk->date = entry->time;
+	g_hash_table_insert (htmlView_priv.chunkHash, GUINT_TO_POINTER (entry->id), chunk);
 	
-	htmlView_priv.orderedChunks = g_slist_insert_sorted (htmlView_priv.orderedChunks, chunk, htmlview_chunk_sort);
+	/* During batches chunks are sorted once at the end */
+	if (htmlView_priv.batch) {
+		chunk->iter = g_sequence_append (htmlView_priv.orderedChunks, chunk);
+		htmlView_priv.unsorted = TRUE;
+	} else {
+		chunk->iter = g_sequence_insert_sorted (htmlView_priv.orderedChunks, chunk, htmlview_chunk_sort, NULL);
+	}
 		
-	if (!item_get_description (item) || (0 == strlen (item_get_description (item))))
+	if (!entry->hasContent)
 		htmlView_priv.missingContent++;	
 }
 
@@ -129,11 +193,28 @@ htmlview_remove_item (itemPtr item)
 	if (chunk) 
 	{
 		g_hash_table_remove (htmlView_priv.chunkHash, GUINT_TO_POINTER (item->id));
-		htmlView_priv.orderedChunks = g_slist_remove (htmlView_priv.orderedChunks, chunk);
-		htmlview_chunk_free (chunk);
+		g_sequence_remove (chunk->iter);	/* frees the chunk */
 	}
 }
 
+void
+htmlview_begin_batch (void)
+{
+	htmlView_priv.batch++;
+}
+
+void
+htmlview_end_batch (void)
+{
+	g_assert (htmlView_priv.batch > 0);
+	if (--htmlView_priv.batch > 0)
+		return;
+
+	if (htmlView_priv.unsorted)
+		g_sequence_sort (htmlView_priv.orderedChunks, htmlview_chunk_sort, NULL);
+	htmlView_priv.unsorted = FALSE;
+}
+
 void
 htmlview_select_item (itemPtr item) 
 {
@@ -146,6 +227,10 @@ htmlview_update_item (itemPtr item)
 {
 	htmlChunkPtr	chunk;
 	
+	/* the rendering includes the comment feed state, which
+	   the DB triggers do not know about */
+	db_html_cache_remove (item->id);
+
 	/* ensure rerendering on next update by replace old HTML chunk with NULL */
 	chunk = (htmlChunkPtr) g_hash_table_lookup (htmlView_priv.chunkHash, GUINT_TO_POINTER (item->id));
 	if (chunk) 
@@ -155,16 +240,19 @@ htmlview_update_item (itemPtr item)
 	}
 }
 
+static void
+htmlview_chunk_reset (gpointer data, gpointer user_data)
+{
+	htmlChunkPtr chunk = (htmlChunkPtr)data;
+
+	g_free (chunk->html);
+	chunk->html = NULL;
+}
+
 void
 htmlview_update_all_items (void)
 {
-	GSList	*iter = htmlView_priv.orderedChunks;
-	while (iter) {
-		htmlChunkPtr chunk = (htmlChunkPtr)iter->data;
-		g_free (chunk->html);
-		chunk->html = NULL;
-		iter = g_slist_next (iter);
-	}
+	g_sequence_foreach (htmlView_priv.orderedChunks, htmlview_chunk_reset, NULL);
 }
 
 static const gchar *
@@ -236,6 +324,67 @@ htmlview_render_item (itemPtr item,
 	return output;
 }
 
+/* Returns the persistent HTML cache key for all rendering
+   parameters besides the item itself. CSS and theme colors are
+   not part of the item HTML and need not be considered. */
+static gchar *
+htmlview_get_render_key (nodePtr node, guint viewMode, gboolean summaryMode)
+{
+	struct tm	today;
+	time_t		now = time (NULL);
+	gboolean	parseErrors = FALSE;
+
+	/* the date is needed for "Today" and "Yesterday" dates */
+	localtime_r (&now, &today);
+
+	if (IS_FEED (node)) {
+		feedPtr feed = (feedPtr)node->data;
+		parseErrors = feed->parseErrors && (feed->parseErrors->len > 0);
+	}
+
+	return g_strdup_printf ("%s|%u|%d|%s|%s|%04d%02d%02d|%s|%s|%d|%d",
+	                        VERSION, viewMode, summaryMode?1:0,
+	                        setlocale (LC_MESSAGES, NULL),
+	                        common_get_app_direction (),
+	                        today.tm_year + 1900, today.tm_mon + 1, today.tm_mday,
+	                        node_get_base_url (node)?node_get_base_url (node):"",
+	                        node_get_title (node)?node_get_title (node):"",
+	                        node->available?1:0, parseErrors?1:0);
+}
+
+/* Returns the HTML of the given item from the persistent HTML
+   cache or renders it. The item is loaded only when rendering. */
+static gchar *
+htmlview_get_item_html (gulong id, const gchar *nodeId, guint viewMode, gboolean summaryMode, gboolean useCache)
+{
+	nodePtr		node = node_from_id (nodeId);
+	itemPtr		item;
+	gchar		*key = NULL, *html = NULL;
+
+	if (node && useCache) {
+		key = htmlview_get_render_key (node, viewMode, summaryMode);
+		html = db_html_cache_get (id, key);
+	}
+
+	if (!html) {
+		item = item_load (id);
+		if (item) {
+			debug1 (DEBUG_HTML, "rendering item to HTML view: >>>%s<<<", item_get_title (item));
+			html = htmlview_render_item (item, viewMode, summaryMode);
+			item_unload (item);
+		}
+
+		if (html && key) {
+			db_html_cache_store (id, key, html);
+			htmlView_priv.cacheChanged = TRUE;
+		}
+	}
+
+	g_free (key);
+
+	return html;
+}
+
 void 
 htmlview_start_output (GString *buffer,
                        const gchar *base,
@@ -310,11 +459,13 @@ htmlview_finish_output (GString *buffer)
 void
 htmlview_update (LifereaHtmlView *htmlview, itemViewMode mode) 
 {
-	GSList		*iter;
+	GSequenceIter	*iter, *end;
+	guint		count;
 	GString		*output;
 	itemPtr		item = NULL;
 	gchar		*baseURL = NULL;
 	gboolean	summaryMode;
+	gint		cacheSize;
 		
 	/* determine base URL */
 	switch (mode) {
@@ -337,6 +488,11 @@ htmlview_update (LifereaHtmlView *htmlview, itemViewMode mode)
 	output = g_string_new (NULL);
 	htmlview_start_output (output, baseURL, TRUE, TRUE);
 
+	if (!conf_get_int_value (HTML_CACHE_SIZE, &cacheSize))
+		cacheSize = DEFAULT_HTML_CACHE_SIZE;
+	htmlView_priv.cacheChanged = FALSE;
+	db_begin_batch ();
+
 	/* HTML view updating means checking which items
 	   need to be updated, render them and then 
 	   concatenate everything from cache and output it */
@@ -344,7 +500,7 @@ htmlview_update (LifereaHtmlView *htmlview, itemViewMode mode)
 		case ITEMVIEW_SINGLE_ITEM:
 			item = itemlist_get_selected ();
 			if (item) {
-				gchar *html = htmlview_render_item (item, mode, FALSE);
+				gchar *html = htmlview_get_item_html (item->id, item->nodeId, mode, FALSE, cacheSize > 0);
 				if (html) {
 					g_string_append (output, html);
 					g_free (html);
@@ -365,26 +521,30 @@ htmlview_update (LifereaHtmlView *htmlview, itemViewMode mode)
 	        		      !IS_VFOLDER (htmlView_priv.node) && 
 	        		      (htmlView_priv.missingContent > 3);
 
-			/* concatenate all items */
-			iter = htmlView_priv.orderedChunks;
-			while (iter) {
+			/* concatenate the newest items, older items are neither
+			   loaded nor rendered until the user asks for them */
+			count = g_sequence_get_length (htmlView_priv.orderedChunks);
+			htmlview_get_chunk_window (0, htmlView_priv.windowSize, &iter, &end);
+			while (iter != end) {
 				/* try to retrieve item HTML chunk from cache */
-				htmlChunkPtr chunk = (htmlChunkPtr)iter->data;
+				htmlChunkPtr chunk = (htmlChunkPtr)g_sequence_get (iter);
 				
-				/* if not found: render new item now and add to cache */
-				if (!chunk->html) {
-					item = item_load (chunk->id);
-					if (item) {
-						debug1 (DEBUG_HTML, "rendering item to HTML view: >>>%s<<<", item_get_title (item));
-						chunk->html = htmlview_render_item (item, mode, summaryMode);
-						item_unload (item);
-					}
-				}
+				/* if not found: get it from the persistent cache or render it */
+				if (!chunk->html)
+					chunk->html = htmlview_get_item_html (chunk->id, chunk->nodeId, mode, summaryMode, cacheSize > 0);
 				
 				if (chunk->html)
 					g_string_append (output, chunk->html);
 					
-				iter = g_slist_next (iter);
+				iter = g_sequence_iter_next (iter);
+			}
+
+			if (count > htmlView_priv.windowSize) {
+				count -= htmlView_priv.windowSize;
+				g_string_append (output, "<p>");
+				g_string_append_printf (output, ngettext ("%u older item is not shown.", "%u older items are not shown.", count), count);
+				g_string_append_printf (output, " <a href=\"liferea-show-more://\">%s</a>", _("Show more"));
+				g_string_append (output, "</p>");
 			}
 			break;
 		case ITEMVIEW_NODE_INFO:
@@ -405,6 +565,10 @@ htmlview_update (LifereaHtmlView *htmlview, itemViewMode mode)
 			break;
 	}
 	
+	if (htmlView_priv.cacheChanged)
+		db_html_cache_expire ((gint64)cacheSize * 1024);
+	db_end_batch ();
+
 	htmlview_finish_output (output);
 
 	debug1 (DEBUG_HTML, "writing %d bytes to HTML view", strlen (output->str));
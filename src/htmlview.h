@@ -21,6 +21,7 @@
 #ifndef _HTMLVIEW_H
 #define _HTMLVIEW_H
 
+#include "db.h"
 #include "item.h"
 #include "node.h"
 #include "ui/itemview.h"
@@ -45,15 +46,37 @@ void	htmlview_clear (void);
  */
 void	htmlview_set_displayed_node (nodePtr node);
 
+/**
+ * Extends the number of items rendered in combined view by
+ * another window of older items. Displaying another node
+ * resets it.
+ *
+ * This method _DOES NOT_ update the rendering output.
+ */
+void	htmlview_show_more (void);
+
 /**
  * Adds an item to the HTML view for rendering. The item must belong
  * to the item set that was announced with htmlview_set_displayed_node().
+ * The item itself is loaded only when it is rendered.
  *
  * This method _DOES NOT_ update the rendering output.
  *
- * @param item		the item to add to the rendering output
+ * @param entry		the item list entry of the item to add
+ */
+void	htmlview_add_entry (itemListEntryPtr entry);
+
+/**
+ * Starts a batch of htmlview_add_entry() calls. The added
+ * items are sorted once when the batch ends. Batches may
+ * be nested.
+ */
+void	htmlview_begin_batch (void);
+
+/**
+ * Ends a batch started with htmlview_begin_batch().
  */
-void	htmlview_add_item (itemPtr item);
+void	htmlview_end_batch (void);
 
 /**
  * Removes a given item from the HTML view rendering.
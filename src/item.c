@@ -162,6 +162,25 @@ item_make_link (itemPtr item)
 	return link;
 }
 
+gchar *
+item_get_content_hash (const gchar *title, const gchar *description)
+{
+	GChecksum	*checksum;
+	gchar		*hash;
+
+	checksum = g_checksum_new (G_CHECKSUM_MD5);
+	if (title)
+		g_checksum_update (checksum, (const guchar *)title, -1);
+	/* separator to avoid title/description boundary shifts matching */
+	g_checksum_update (checksum, (const guchar *)"\n", 1);
+	if (description)
+		g_checksum_update (checksum, (const guchar *)description, -1);
+	hash = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return hash;
+}
+
 void
 item_unload (itemPtr item) 
 {
@@ -193,7 +212,6 @@ item_to_xml (itemPtr item, xmlNodePtr parentNode)
 	xmlNodePtr	duplicatesNode;		
 	xmlNodePtr	itemNode;
 	gchar		*tmp;
-	gchar		*tmp2;
 	
 	itemNode = xmlNewChild (parentNode, NULL, "item", NULL);
 	g_return_if_fail (itemNode);
@@ -201,11 +219,9 @@ item_to_xml (itemPtr item, xmlNodePtr parentNode)
 	xmlNewTextChild (itemNode, NULL, "title", item_get_title (item)?item_get_title (item):"");
 
 	if (item_get_description (item)) {
-		tmp = xhtml_strip_dhtml (item_get_description (item));
-		tmp2 = xhtml_strip_unsupported_tags (tmp);
-		xmlNewTextChild (itemNode, NULL, "description", tmp2);
+		tmp = xhtml_sanitize (item_get_description (item), XHTML_SANITIZE_STRIP_UNSUPPORTED);
+		xmlNewTextChild (itemNode, NULL, "description", tmp);
 		g_free (tmp);
-		g_free (tmp2);
 	}
 	
 	if (item_get_source (item))
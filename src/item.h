@@ -58,7 +58,7 @@ typedef struct item {
 	gboolean	validGuid;		/**< TRUE if id of this item is a GUID and can be used for duplicate detection */
 	gchar		*description;		/**< XHTML string containing the item's description */
 	
-	GSList		*metadata;		/**< Metadata of this item */
+	struct metadataList *metadata;		/**< Metadata of this item */
 	GHashTable	*tmpdata;		/**< Temporary data hash used during stateful parsing */
 	time_t		time;			/**< Last modified date of the headline */
 
@@ -108,6 +108,18 @@ itemPtr		item_copy(itemPtr item);
  */
 const gchar * item_get_base_url(itemPtr item);
 
+/**
+ * Calculates a hash of the given item content which is used
+ * to detect content changes and to match items without id
+ * while merging.
+ *
+ * @param title		the item title (or NULL)
+ * @param description	the item description (or NULL)
+ *
+ * @returns newly allocated hash string to be free'd using g_free()
+ */
+gchar * item_get_content_hash (const gchar *title, const gchar *description);
+
 /**
  * Free the memory used by an itempointer. The item needs to be
  * removed from the itemlist before calling this function.
@@ -30,12 +30,6 @@
 #include "vfolder.h"
 #include "fl_sources/node_source.h"
 
-static void
-item_state_set_recount_flag (nodePtr node)
-{
-	node->needsRecount = TRUE;
-}
-
 void
 item_set_flag_state (itemPtr item, gboolean newState) 
 {	
@@ -52,7 +46,7 @@ item_flag_state_changed (itemPtr item, gboolean newState)
 	item->flagStatus = newState;
 
 	/* 2. propagate to vfolders */
-	vfolder_foreach_data (vfolder_merge_item, item);
+	vfolder_item_changed (item, RULE_FIELD_FLAG);
 	vfolder_foreach (node_update_counters);
 
 	/* 3. save state to DB */
@@ -94,7 +88,7 @@ item_read_state_changed (itemPtr item, gboolean newState)
 	item->updateStatus = FALSE;
 
 	/* 2. propagate to vfolders */
-	vfolder_foreach_data (vfolder_merge_item, item);
+	vfolder_item_changed (item, RULE_FIELD_READ);
 	vfolder_foreach (node_update_counters);
 	
 	/* 3. apply to DB */
@@ -135,59 +129,74 @@ item_read_state_changed (itemPtr item, gboolean newState)
 	debug_end_measurement (DEBUG_GUI, "set read status");
 }
 
+/* collects the ids of the given node and all its child nodes */
+static void
+itemset_mark_read_collect (nodePtr node, gpointer user_data)
+{
+	GSList	**nodeIds = (GSList **)user_data;
+
+	/* Search folders only show items of other nodes */
+	if (IS_VFOLDER (node))
+		return;
+
+	*nodeIds = g_slist_prepend (*nodeIds, node->id);
+	node_foreach_child_data (node, itemset_mark_read_collect, nodeIds);
+}
+
+/* propagates the read state changes of a single node */
+static void
+itemset_mark_read_propagate (gpointer key, gpointer value, gpointer user_data)
+{
+	nodePtr	node = node_from_id ((gchar *)key);
+	GSList	*ids = (GSList *)value;
+
+	vfolder_items_read (ids);
+
+	/* The check on node_from_id() is the same workaround
+	   for "lost" items as in item_read_state_changed() */
+	if (!node) {
+		g_warning ("itemset_mark_read() on lost items (node id=%s)!", (gchar *)key);
+		return;
+	}
+
+	node->needsUpdate = TRUE;
+	node_source_items_mark_read (node, ids);
+}
+
 /**
  * In difference to all the other item state handling methods
- * item_state_set_all_read does not immediately apply the 
- * changes to the GUI because it is usually called recursively
- * and would be to slow. Instead the node structure flag for
- * recounting is set. By calling feedlist_update() afterwards
- * those recounts are executed and applied to the GUI.
+ * itemset_mark_read does not immediately apply the changes
+ * to the GUI because it would be too slow. All unread items
+ * of the node, its child nodes and all their duplicates are
+ * marked read with a single DB update. Afterwards the node
+ * counters need to be refreshed (see feedlist_mark_all_read()).
  */
 void
 itemset_mark_read (nodePtr node)
 {
-	itemSetPtr	itemSet;
+	GHashTable	*changes;
 	
 	if (!node->unreadCount)
 		return;
-	
-	itemSet = node_get_itemset (node);
-	GList *iter = itemSet->ids;
-	while (iter) {
-		gulong id = GPOINTER_TO_UINT (iter->data);
-		itemPtr item = item_load (id);
-		if (item) {
-			if (!item->readStatus) {
-				nodePtr node;
-				
-				node = node_from_id (item->nodeId);
-				if (node) {
-					item_state_set_recount_flag (node);
-					node_source_item_mark_read (node, item, TRUE);
-				} else {
-					g_warning ("itemset_mark_read() on lost item (id=%lu, node id=%s)!", item->id, item->nodeId);
-				}
-
-				debug_start_measurement (DEBUG_GUI);
-
-				GSList *duplicates = db_item_get_duplicate_nodes (item->sourceId);
-				GSList *duplicate = duplicates;
-				while (duplicate) {
-					gchar *nodeId = (gchar *)duplicate->data;
-					nodePtr affectedNode = node_from_id (nodeId);
-					if (affectedNode)
-						item_state_set_recount_flag (affectedNode);
-					g_free (nodeId);
-					duplicate = g_slist_next (duplicate);
-				}
-				g_slist_free(duplicates);
-
-				debug_end_measurement (DEBUG_GUI, "mark read of duplicates");
-			}
-			item_unload (item);
-		}
-		iter = g_list_next (iter);
+
+	debug_start_measurement (DEBUG_GUI);
+
+	if (IS_VFOLDER (node)) {
+		changes = db_items_mark_read (((vfolderPtr)node->data)->itemset->ids);
+	} else {
+		GSList *nodeIds = NULL;
+
+		itemset_mark_read_collect (node, &nodeIds);
+		changes = db_itemset_mark_read (nodeIds);
+		g_slist_free (nodeIds);
 	}
+
+	g_hash_table_foreach (changes, itemset_mark_read_propagate, NULL);
+	g_hash_table_destroy (changes);
+
+	vfolder_foreach (node_update_counters);
+
+	debug_end_measurement (DEBUG_GUI, "mark all read");
 }
 
 void
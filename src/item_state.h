@@ -59,9 +59,11 @@ void item_set_read_state (itemPtr item, gboolean newState);
 void item_read_state_changed (itemPtr item, gboolean newState);
 
 /**
- * Requests to mark read all items in the given nodes item list.
+ * Requests to mark read all items in the given nodes item list
+ * and the item lists of all its child nodes using set-based DB
+ * updates. Node sources are notified in one batch per node.
  *
- * @param nodeId	the node whose item list is to be modified
+ * @param node		the node whose item list is to be modified
  */
 void itemset_mark_read (nodePtr node);
 
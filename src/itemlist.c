@@ -98,23 +98,26 @@ itemlist_duplicate_list_remove_item (itemPtr item)
 	g_hash_table_remove (itemlist->priv->guids, item->sourceId);
 }
 
+/* The duplicate list functions take the item source id
+   if it is a valid GUID and NULL otherwise */
+
 static void
-itemlist_duplicate_list_add_item (itemPtr item)
+itemlist_duplicate_list_add (const gchar *guid, gulong id)
 {
-	if (!item->validGuid)
+	if (!guid)
 		return;
 	if (!itemlist->priv->guids)
 		itemlist->priv->guids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	g_hash_table_insert (itemlist->priv->guids, g_strdup (item->sourceId), GUINT_TO_POINTER (item->id));
+	g_hash_table_insert (itemlist->priv->guids, g_strdup (guid), GUINT_TO_POINTER (id));
 }
 
 static gboolean
-itemlist_duplicate_list_check_item (itemPtr item)
+itemlist_duplicate_list_check (const gchar *guid)
 {
-	if (!itemlist->priv->guids || !item->validGuid)
+	if (!itemlist->priv->guids || !guid)
 		return TRUE;
 
-	return (NULL == g_hash_table_lookup (itemlist->priv->guids, item->sourceId));
+	return (NULL == g_hash_table_lookup (itemlist->priv->guids, guid));
 }
 
 static void
@@ -221,13 +224,15 @@ itemlist_filter_check_item (itemPtr item)
 static void
 itemlist_merge_item (itemPtr item) 
 {
-	if (!itemlist_duplicate_list_check_item (item))
+	const gchar *guid = item->validGuid?item->sourceId:NULL;
+
+	if (!itemlist_duplicate_list_check (guid))
 		return;		
 		
 	if (!itemlist_filter_check_item (item))
 		return;
 		
-	itemlist_duplicate_list_add_item (item);
+	itemlist_duplicate_list_add (guid, item->id);
 	itemview_add_item (item);
 }
 
@@ -258,18 +263,70 @@ itemlist_itemset_is_valid (itemSetPtr itemSet)
 	return TRUE;
 }
 
+/* Returns the ids of the given item set that are not yet
+   displayed and, when displaying a search folder, are
+   members of the search folder. */
+static GList *
+itemlist_get_new_ids (itemSetPtr itemSet)
+{
+	nodePtr	node = itemlist->priv->currentNode;
+	GList	*iter, *ids = NULL;
+
+	for (iter = itemSet->ids; iter; iter = g_list_next (iter)) {
+		gulong id = GPOINTER_TO_UINT (iter->data);
+
+		if (itemview_contains_id (id))
+			continue;
+		if (IS_VFOLDER (node) && !vfolder_has_item_id ((vfolderPtr)node->data, id))
+			continue;
+
+		ids = g_list_prepend (ids, iter->data);
+	}
+
+	return ids;
+}
+
 /**
  * To be called whenever an itemset was updated. If it is the
  * displayed itemset it will be merged against the item view.
+ *
+ * The items are not loaded. The item list filter is applied
+ * and duplicates are dropped by the DB, the item view loads
+ * items only when displaying them.
  */
 void
 itemlist_merge_itemset (itemSetPtr itemSet) 
 {
+	GList	*ids;
+	GSList	*entries, *iter;
+	gchar	*condition = NULL;
+
 	debug_enter ("itemlist_merge_itemset");
 	
 	if (itemlist_itemset_is_valid (itemSet)) {
 		debug_start_measurement (DEBUG_GUI);
-		itemset_foreach (itemSet, itemlist_merge_item);
+
+		/* the filter only hides read items, which SQL can do */
+		if (itemlist->priv->filter)
+			condition = itemset_to_sql (itemlist->priv->filter);
+
+		ids = itemlist_get_new_ids (itemSet);
+		entries = db_item_list_entries_load (ids, condition);
+		g_list_free (ids);
+		g_free (condition);
+
+		itemview_begin_batch ();
+		for (iter = entries; iter; iter = g_slist_next (iter)) {
+			itemListEntryPtr entry = (itemListEntryPtr)iter->data;
+
+			if (itemlist_duplicate_list_check (entry->sourceId)) {
+				itemlist_duplicate_list_add (entry->sourceId, entry->id);
+				itemview_add_entry (entry);
+			}
+			db_item_list_entry_free (entry);
+		}
+		g_slist_free (entries);
+		itemview_end_batch ();
 		itemview_update ();
 		debug_end_measurement (DEBUG_GUI, "itemlist merge");
 	}
@@ -495,49 +552,68 @@ itemlist_request_remove_item (itemPtr item)
 	}
 }
 
-void
-itemlist_remove_items (itemSetPtr itemSet, GList *items)
-{
-	GList		*iter = items;
-	
-	while (iter) {
-		itemPtr item = (itemPtr) iter->data;
+guint
+itemlist_remove_item_ids (GArray *ids)
+{
+	GArray		*shown;
+	GSList		*loaded, *iter;
+	guint		i;
+
+	/* never remove the selected item to avoid disturbing the user,
+	   it is removed with a later retention run */
+	for (i = 0; i < ids->len; i++) {
+		if (itemlist->priv->selectedId == g_array_index (ids, gulong, i)) {
+			g_array_remove_index_fast (ids, i);
+			break;
+		}
+	}
 
-		vfolder_foreach_data (vfolder_remove_item, item);
+	if (!ids->len)
+		return 0;
 
-		if (itemlist->priv->selectedId != item->id) {
-			/* don't call itemlist_remove_item() here, because it's to slow */
-			itemview_remove_item (item);
-			db_item_remove (item->id);
-		} else {
-			/* go the normal and selection-safe way to avoid disturbing the user */
-			itemlist_request_remove_item (item);
-		}
-		item_unload (item);
-		iter = g_list_next (iter);
+	vfolder_items_removed ((gulong *)ids->data, ids->len);
+
+	/* only the displayed items need to be loaded */
+	shown = g_array_new (FALSE, FALSE, sizeof (gulong));
+	for (i = 0; i < ids->len; i++) {
+		gulong id = g_array_index (ids, gulong, i);
+		if (itemview_contains_id (id))
+			g_array_append_val (shown, id);
 	}
 
-	itemview_update ();
-	node_update_counters (node_from_id (itemSet->nodeId));
+	if (shown->len) {
+		loaded = db_items_load_many ((gulong *)shown->data, shown->len);
+		for (iter = loaded; iter; iter = g_slist_next (iter))
+			itemlist_duplicate_list_remove_item ((itemPtr)iter->data);
+
+		itemview_remove_items (loaded);
+
+		for (iter = loaded; iter; iter = g_slist_next (iter))
+			item_unload ((itemPtr)iter->data);
+		g_slist_free (loaded);
+		itemview_update ();
+	}
+	g_array_free (shown, TRUE);
+
+	return db_items_remove_many ((gulong *)ids->data, ids->len);
+}
+
+static void
+itemlist_remove_item_from_vfolders (itemPtr item)
+{
+	vfolder_foreach_data (vfolder_remove_item, item);
 }
 
 void
 itemlist_remove_all_items (nodePtr node)
 {	
-	GList		*iter;
 	itemSetPtr	itemset;
 	
 	if (node == itemlist->priv->currentNode)
 		itemview_clear ();
 
 	itemset = db_itemset_load (node->id);
-	iter = itemset->ids;
-	while (iter) {
-		itemPtr item = item_load ((gulong)iter->data);
-		vfolder_foreach_data (vfolder_remove_item, item);
-		item_unload (item);
-		iter = g_list_next (iter);
-	}
+	itemset_foreach (itemset, itemlist_remove_item_from_vfolders);
 	itemset_free (itemset);
 		
 	db_itemset_remove_all (node->id);
@@ -159,15 +159,18 @@ void itemlist_request_remove_item(itemPtr item);
 void itemlist_remove_item(itemPtr item);
 
 /**
- * To be called whenever some of the items of an item set
- * are to be removed. In difference to itemlist_remove_item()
- * this function will remove all items first and update the
- * GUI once.
+ * Removes the given items from the DB, the search folders
+ * and the GUI. In difference to itemlist_remove_item()
+ * only the displayed items are loaded and all items are
+ * removed from the DB with a few statements. The selected
+ * item is skipped and dropped from the array. Node
+ * counters are not updated.
  *
- * @param itemSet	the item set from which items are to be removed
- * @param items		the items to be removed
+ * @param ids		array of item ids to be removed
+ *
+ * @returns number of removed item rows (including comments)
  */
-void itemlist_remove_items(itemSetPtr itemSet, GList *items);
+guint itemlist_remove_item_ids (GArray *ids);
 
 /**
  * To be called whenever the user wants to remove 
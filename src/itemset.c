@@ -30,22 +30,32 @@
 #include "itemset.h"
 #include "metadata.h"
 #include "node.h"
+#include "retention.h"
 #include "rule.h"
 #include "vfolder.h"
 #include "fl_sources/node_source.h"
 
+/* number of items loaded at once when iterating an item set */
+#define ITEMSET_LOAD_BATCH_SIZE	100
+
 void
 itemset_foreach (itemSetPtr itemSet, itemActionFunc callback)
 {
 	GList	*iter = itemSet->ids;
+	GSList	*items, *item;
+	gulong	ids[ITEMSET_LOAD_BATCH_SIZE];
+	guint	count;
 	
-	while(iter) {
-		itemPtr item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item) {
-			(*callback) (item);
-			item_unload (item);
+	while (iter) {
+		for (count = 0; iter && (count < ITEMSET_LOAD_BATCH_SIZE); iter = g_list_next (iter))
+			ids[count++] = GPOINTER_TO_UINT (iter->data);
+
+		items = db_items_load_many (ids, count);
+		for (item = items; item; item = g_slist_next (item)) {
+			(*callback) ((itemPtr)item->data);
+			item_unload ((itemPtr)item->data);
 		}
-		iter = g_list_next (iter);
+		g_slist_free (items);
 	}
 }
 
@@ -61,12 +71,66 @@ itemset_get_max_item_count (itemSetPtr itemSet)
 	return G_MAXUINT;
 }
 
+void
+itemset_merge_info_free (itemMergeInfoPtr info)
+{
+	g_free (info->sourceId);
+	g_free (info->contentHash);
+	g_free (info);
+}
+
+/** index of the existing items of an item set used during merging */
+typedef struct itemMergeIndex {
+	GList		*infos;		/**< list of all itemMergeInfoPtr */
+	GHashTable	*bySourceId;	/**< sourceId -> itemMergeInfoPtr */
+	GHashTable	*byContent;	/**< content hash of items without sourceId -> itemMergeInfoPtr */
+} *itemMergeIndexPtr;
+
+static void
+itemset_merge_index_add (itemMergeIndexPtr index, itemMergeInfoPtr info)
+{
+	index->infos = g_list_prepend (index->infos, info);
+	if (info->sourceId)
+		g_hash_table_insert (index->bySourceId, info->sourceId, info);
+	else
+		g_hash_table_insert (index->byContent, info->contentHash, info);
+}
+
+static itemMergeIndexPtr
+itemset_merge_index_new (const gchar *nodeId)
+{
+	itemMergeIndexPtr	index;
+	GList			*iter, *infos;
+
+	index = g_new0 (struct itemMergeIndex, 1);
+	index->bySourceId = g_hash_table_new (g_str_hash, g_str_equal);
+	index->byContent = g_hash_table_new (g_str_hash, g_str_equal);
+
+	iter = infos = db_itemset_load_merge_info (nodeId);
+	while (iter) {
+		itemset_merge_index_add (index, (itemMergeInfoPtr)iter->data);
+		iter = g_list_next (iter);
+	}
+	g_list_free (infos);
+
+	return index;
+}
+
+static void
+itemset_merge_index_free (itemMergeIndexPtr index)
+{
+	g_hash_table_destroy (index->bySourceId);
+	g_hash_table_destroy (index->byContent);
+	g_list_foreach (index->infos, (GFunc)itemset_merge_info_free, NULL);
+	g_list_free (index->infos);
+	g_free (index);
+}
+
 /**
  * Generic merge logic suitable for feeds
  *
- * @param items		existing items
+ * @param index		index of the existing items
  * @param newItem	new item to merge
- * @param maxChecks     maximum number of item checks
  * @param allowUpdates	TRUE if item content update is to be
  *      		allowed for existing items
  * @param allowStateChanges	TRUE if item state shall be
@@ -75,72 +139,31 @@ itemset_get_max_item_count (itemSetPtr itemSet)
  * @returns TRUE if merging instead of updating is necessary) 
  */
 static gboolean
-itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboolean allowUpdates, gboolean allowStateChanges)
+itemset_generic_merge_check (itemMergeIndexPtr index, itemPtr newItem, gboolean allowUpdates, gboolean allowStateChanges)
 {
-	GList		*oldItemIdIter = items;
-	itemPtr		oldItem = NULL;
-	gboolean	found, equal = FALSE;
+	itemMergeInfoPtr	oldInfo = NULL;
+	gchar			*newHash;
+	gboolean		found, equal = FALSE;
 
 	/* determine if we should add it... */
 	debug3 (DEBUG_CACHE, "check new item for merging: \"%s\", %i, %i", item_get_title (newItem), allowUpdates, allowStateChanges);
-		
-	/* compare to every existing item in this feed */
-	found = FALSE;
-	while (oldItemIdIter) {
-		oldItem = (itemPtr)(oldItemIdIter->data);
-		
-		/* try to compare the two items */
 
-		/* trivial case: one item has id the other doesn't -> they can't be equal */
-		if (((item_get_id (oldItem) == NULL) && (item_get_id (newItem) != NULL)) ||
-		    ((item_get_id (oldItem) != NULL) && (item_get_id (newItem) == NULL))) {	
-			/* cannot be equal (different ids) so compare to 
-			   next old item */
-			oldItemIdIter = g_list_next (oldItemIdIter);
-		   	continue;
-		} 
+	newHash = item_get_content_hash (item_get_title (newItem), item_get_description (newItem));
 
+	if (item_get_id (newItem)) {
+		/* best case: items with ids are matched by id only, content
+		   is compared to detect updates (eg, read status may have changed) */
+		oldInfo = g_hash_table_lookup (index->bySourceId, item_get_id (newItem));
+		if (oldInfo)
+			equal = g_str_equal (oldInfo->contentHash, newHash) &&
+			        (oldInfo->readStatus == newItem->readStatus) &&
+			        (oldInfo->flagStatus == newItem->flagStatus);
+	} else {
 		/* just for the case there are no ids: compare titles and HTML descriptions */
-		equal = TRUE;
-
-		if (((item_get_title (oldItem) != NULL) && (item_get_title (newItem) != NULL)) && 
-		     (0 != strcmp (item_get_title (oldItem), item_get_title (newItem))))		
-	    		equal = FALSE;
-
-		if (((item_get_description (oldItem) != NULL) && (item_get_description (newItem) != NULL)) && 
-		     (0 != strcmp (item_get_description(oldItem), item_get_description (newItem))))
-	    		equal = FALSE;
-
-		/* best case: they both have ids (position important: id check is useless without knowing if the items are different!) */
-		if (item_get_id (oldItem)) {			
-			if (0 == strcmp (item_get_id (oldItem), item_get_id (newItem))) {
-				found = TRUE;
-
-				/* found corresponding item, check if they are REALLY equal (eg, read status may have changed) */
-				if(oldItem->readStatus != newItem->readStatus) 
-					equal = FALSE;
-				if(oldItem->flagStatus != newItem->flagStatus)
-					equal = FALSE;
-				break;
-			} else {
-				/* different ids, but the content might be still equal (e.g. empty)
-				   so we need to explicitly unset the equal flag !!!  */
-				equal = FALSE;
-			}
-		}
-			
-		if (equal) {
-			found = TRUE;
-			break;
-		}
-		
-/*		if (i++ > maxChecks) {
-			found = FALSE;
-			break;
-		}*/
-
-		oldItemIdIter = g_list_next (oldItemIdIter);
+		oldInfo = g_hash_table_lookup (index->byContent, newHash);
+		equal = (NULL != oldInfo);
 	}
+	found = (NULL != oldInfo);
 		
 	if (!found) {
 		debug0 (DEBUG_CACHE, "-> item is to be added");
@@ -148,31 +171,45 @@ itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboo
 		/* if the item was found but has other contents -> update contents */
 		if (!equal) {
 			if (allowUpdates) {
-				/* no item_set_new_status() - we don't treat changed items as new items! */
-				item_set_title (oldItem, item_get_title (newItem));
+				/* Only now the full item needs to be loaded */
+				itemPtr oldItem = item_load (oldInfo->id);
+				if (oldItem) {
+					/* no item_set_new_status() - we don't treat changed items as new items! */
+					item_set_title (oldItem, item_get_title (newItem));
 				
-				/* don't use item_set_description as it does some unwanted length handling 
-				   and we want to enforce the new description */
-				g_free (oldItem->description);
-				oldItem->description = newItem->description;
-				newItem->description = NULL;
+					/* don't use item_set_description as it does some unwanted length handling 
+					   and we want to enforce the new description */
+					g_free (oldItem->description);
+					oldItem->description = newItem->description;
+					newItem->description = NULL;
 				
-				oldItem->time = newItem->time;
-				oldItem->updateStatus = TRUE;
-				// FIXME: this does not remove metadata from DB
-				metadata_list_free (oldItem->metadata);
-				oldItem->metadata = newItem->metadata;
-				newItem->metadata = NULL;
-
-				/* Only update item state for feed sources where it is necessary
-				   which means online accounts we sync against, but not normal
-				   online feeds where items have no read status. */
-				if (allowStateChanges) {
-					oldItem->readStatus = newItem->readStatus;
-					oldItem->flagStatus = newItem->flagStatus;
-				}
+					oldItem->time = newItem->time;
+					oldItem->updateStatus = TRUE;
+					metadata_list_free (oldItem->metadata);
+					oldItem->metadata = newItem->metadata;
+					newItem->metadata = NULL;
+
+					/* Only update item state for feed sources where it is necessary
+					   which means online accounts we sync against, but not normal
+					   online feeds where items have no read status. */
+					if (allowStateChanges) {
+						oldItem->readStatus = newItem->readStatus;
+						oldItem->flagStatus = newItem->flagStatus;
+						vfolder_item_changed (oldItem, RULE_FIELD_READ | RULE_FIELD_FLAG);
+					}
 				
-				db_item_update (oldItem);
+					db_item_update (oldItem);
+
+					/* keep the index in sync with the DB */
+					g_free (oldInfo->contentHash);
+					oldInfo->contentHash = newHash;
+					newHash = NULL;
+					oldInfo->readStatus = oldItem->readStatus;
+					oldInfo->flagStatus = oldItem->flagStatus;
+					oldInfo->time = oldItem->time;
+
+					item_unload (oldItem);
+				}
 				debug0 (DEBUG_CACHE, "-> item already existing and was updated");
 			} else {
 				debug0 (DEBUG_CACHE, "-> item updates not merged because of parser errors");
@@ -182,11 +219,13 @@ itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboo
 		}
 	}
 
+	g_free (newHash);
+
 	return !found;
 }
 
 static gboolean
-itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChecks, gboolean allowUpdates)
+itemset_merge_item (itemSetPtr itemSet, itemMergeIndexPtr index, itemPtr item, gboolean allowUpdates)
 {
 	gboolean	allowStateChanges = FALSE;
 	gboolean	merge;
@@ -200,10 +239,12 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 		allowStateChanges = NODE_SOURCE_TYPE (node)->capabilities & NODE_SOURCE_CAPABILITY_ITEM_STATE_SYNC;
 	
 	/* first try to merge with existing item */
-	merge = itemset_generic_merge_check (items, item, maxChecks, allowUpdates, allowStateChanges);
+	merge = itemset_generic_merge_check (index, item, allowUpdates, allowStateChanges);
 
 	/* if it is a new item add it to the item set */	
 	if (merge) {
+		itemMergeInfoPtr	info;
+
 		g_assert (!item->nodeId);
 		g_assert (!item->id);
 		item->nodeId = g_strdup (itemSet->nodeId);
@@ -213,8 +254,17 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 		/* step 1: write item to DB */
 		db_item_update (item);
 		
-		/* step 2: add to itemset */
+		/* step 2: add to itemset and merge index */
 		itemSet->ids = g_list_prepend (itemSet->ids, GUINT_TO_POINTER (item->id));
+
+		info = g_new0 (struct itemMergeInfo, 1);
+		info->id = item->id;
+		info->sourceId = g_strdup (item_get_id (item));
+		info->contentHash = item_get_content_hash (item_get_title (item), item_get_description (item));
+		info->readStatus = item->readStatus;
+		info->flagStatus = item->flagStatus;
+		info->time = item->time;
+		itemset_merge_index_add (index, info);
 				
 		debug3 (DEBUG_UPDATE, "-> added \"%s\" (id=%d) to item set %p...", item_get_title (item), item->id, itemSet);
 		
@@ -238,7 +288,8 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 
 		/* step 4: Check item for new enclosures to download */
 		if (node && (((feedPtr)node->data)->encAutoDownload)) {
-			GSList *iter = metadata_list_get_values (item->metadata, "enclosure");
+			GSList *values = metadata_list_get_values (item->metadata, "enclosure");
+			GSList *iter = values;
 			while (iter) {
 				enclosurePtr enc = enclosure_from_string (iter->data);
 				debug1 (DEBUG_UPDATE, "download enclosure (%s)", (gchar *)iter->data);
@@ -246,6 +297,7 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 				iter = g_slist_next (iter);
 				enclosure_free (enc);
 			}
+			g_slist_free (values);
 		}
 	} else {
 		debug2 (DEBUG_UPDATE, "-> not adding \"%s\" to node id \"%s\"...", item_get_title (item), itemSet->nodeId);
@@ -255,41 +307,12 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 	return merge;
 }
 
-static gint
-itemset_sort_by_date (gconstpointer a, gconstpointer b)
-{
-	itemPtr item1 = (itemPtr)a;
-	itemPtr item2 = (itemPtr)b;
-	
-	g_assert(item1 && item2);
-	
-	/* We have a problem here if all items of the feed
-	   do have no date, then this comparison is useless.
-	   To avoid such a case we alternatively compare by
-	   item id (which should be an ever-increasing number)
-	   and thereby indicate merge order as a secondary
-	   order criterion */
-	if (item1->time == item2->time) {
-		if (item1->id < item2->id)
-			return 1;
-		if (item1->id > item2->id) 
-			return -1;
-		return 0;
-	}
-		
-	if (item1->time < item2->time)
-		return 1;
-	if (item1->time > item2->time)
-		return -1;
-	
-	return 0;
-}
-
 guint
 itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gboolean markAsRead)
 {
-	GList	*iter, *droppedItems = NULL, *items = NULL;
-	guint	max, length, toBeDropped, newCount = 0, flagCount = 0;
+	GList			*iter;
+	itemMergeIndexPtr	index;
+	guint			max, length, newCount = 0, flagCount = 0;
 
 	debug_start_measurement (DEBUG_UPDATE);
 	
@@ -304,15 +327,17 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 	length = g_list_length (list);
 	max = itemset_get_max_item_count (itemSet);
 
-	/* Preload all items for flag counting and later merging comparison */
-	iter = itemSet->ids;
+	/* All DB writes of the merge are done in a single transaction */
+	db_begin_batch ();
+
+	/* Index the merge relevant state of all existing items for 
+	   flag counting and later merging comparison. Full items are
+	   only loaded when they need to be updated. */
+	index = itemset_merge_index_new (itemSet->nodeId);
+	iter = index->infos;
 	while (iter) {
-		itemPtr item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item) {
-			items = g_list_append (items, item);
-			if (item->flagStatus)
-				flagCount++;
-		}
+		if (((itemMergeInfoPtr)iter->data)->flagStatus)
+			flagCount++;
 		iter = g_list_next (iter);
 	}
 	debug1(DEBUG_UPDATE, "current cache size: %d", g_list_length(itemSet->ids));
@@ -366,7 +391,7 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 	   Adding them in this order would mean to reverse 
 	   their order in the merged list, so merging needs
 	   to be done bottom to top. During this step the
-	   item list (items) may exceed the cache limit. */
+	   merge index may exceed the cache limit. */
 	iter = g_list_last (list);
 	while (iter) {
 		itemPtr item = (itemPtr)iter->data;
@@ -374,10 +399,10 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 		if (markAsRead)
 			item->readStatus = TRUE;
 			
-		if (itemset_merge_item (itemSet, items, item, length, allowUpdates)) {
+		if (itemset_merge_item (itemSet, index, item, allowUpdates)) {
 			vfolder_foreach_data (vfolder_merge_item, item);
 			newCount++;
-			items = g_list_prepend (items, iter->data);
+			item_unload (item);
 		}
 		iter = g_list_previous (iter);
 	}
@@ -387,49 +412,15 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 	
 	debug1(DEBUG_UPDATE, "added %d new items", newCount);
 	
-	/* 4. Apply cache limit for effective item set size
-	      and unload older items as necessary. In this step
-	      it is important never to drop flagged items and 
-	      to drop the oldest items only. */
-	
-	if (g_list_length (items) > max)
-		toBeDropped = g_list_length (items) - max;
-	else
-		toBeDropped = 0;
-
-	/* Let's never drop more than 50 items at one time to avoid
-	   long duration migrations. It is ok to drop only some of the
-	   items here, because we can drop the rest during future
-	   feed updates. */
-	//if(toBeDropped > 50)
-	//	toBeDropped = 50;
+	/* 4. Apply cache limit for effective item set size. This
+	      is done by the retention engine in the background
+	      which never drops flagged items and drops the
+	      oldest items first. */
+	retention_request_node (itemSet->nodeId, max);
 	
-	debug3 (DEBUG_UPDATE, "%u new items, cache limit is %u -> dropping %u items", newCount, max, toBeDropped);
-	items = g_list_sort (items, itemset_sort_by_date);
-	iter = g_list_last (items);
-	while (iter) {
-		itemPtr item = (itemPtr) iter->data;
-		if (toBeDropped > 0 && !item->flagStatus) {
-			debug2 (DEBUG_UPDATE, "dropping item nr %u (%s)....", item->id, item_get_title (item));
-			droppedItems = g_list_append (droppedItems, item);
-			/* no unloading here, it's done in itemlist_remove_items() */
-			toBeDropped--;
-		} else {
-			item_unload (item);
-		}
-		iter = g_list_previous (iter);
-	}
-	
-	if (droppedItems) {
-		itemlist_remove_items (itemSet, droppedItems);
-		g_list_free (droppedItems);
-	}
-	
-	/* 5. Sanity check to detect merging bugs */
-	if (g_list_length (items) > itemset_get_max_item_count (itemSet) + flagCount)
-		debug0 (DEBUG_CACHE, "Fatal: Item merging bug! Resulting item list is too long! Cache limit does not work. This is a severe program bug!");
-	
-	g_list_free (items);
+	itemset_merge_index_free (index);
+
+	db_end_batch ();
 	
 	debug_end_measurement (DEBUG_UPDATE, "merge itemset");
 	
@@ -439,23 +430,75 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 gboolean
 itemset_check_item (itemSetPtr itemSet, itemPtr item)
 {
-	gboolean	result = TRUE;
 	GSList		*iter = itemSet->rules;
 
+	if (!iter)
+		return TRUE;
+
 	while (iter) {
 		rulePtr		rule = (rulePtr) iter->data;
 		ruleCheckFunc	func = rule->ruleInfo->checkFunc;
 		gboolean	ruleResult = FALSE;
 		
 		ruleResult = (*func) (rule, item);
-		result &= (rule->additive)?ruleResult:!ruleResult;
-		if (itemSet->anyMatch && result)
+		if (!rule->additive)
+			ruleResult = !ruleResult;
+
+		/* "any" is decided by the first match, "all" by the first mismatch */
+		if (itemSet->anyMatch && ruleResult)
 			return TRUE;
+		if (!itemSet->anyMatch && !ruleResult)
+			return FALSE;
+
+		iter = g_slist_next (iter);
+	}
+
+	return !itemSet->anyMatch;
+}
+
+guint
+itemset_get_rule_fields (itemSetPtr itemSet)
+{
+	GSList	*iter = itemSet->rules;
+	guint	fields = 0;
+
+	while (iter) {
+		fields |= ((rulePtr)iter->data)->ruleInfo->fields;
+		iter = g_slist_next (iter);
+	}
+
+	return fields;
+}
+
+gchar *
+itemset_to_sql (itemSetPtr itemSet)
+{
+	GString		*sql;
+	GSList		*iter = itemSet->rules;
+
+	if (!iter)
+		return g_strdup ("1");
+
+	sql = g_string_new (NULL);
+	while (iter) {
+		rulePtr	rule = (rulePtr) iter->data;
+		gchar	*condition = rule_to_sql (rule);
+
+		if (!condition) {
+			debug1 (DEBUG_CACHE, "rule \"%s\" cannot be compiled to SQL", rule->ruleInfo->ruleId);
+			g_string_free (sql, TRUE);
+			return NULL;
+		}
+
+		if (sql->len)
+			g_string_append (sql, itemSet->anyMatch?" OR ":" AND ");
+		g_string_append_printf (sql, rule->additive?"(%s)":"NOT (%s)", condition);
+		g_free (condition);
 
 		iter = g_slist_next (iter);
 	}
 
-	return result;
+	return g_string_free (sql, FALSE);
 }
 
 gboolean
@@ -41,6 +41,23 @@ typedef struct itemSet {
 	gchar		*nodeId;	/**< the feed list node id this item set belongs to */
 } *itemSetPtr;
 
+/** lightweight item state needed for merging (see db_itemset_load_merge_info()) */
+typedef struct itemMergeInfo {
+	gulong		id;		/**< item id */
+	gchar		*sourceId;	/**< syndication item id (or NULL) */
+	gchar		*contentHash;	/**< hash of title and description (see item_get_content_hash()) */
+	gboolean	readStatus;	/**< TRUE if the item has been read */
+	gboolean	flagStatus;	/**< TRUE if the item has been flagged */
+	time_t		time;		/**< item date */
+} *itemMergeInfoPtr;
+
+/**
+ * Frees the given merge info.
+ *
+ * @param info		the merge info
+ */
+void itemset_merge_info_free (itemMergeInfoPtr info);
+
 /* item set iterating interface */
 
 typedef void 	(*itemActionFunc)	(itemPtr item);
@@ -76,6 +93,28 @@ guint itemset_merge_items(itemSetPtr itemSet, GList *items, gboolean allowUpdate
  */
 gboolean itemset_check_item (itemSetPtr itemSet, itemPtr item);
 
+/**
+ * Returns the item fields the rules of the given item set depend on.
+ *
+ * @param itemSet	the itemSet
+ *
+ * @returns a combination of ruleFields
+ */
+guint itemset_get_rule_fields (itemSetPtr itemSet);
+
+/**
+ * Compiles the rules of the given item set into a single SQL
+ * condition on the "items" table (see db_itemset_query()).
+ * The resulting items are to be checked with itemset_check_item()
+ * like any other items before adding them to a search folder.
+ *
+ * @param itemSet	the itemSet
+ *
+ * @returns a newly allocated SQL condition or NULL if
+ * not all rules of the item set can be expressed in SQL
+ */
+gchar * itemset_to_sql (itemSetPtr itemSet);
+
 /**
  * Checks wether the given item id is in the given item set.
  *
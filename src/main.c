@@ -45,6 +45,7 @@
 #include "social.h"
 #include "update.h"
 #include "xml.h"
+#include "xslt_cache.h"
 #include "ui/liferea_shell.h"
 #include "ui/session.h"
 #include "notification/notification.h"
@@ -352,6 +353,7 @@ on_shutdown (gpointer user_data)
 
 	/* order is important ! */
 	update_deinit ();
+	xslt_cache_free ();
 	db_deinit ();
 	social_free ();
 
@@ -30,20 +30,35 @@
 /* Metadata in Liferea are ordered lists of key/value list pairs. Both 
    feed list nodes and items can have a list of metadata assigned. Metadata
    date values are always text values but maybe of different type depending
-   on their usage type. */
+   on their usage type. 
+   
+   A metadata list is an array of key/value entries grouped by key in
+   the order the keys were first added. Keys are interned strings shared
+   by all lists and compared by pointer. The values are stored in a
+   string arena owned by the list, so a list is free'd at once. */
 
 static GHashTable *metadataTypes = NULL;	/**< hash table with all registered meta data types */
 
-struct pair {
-	gchar		*strid;		/** metadata type id */
-	GSList		*data;		/** list of metadata values */
+#define METADATA_ARENA_SIZE	256	/**< initial arena block size in bytes */
+
+typedef struct metadataEntry {
+	const gchar	*strid;		/**< interned metadata type id */
+	const gchar	*data;		/**< metadata value (stored in the arena) */
+} metadataEntry;
+
+struct metadataList {
+	metadataEntry	*entries;	/**< entries grouped by type id */
+	guint		count;		/**< number of entries */
+	guint		size;		/**< number of allocated entries */
+	GStringChunk	*arena;		/**< storage of the values */
 };
 
 /* register metadata types to check validity on adding */
-static void
+void
 metadata_init (void)
 {
-	g_assert (NULL == metadataTypes);
+	if (metadataTypes)
+		return;
 	
 	metadataTypes = g_hash_table_new (g_str_hash, g_str_equal);
 	
@@ -147,12 +162,68 @@ metadata_get_type (const gchar *name)
 	return type;
 }
 
-GSList *
-metadata_list_append (GSList *metadata, const gchar *strid, const gchar *data)
+/* Returns the interned type id or NULL if no list can contain it */
+static const gchar *
+metadata_lookup_strid (const gchar *strid)
+{
+	GQuark	quark = g_quark_try_string (strid);
+
+	return quark?g_quark_to_string (quark):NULL;
+}
+
+/* Adds a value after the last value of the same type */
+static metadataListPtr
+metadata_list_insert (metadataListPtr metadata, const gchar *strid, const gchar *data, gssize length)
+{
+	const gchar	*key = g_intern_string (strid);
+	guint		pos;
+
+	if (!metadata) {
+		metadata = g_new0 (struct metadataList, 1);
+		metadata->arena = g_string_chunk_new (METADATA_ARENA_SIZE);
+	}
+
+	for (pos = metadata->count; pos > 0; pos--) {
+		if (metadata->entries[pos - 1].strid == key)
+			break;
+	}
+	if (0 == pos)
+		pos = metadata->count;
+
+	if (metadata->count == metadata->size) {
+		metadata->size = metadata->size?2 * metadata->size:4;
+		metadata->entries = g_renew (metadataEntry, metadata->entries, metadata->size);
+	}
+
+	memmove (&metadata->entries[pos + 1], &metadata->entries[pos], (metadata->count - pos) * sizeof (metadataEntry));
+	metadata->entries[pos].strid = key;
+	metadata->entries[pos].data = g_string_chunk_insert_len (metadata->arena, data, length);
+	metadata->count++;
+
+	return metadata;
+}
+
+static metadataEntry *
+metadata_list_find (metadataListPtr metadata, const gchar *strid)
 {
-	GSList		*iter = metadata;
-	gchar		*tmp, *checked_data = NULL;
-	struct pair 	*p;
+	const gchar	*key;
+	guint		i;
+
+	if (!metadata || !(key = metadata_lookup_strid (strid)))
+		return NULL;
+
+	for (i = 0; i < metadata->count; i++) {
+		if (metadata->entries[i].strid == key)
+			return &metadata->entries[i];
+	}
+
+	return NULL;
+}
+
+metadataListPtr
+metadata_list_append (metadataListPtr metadata, const gchar *strid, const gchar *data)
+{
+	gchar		*checked_data = NULL;
 	
 	if (!data)
 		return metadata;
@@ -161,7 +232,7 @@ metadata_list_append (GSList *metadata, const gchar *strid, const gchar *data)
 	switch (metadata_get_type (strid)) {
 		case METADATA_TYPE_TEXT:
 			/* No check because renderer will process further */
-			checked_data = g_strdup (data);
+			return metadata_list_insert (metadata, strid, data, -1);
 			break;
 		case METADATA_TYPE_URL:
 			/* Simple sanity check to see if it doesn't break XML */
@@ -177,169 +248,138 @@ metadata_list_append (GSList *metadata, const gchar *strid, const gchar *data)
 		default:
 			g_warning ("Unknown metadata type: %s (id=%d), please report this Liferea bug! Treating as HTML.", strid, metadata_get_type (strid));
 		case METADATA_TYPE_HTML:
-			/* Needs to check for proper XHTML */
-			if (xhtml_is_well_formed (data)) {
-				tmp = g_strdup (data);
-			} else {
-				debug1 (DEBUG_PARSING, "not well formed HTML: %s", data);
-				tmp = g_markup_escape_text (data, -1);
-				debug1 (DEBUG_PARSING, "escaped as: %s", tmp);
-			}
-			/* And needs to remove DHTML */
-			checked_data = xhtml_strip_dhtml (tmp);
-			g_free (tmp);
+			/* Needs to be proper XHTML without DHTML */
+			checked_data = xhtml_sanitize (data, XHTML_SANITIZE_ESCAPE_INVALID);
 			break;
 	}
 	
-	while (iter) {
-		p = (struct pair*)iter->data; 
-		if (g_str_equal (p->strid, strid)) {
-			p->data = g_slist_append (p->data, checked_data);
-			return metadata;
-		}
-		iter = iter->next;
-	}
-	p = g_new (struct pair, 1);
-	p->strid = g_strdup (strid);
-	p->data = g_slist_append (NULL, checked_data);
-	metadata = g_slist_append (metadata, p);
+	metadata = metadata_list_insert (metadata, strid, checked_data, -1);
+	g_free (checked_data);
+
 	return metadata;
 }
 
+metadataListPtr
+metadata_list_append_checked (metadataListPtr metadata, const gchar *strid, const gchar *data, gssize length)
+{
+	if (!data)
+		return metadata;
+
+	return metadata_list_insert (metadata, strid, data, length);
+}
+
 void
-metadata_list_set (GSList **metadata, const gchar *strid, const gchar *data)
+metadata_list_set (metadataListPtr *metadata, const gchar *strid, const gchar *data)
 {
-	GSList	*iter = *metadata;
-	struct pair *p;
-	
-	while (iter) {
-		p = (struct pair*)iter->data; 
-		if (g_str_equal (p->strid, strid)) {
-			if (p->data) {
-				/* exchange old value */
-				g_free (((GSList *)p->data)->data);
-				((GSList *)p->data)->data = g_strdup (data);
-			} else {
-				p->data = g_slist_append (p->data, g_strdup (data));
-			}
-			return;
-		}
-		iter = iter->next;
+	metadataEntry	*entry;
+
+	entry = metadata_list_find (*metadata, strid);
+	if (entry && !data) {
+		/* unset the value */
+		(*metadata)->count--;
+		memmove (entry, entry + 1, ((*metadata)->entries + (*metadata)->count - entry) * sizeof (metadataEntry));
+		return;
+	}
+
+	if (!data)
+		return;
+
+	if (entry) {
+		/* exchange old value, the old one stays in the arena */
+		if (!g_str_equal (entry->data, data))
+			entry->data = g_string_chunk_insert ((*metadata)->arena, data);
+		return;
 	}
-	p = g_new (struct pair, 1);
-	p->strid = g_strdup (strid);
-	p->data = g_slist_append (NULL, g_strdup (data));
-	*metadata = g_slist_append (*metadata, p);
+
+	*metadata = metadata_list_insert (*metadata, strid, data, -1);
 }
 
 void
-metadata_list_foreach (GSList *metadata, metadataForeachFunc func, gpointer user_data)
+metadata_list_foreach (metadataListPtr metadata, metadataForeachFunc func, gpointer user_data)
 {
-	GSList	*list = metadata;
-	guint	index = 0;
+	guint	i;
 	
-	while (list) {
-		struct pair *p = (struct pair*)list->data; 
-		GSList *values = (GSList *)p->data;
-		while (values) {
-			index++;
-			(*func)(p->strid, values->data, index, user_data);
-			values = g_slist_next (values);
-		}
-		list = list->next;
-	}
+	if (!metadata)
+		return;
+
+	for (i = 0; i < metadata->count; i++)
+		(*func)(metadata->entries[i].strid, metadata->entries[i].data, i + 1, user_data);
 }
 
 GSList *
-metadata_list_get_values (GSList *metadata, const gchar *strid)
+metadata_list_get_values (metadataListPtr metadata, const gchar *strid)
 {
-	GSList *list = metadata;
+	GSList		*values = NULL;
+	metadataEntry	*entry, *end;
+	const gchar	*key;
 	
-	while (list) {
-		struct pair *p = (struct pair*)list->data; 
-		if (g_str_equal (p->strid, strid))
-			return p->data;
-		list = list->next;
-	}
-	return NULL;
+	entry = metadata_list_find (metadata, strid);
+	if (!entry)
+		return NULL;
+
+	/* values of a type are always adjacent */
+	key = entry->strid;
+	end = metadata->entries + metadata->count;
+	for (; entry < end && entry->strid == key; entry++)
+		values = g_slist_prepend (values, (gpointer)entry->data);
+
+	return g_slist_reverse (values);
 }
 
 const gchar *
-metadata_list_get (GSList *metadata, const gchar *strid)
+metadata_list_get (metadataListPtr metadata, const gchar *strid)
 {
-	GSList	*values;
+	metadataEntry	*entry;
 	
-	values = metadata_list_get_values (metadata, strid);
-	return values?values->data:NULL;
-
+	entry = metadata_list_find (metadata, strid);
+	return entry?entry->data:NULL;
 }
 
-GSList *
-metadata_list_copy (GSList *list)
+metadataListPtr
+metadata_list_copy (metadataListPtr metadata)
 {
-	GSList		*copy = NULL;
-	GSList		*iter2, *iter = list;
-	struct pair	*p;
+	metadataListPtr	copy = NULL;
+	guint		i;
 	
-	while (iter) {
-		p = (struct pair*)iter->data;
-		iter2 = p->data;
-		while (iter2) {
-			copy = metadata_list_append (copy, p->strid, iter2->data);
-			iter2 = iter2->next;
-		}
-		iter = iter->next;
-	}
+	if (!metadata)
+		return NULL;
+
+	/* the values were checked when added to the original */
+	for (i = 0; i < metadata->count; i++)
+		copy = metadata_list_insert (copy, metadata->entries[i].strid, metadata->entries[i].data, -1);
 	
 	return copy;
 }
 
 void
-metadata_list_free (GSList *metadata)
+metadata_list_free (metadataListPtr metadata)
 {
-	GSList		*list2, *iter2, *iter = metadata;
-	struct pair	*p;
-	
-	while (iter) {
-		p = (struct pair*)iter->data;
-		list2 = p->data;
-		iter2 = list2;
-		while (iter2) {
-			g_free (iter2->data);
-			iter2 = iter2->next;
-		}
-		g_slist_free (list2);
-		g_free (p->strid);
-		g_free (p);
-		iter = iter->next;
-	}
-	g_slist_free (metadata);
+	if (!metadata)
+		return;
+
+	g_string_chunk_free (metadata->arena);
+	g_free (metadata->entries);
+	g_free (metadata);
 }
 
 void
-metadata_add_xml_nodes (GSList *metadata, xmlNodePtr parentNode)
+metadata_add_xml_nodes (metadataListPtr metadata, xmlNodePtr parentNode)
 {
-	GSList *list = metadata;
-	xmlNodePtr attribute;
-	xmlNodePtr metadataNode = xmlNewChild (parentNode, NULL, "attributes", NULL);
+	xmlNodePtr	attribute;
+	xmlNodePtr	metadataNode = xmlNewChild (parentNode, NULL, "attributes", NULL);
+	guint		i;
 	
-	while (list) {
-		struct pair *p = (struct pair*)list->data; 
-		GSList *list2 = p->data;
-		while (list2) {
-			attribute = xmlNewTextChild (metadataNode, NULL, "attribute", list2->data);
-			xmlNewProp (attribute, "name", p->strid);
-			list2 = list2->next;
-		}
-		list = list->next;
+	for (i = 0; metadata && i < metadata->count; i++) {
+		attribute = xmlNewTextChild (metadataNode, NULL, "attribute", metadata->entries[i].data);
+		xmlNewProp (attribute, "name", metadata->entries[i].strid);
 	}
 }
 
-GSList *
+metadataListPtr
 metadata_parse_xml_nodes (xmlNodePtr cur)
 {
 	xmlNodePtr	attribute = cur->xmlChildrenNode;
-	GSList 		*metadata = NULL;
+	metadataListPtr	metadata = NULL;
 	
 	while (attribute) {
 		if (attribute->type == XML_ELEMENT_NODE &&
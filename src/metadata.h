@@ -53,6 +53,16 @@ enum {
 	METADATA_TYPE_HTML = 3	/**< metadata is XHTML content and valid to be embedded in XML */
 };
 
+/** ordered list of typed metadata values (NULL is an empty list) */
+typedef struct metadataList *metadataListPtr;
+
+/**
+ * Sets up the registry of the known metadata types. This is
+ * done on first use, but must be done in the main thread before
+ * metadata lists are built by parser worker threads.
+ */
+void metadata_init (void);
+
 /**
  * Register a metadata type. This allows type specific
  * sanity handling and detecting invalid metadata.
@@ -81,7 +91,21 @@ gboolean metadata_is_type_registered (const gchar *strid);
  *
  * @returns the changed meta data list
  */
-GSList * metadata_list_append(GSList *metadata, const gchar *strid, const gchar *data);
+metadataListPtr metadata_list_append (metadataListPtr metadata, const gchar *strid, const gchar *data);
+
+/**
+ * Appends a value that was already checked by metadata_list_append()
+ * before, e.g. when loading metadata from the cache. The value is
+ * copied into the list without any checks.
+ *
+ * @param metadata	the metadata list
+ * @param strid		the metadata type identifier
+ * @param data		data to add
+ * @param length	length of data or -1 if it is zero terminated
+ *
+ * @returns the changed meta data list
+ */
+metadataListPtr metadata_list_append_checked (metadataListPtr metadata, const gchar *strid, const gchar *data, gssize length);
 
 /** 
  * Sets (and overwrites if necessary) the value of a specific metadata type.
@@ -89,9 +113,9 @@ GSList * metadata_list_append(GSList *metadata, const gchar *strid, const gchar
  *
  * @param metadata	the metadata list
  * @param strid		the metadata type identifier
- * @param data		data to add
+ * @param data		data to add (NULL removes the value)
  */
-void metadata_list_set(GSList **metadata, const gchar *strid, const gchar *data);
+void metadata_list_set (metadataListPtr *metadata, const gchar *strid, const gchar *data);
 
 /**
  * Returns the first value of a given type from a specified metadata list.
@@ -102,7 +126,7 @@ void metadata_list_set(GSList **metadata, const gchar *strid, const gchar *data)
  *
  * @returns the first value (or NULL)
  */
-const gchar * metadata_list_get(GSList *metadata, const gchar *strid);
+const gchar * metadata_list_get (metadataListPtr metadata, const gchar *strid);
 
 /** 
  * Definition of metadata foreach function 
@@ -121,7 +145,7 @@ typedef void	(*metadataForeachFunc)	(const gchar *key, const gchar *value, guint
  * @param func		callback function
  * @param user_data	data to be passed to func
  */
-void metadata_list_foreach(GSList *metadata, metadataForeachFunc func, gpointer user_data);
+void metadata_list_foreach (metadataListPtr metadata, metadataForeachFunc func, gpointer user_data);
 
 /**
  * Returns a list of all values of a given type from a specified metadata list.
@@ -129,9 +153,10 @@ void metadata_list_foreach(GSList *metadata, metadataForeachFunc func, gpointer
  * @param metadata	the metadata list
  * @param strid		the metadata type identifier
  *
- * @returns a list of values (or NULL)
+ * @returns a list of values (or NULL) to be free'd using g_slist_free(),
+ *          the values are owned by the metadata list
  */
-GSList * metadata_list_get_values(GSList *metadata, const gchar *strid);
+GSList * metadata_list_get_values (metadataListPtr metadata, const gchar *strid);
 
 /** 
  * Creates a copy of a given metadata list.
@@ -140,14 +165,14 @@ GSList * metadata_list_get_values(GSList *metadata, const gchar *strid);
  *
  * @returns the new list
  */
-GSList * metadata_list_copy(GSList *list);
+metadataListPtr metadata_list_copy (metadataListPtr metadata);
 
 /**
  * Frees all memory allocated by the given metadata list.
  *
  * @param metadata	the metadata list
  */
-void metadata_list_free(GSList *metadata);
+void metadata_list_free (metadataListPtr metadata);
 
 /**
  * Adds the given metadata list to a given XML document node.
@@ -156,7 +181,7 @@ void metadata_list_free(GSList *metadata);
  * @param metadata	the metadata list
  * @param parentNode	the XML node
  */
-void metadata_add_xml_nodes(GSList *metadata, xmlNodePtr parentNode);
+void metadata_add_xml_nodes (metadataListPtr metadata, xmlNodePtr parentNode);
 
 /**
  * Parses the given XML node and returns a new metadata attribute 
@@ -166,6 +191,6 @@ void metadata_add_xml_nodes(GSList *metadata, xmlNodePtr parentNode);
  *
  * @returns list of values
  */
-GSList * metadata_parse_xml_nodes(xmlNodePtr cur);
+metadataListPtr metadata_parse_xml_nodes (xmlNodePtr cur);
 
 #endif
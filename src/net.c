@@ -40,6 +40,83 @@ static gchar	*proxyusername = NULL;
 static gchar	*proxypassword = NULL;
 static int	proxyport = 0;
 
+/** update job -> SoupMessage of all queued and running requests */
+static GHashTable	*messages = NULL;
+
+/* Returns the freshness lifetime of the response in seconds as
+   given by Cache-Control max-age or Expires (0 if there is none) */
+static glong
+network_get_max_age (SoupMessage *msg)
+{
+	GHashTable	*params;
+	SoupDate	*expires, *date;
+	const gchar	*tmp;
+	glong		maxAge = 0;
+
+	tmp = soup_message_headers_get_list (msg->response_headers, "Cache-Control");
+	if (tmp) {
+		params = soup_header_parse_param_list (tmp);
+		if (g_hash_table_lookup_extended (params, "no-cache", NULL, NULL) ||
+		    g_hash_table_lookup_extended (params, "no-store", NULL, NULL)) {
+			soup_header_free_param_list (params);
+			return 0;
+		}
+
+		tmp = g_hash_table_lookup (params, "max-age");
+		if (tmp)
+			maxAge = atol (tmp);
+		soup_header_free_param_list (params);
+		if (maxAge > 0)
+			return maxAge;
+	}
+
+	/* Expires is relative to the server clock, so use the
+	   Date header as the reference if there is one */
+	tmp = soup_message_headers_get_one (msg->response_headers, "Expires");
+	if (!tmp)
+		return 0;
+
+	expires = soup_date_new_from_string (tmp);
+	if (!expires)
+		return 0;
+
+	tmp = soup_message_headers_get_one (msg->response_headers, "Date");
+	date = tmp?soup_date_new_from_string (tmp):NULL;
+	maxAge = soup_date_to_time_t (expires) - (date?soup_date_to_time_t (date):time (NULL));
+	if (date)
+		soup_date_free (date);
+	soup_date_free (expires);
+
+	return MAX (maxAge, 0);
+}
+
+/* Returns the number of seconds the Retry-After header
+   asks to wait (0 if there is none) */
+static glong
+network_get_retry_after (SoupMessage *msg)
+{
+	SoupDate	*date;
+	const gchar	*tmp;
+	glong		delay;
+
+	tmp = soup_message_headers_get_one (msg->response_headers, "Retry-After");
+	if (!tmp)
+		return 0;
+
+	/* either delta seconds or a HTTP date */
+	if (g_ascii_isdigit (*tmp))
+		return atol (tmp);
+
+	date = soup_date_new_from_string (tmp);
+	if (!date)
+		return 0;
+
+	delay = soup_date_to_time_t (date) - time (NULL);
+	soup_date_free (date);
+
+	return MAX (delay, 0);
+}
+
 static void
 network_process_callback (SoupSession *session, SoupMessage *msg, gpointer user_data)
 {
@@ -47,6 +124,9 @@ network_process_callback (SoupSession *session, SoupMessage *msg, gpointer user_
 	SoupDate	*last_modified;
 	const gchar	*tmp = NULL;
 
+	if (messages)
+		g_hash_table_remove (messages, job);
+
 	job->result->source = soup_uri_to_string (soup_message_get_uri(msg), FALSE);
 	if (SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code)) {
 		job->result->returncode = msg->status_code;
@@ -77,9 +157,35 @@ network_process_callback (SoupSession *session, SoupMessage *msg, gpointer user_
 		}
 	}
 
+	/* Update ETag value */
+	tmp = soup_message_headers_get_one (msg->response_headers, "ETag");
+	if (tmp)
+		update_state_set_etag (job->result->updateState, tmp);
+
+	/* Remember how long the response stays fresh */
+	update_state_set_max_age (job->result->updateState, network_get_max_age (msg));
+
+	/* Rate limiting and overloaded hosts may say when to retry */
+	if (429 == msg->status_code || SOUP_STATUS_SERVICE_UNAVAILABLE == msg->status_code)
+		job->result->retryAfter = network_get_retry_after (msg);
+
 	update_process_finished_job (job);
 }
 
+static void
+network_got_chunk (SoupMessage *msg, SoupBuffer *chunk, gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)user_data;
+
+	/* Neither cancelled requests nor the bodies of redirects
+	   and error responses are of interest to the parser */
+	if (!job->callback || !SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+		return;
+
+	/* only queued here, the parse workers do the parsing */
+	update_job_push_chunk (job, chunk->data, chunk->length);
+}
+
 static SoupURI *
 network_get_proxy_uri (void)
 {
@@ -145,6 +251,12 @@ network_process_request (const updateJobPtr const job)
 		soup_date_free (date);
 	}
 
+	/* Set the If-None-Match: header */
+	if (job->request->updateState && job->request->updateState->etag)
+		soup_message_headers_append (msg->request_headers,
+					     "If-None-Match",
+					     job->request->updateState->etag);
+
 	/* Set the authentication */
 	if (!job->request->authValue &&
 	    job->request->options &&
@@ -181,9 +293,32 @@ network_process_request (const updateJobPtr const job)
 	    (network_get_proxy_host () == NULL))
 		soup_message_disable_feature (msg, SOUP_TYPE_PROXY_URI_RESOLVER);
 
+	/* Parse the document while it is being received */
+	if (job->request->stream)
+		g_signal_connect (msg, "got-chunk", G_CALLBACK (network_got_chunk), job);
+
+	if (messages)
+		g_hash_table_insert (messages, job, msg);
 	soup_session_queue_message (session, msg, network_process_callback, job);
 }
 
+void
+network_cancel_request (updateJobPtr job)
+{
+	SoupMessage	*msg;
+
+	if (!messages)
+		return;
+
+	msg = g_hash_table_lookup (messages, job);
+	if (!msg)
+		return;
+
+	/* Finishes the request with a transport error status */
+	debug1 (DEBUG_NET, "cancelling download of %s", job->request->source);
+	soup_session_cancel_message (session, msg, SOUP_STATUS_CANCELLED);
+}
+
 static void
 network_authenticate (
 	SoupSession *session,
@@ -236,6 +371,8 @@ network_init (void)
 		
 	g_signal_connect (session, "authenticate", G_CALLBACK (network_authenticate), NULL);
 
+	messages = g_hash_table_new (g_direct_hash, g_direct_equal);
+
 	/* Soup debugging */
 	if (debug_level & DEBUG_NET) {
 		logger = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1);
@@ -245,9 +382,19 @@ network_init (void)
 	g_free (useragent);
 }
 
+void
+network_set_max_conns_per_host (guint max)
+{
+	g_object_set (G_OBJECT (session), SOUP_SESSION_MAX_CONNS_PER_HOST, max, NULL);
+}
+
 void 
 network_deinit (void)
 {
+	if (messages)
+		g_hash_table_destroy (messages);
+	messages = NULL;
+
 	g_free (proxyname);
 	g_free (proxyusername);
 	g_free (proxypassword);
@@ -49,6 +49,14 @@ void network_deinit (void);
  */
 void network_set_proxy (gchar *host, guint port, gchar *user, gchar *password);
 
+/**
+ * Sets the maximum number of connections to a single host.
+ * The update processing limits its jobs per host the same way.
+ *
+ * @param max	the maximum number of connections per host
+ */
+void network_set_max_conns_per_host (guint max);
+
 /**
  * Returns the currently configured proxy host.
  *
@@ -84,6 +92,15 @@ const gchar * network_get_proxy_password (void);
  */
 void network_process_request (const updateJobPtr const job);
 
+/**
+ * Aborts the network request of the given update job if it is
+ * queued or running. The job is finished with a transport error
+ * status, which might happen before this function returns.
+ *
+ * @param job		the update job
+ */
+void network_cancel_request (updateJobPtr job);
+
 /**
  * Returns explanation string for the given network error code.
  *
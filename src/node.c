@@ -270,6 +270,22 @@ node_get_itemset (nodePtr node)
 	return NODE_TYPE (node)->load (node);
 }
 
+/* Resets the unread counters of a node and all its children
+   after their items were marked read. Search folders show
+   items of other feeds and maintain their own counters. */
+static void
+node_reset_unread_count (nodePtr node)
+{
+	if (IS_VFOLDER (node))
+		return;
+
+	node->unreadCount = 0;
+	node->needsUpdate = TRUE;
+		
+	if (node->children)
+		node_foreach_child (node, node_reset_unread_count);
+}
+
 void
 node_mark_all_read (nodePtr node)
 {
@@ -277,13 +293,9 @@ node_mark_all_read (nodePtr node)
 		return;
 
 	if (0 != node->unreadCount) {
-		itemset_mark_read (node);
-		node->unreadCount = 0;
-		node->needsUpdate = TRUE;
+		itemset_mark_read (node);	/* includes all child nodes */
+		node_reset_unread_count (node);
 	}
-		
-	if (node->children)
-		node_foreach_child (node, node_mark_all_read);
 }
 
 gchar *
@@ -268,7 +268,7 @@ atom10_parse_link (xmlNodePtr cur, feedParserCtxtPtr ctxt, struct atom10ParserSt
 	if (href) {
 		xmlChar *baseURL = xmlNodeGetBase (cur->doc, cur);
 		gchar *url, *relation, *type, *escTitle = NULL, *title;
-		const gchar *feedURL = subscription_get_homepage (ctxt->subscription);
+		const gchar *feedURL = feed_parser_ctxt_get_homepage (ctxt);
 		
 		if (!baseURL && feedURL && feedURL[0] != '|' && strstr (feedURL, "://"))
 			baseURL = xmlStrdup (BAD_CAST (feedURL));
@@ -284,7 +284,7 @@ atom10_parse_link (xmlNodePtr cur, feedParserCtxtPtr ctxt, struct atom10ParserSt
 			alternate = g_strdup (url);
 		else if (g_str_equal (relation, "replies")) {
 			if (!type || g_str_equal (type, BAD_CAST"application/atom+xml")) {
-				gchar *commentUri = (gchar *)common_build_url ((gchar *)url, subscription_get_homepage (ctxt->subscription));
+				gchar *commentUri = (gchar *)common_build_url ((gchar *)url, feed_parser_ctxt_get_homepage (ctxt));
 				if (ctxt->item)
 					metadata_list_set (&ctxt->item->metadata, "commentFeedUri", commentUri);
 				g_free (commentUri);
@@ -545,7 +545,7 @@ atom10_parse_entry (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 	ctxt->item->readStatus = FALSE;
 	
 	if (0 == ctxt->item->time)
-		ctxt->item->time = ctxt->feed->time;
+		ctxt->item->time = feed_parser_ctxt_get_time (ctxt);
 	
 	return ctxt->item;
 }
@@ -641,7 +641,7 @@ atom10_parse_feed_link (xmlNodePtr cur, feedParserCtxtPtr ctxt, struct atom10Par
 	if (href) {
 		xmlChar *baseURL = xmlNodeGetBase (cur->doc, xmlDocGetRootElement (cur->doc));
 
-		subscription_set_homepage (ctxt->subscription, href);
+		feed_parser_ctxt_set_homepage (ctxt, href);
 		/* Set the default base to the feed's HTML URL if not set yet */
 		if (baseURL == NULL)
 			xmlNodeSetBase (xmlDocGetRootElement (cur->doc), (xmlChar *)href);
@@ -827,6 +827,43 @@ atom10_parse_feed (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 	}
 }
 
+/* Streaming hook: collects the entries of the document as soon as
+   they are complete. Everything else is left in the DOM for
+   atom10_parse_feed(). */
+static gboolean
+atom10_parse_element (feedParserCtxtPtr ctxt, xmlNodePtr cur)
+{
+	gchar *timestamp;
+
+	if (!cur->name || cur->type != XML_ELEMENT_NODE || !cur->ns || !cur->ns->href)
+		return FALSE;
+
+	if (cur->parent != xmlDocGetRootElement (cur->doc) || xmlStrcmp (cur->ns->href, ATOM10_NS))
+		return FALSE;
+
+	if (xmlStrEqual (cur->name, BAD_CAST"entry")) {
+		ctxt->item = atom10_parse_entry (ctxt, cur);
+		if (ctxt->item)
+			ctxt->items = g_list_insert_sorted (ctxt->items, ctxt->item, atom10_item_sort_by_date);
+		return TRUE;
+	}
+
+	/* Entries depend on the feed link (as default base URL) and the
+	   feed update time, which usually precede them. So handle those
+	   early, atom10_parse_feed() will process them again. */
+	if (xmlStrEqual (cur->name, BAD_CAST"link")) {
+		atom10_parse_feed_link (cur, ctxt, NULL);
+	} else if (xmlStrEqual (cur->name, BAD_CAST"updated")) {
+		timestamp = (gchar *)xmlNodeListGetString (cur->doc, cur->xmlChildrenNode, 1);
+		if (timestamp) {
+			ctxt->streamTime = date_parse_ISO8601 (timestamp);
+			g_free (timestamp);
+		}
+	}
+
+	return FALSE;
+}
+
 static gboolean
 atom10_format_check (xmlDocPtr doc, xmlNodePtr cur)
 {
@@ -875,6 +912,7 @@ atom10_init_feed_handler (void)
 	fhp->typeStr = "atom";
 	fhp->feedParser	= atom10_parse_feed;
 	fhp->checkFormat = atom10_format_check;
+	fhp->parseElement = atom10_parse_element;
 
 	return fhp;
 }
@@ -61,7 +61,7 @@ parse_item_tag (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 		tmp = xml_get_attribute (cur, "url");
 		if (tmp) {
 			/* the following code is duplicated from rss_item.c! */
-			const gchar *feedURL = subscription_get_homepage (ctxt->subscription);
+			const gchar *feedURL = feed_parser_ctxt_get_homepage (ctxt);
 			
 			gchar *type = xml_get_attribute (cur, "type");
 			gchar *lengthStr = xml_get_attribute (cur, "length");
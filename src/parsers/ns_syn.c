@@ -70,7 +70,7 @@ ns_syn_parse_tag (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 	}
 	
 	/* postprocessing */
-	if (0 != frequency)
+	if (0 < period && 0 != frequency)
 		period /= frequency;
 
 	subscription_set_default_update_interval (ctxt->subscription, period);
@@ -304,6 +304,69 @@ static void rss_parse(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
 	}
 }
 
+/* Returns TRUE if the given element is the one rss_parse()
+   collects items from (the channel for RSS 2.0, the root
+   element for RSS 1.0 and 1.1). */
+static gboolean
+rss_is_item_container (xmlNodePtr cur)
+{
+	xmlNodePtr root = xmlDocGetRootElement (cur->doc);
+
+	if (cur == root)
+		return xmlStrcmp (root->name, BAD_CAST"rss") != 0;
+
+	return (cur->parent == root) &&
+	       !xmlStrcmp (root->name, BAD_CAST"rss") &&
+	       (!xmlStrcmp (cur->name, BAD_CAST"channel") ||
+	        !xmlStrcmp (cur->name, BAD_CAST"Channel"));
+}
+
+/**
+ * Streaming hook: collects the items of the document as soon
+ * as they are complete. Everything else is left in the DOM
+ * for rss_parse().
+ *
+ * @param ctxt		the feed parser context
+ * @param cur		the completed element
+ *
+ * @returns TRUE if the element was an item
+ */
+static gboolean
+rss_parse_element (feedParserCtxtPtr ctxt, xmlNodePtr cur)
+{
+	xmlNodePtr	parent = cur->parent;
+	gchar		*tmp;
+
+	if (!cur->name || !parent || !parent->name)
+		return FALSE;
+
+	if (!xmlStrcmp (cur->name, BAD_CAST"item")) {
+		if (!rss_is_item_container (parent) &&
+		    !(!xmlStrcmp (parent->name, BAD_CAST"items") && rss_is_item_container (parent->parent)))	/* RSS 1.1 */
+			return FALSE;
+
+		/* the item time fallback is done by feed_parse() */
+		if (NULL != (ctxt->item = parseRSSItem (ctxt, cur)))
+			ctxt->items = g_list_append (ctxt->items, ctxt->item);
+		return TRUE;
+	}
+
+	/* The channel link is usually before the items and needed to
+	   resolve relative item links, so set it early. parseChannel()
+	   will set it again. */
+	if (!xmlStrcmp (cur->name, BAD_CAST"link") && 
+	    !(cur->ns && cur->ns->prefix) &&
+	    (!xmlStrcmp (parent->name, BAD_CAST"channel") ||
+	     !xmlStrcmp (parent->name, BAD_CAST"Channel"))) {
+ 		if (NULL != (tmp = unhtmlize ((gchar *)xmlNodeListGetString (ctxt->doc, cur->xmlChildrenNode, TRUE)))) {
+			feed_parser_ctxt_set_homepage (ctxt, tmp);
+			g_free (tmp);
+		}
+	}
+
+	return FALSE;
+}
+
 static gboolean rss_format_check(xmlDocPtr doc, xmlNodePtr cur) {
 
 	if(!xmlStrcmp(cur->name, BAD_CAST"rss") ||
@@ -381,6 +444,7 @@ rss_init_feed_handler (void)
 	fhp->typeStr = "rss";
 	fhp->feedParser	= rss_parse;
 	fhp->checkFormat = rss_format_check;
+	fhp->parseElement = rss_parse_element;
 	
 	return fhp;
 }
@@ -99,7 +99,7 @@ parseRSSItem (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 			/* RSS 0.93 allows multiple enclosures */
 			tmp = xml_get_attribute (cur, "url");
 			if (tmp) {
-				const gchar *feedURL = subscription_get_homepage (ctxt->subscription);
+				const gchar *feedURL = feed_parser_ctxt_get_homepage (ctxt);
 				
 				gchar *type = xml_get_attribute (cur, "type");
 				gchar *lengthStr = xml_get_attribute (cur, "length");
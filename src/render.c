@@ -39,6 +39,7 @@
 #include "itemset.h"
 #include "render.h"
 #include "xml.h"
+#include "xslt_cache.h"
 #include "ui/liferea_htmlview.h"
 #include "ui/itemview.h"
 #include "ui/liferea_shell.h"
@@ -54,13 +55,12 @@
    localization stylesheet (xslt/i18n-filter.xslt). The resulting XSLT
    instance is kept in memory and used to render each items and feeds. 
    
-   The following code uses a hash table to maintain stylesheet instance
-   and performs CSS adaptions to the current GTK theme. */
+   The following code uses the XSLT stylesheet cache to maintain the
+   stylesheet instances and performs CSS adaptions to the current GTK 
+   theme. */
 
 static renderParamPtr	langParams = NULL;	/* the current locale settings (for localization stylesheet) */
 
-static GHashTable	*stylesheets = NULL;	/* XSLT stylesheet cache */
-
 static void
 render_init (void)
 {
@@ -89,28 +89,15 @@ render_init (void)
 
 	g_strfreev (shortlang);
 	g_strfreev (lang);
-
-	if (!stylesheets)
-		stylesheets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 }
 
+/* stylesheet cache callback loading and translating a rendering stylesheet */
 static xsltStylesheetPtr
-render_load_stylesheet (const gchar *xsltName)
+render_compile_stylesheet (const gchar *filename, gpointer user_data)
 {
 	xsltStylesheetPtr	i18n_filter;
 	xsltStylesheetPtr	xslt;
 	xmlDocPtr		xsltDoc, resDoc;
-	gchar			*filename;
-
-	if (!stylesheets)
-		render_init ();
-
-	/* try to serve the stylesheet from the cache */
-	xslt = (xsltStylesheetPtr)g_hash_table_lookup (stylesheets, xsltName);
-	if (xslt)
-		return xslt;
-
-	/* or load and translate it... */
 
 	/* 1. load localization stylesheet */
 	i18n_filter = xsltParseStylesheetFile (PACKAGE_DATA_DIR G_DIR_SEPARATOR_S PACKAGE G_DIR_SEPARATOR_S "xslt" G_DIR_SEPARATOR_S "i18n-filter.xslt");
@@ -120,16 +107,13 @@ render_load_stylesheet (const gchar *xsltName)
 	}
 
 	/* 2. load and localize the rendering stylesheet */
-	filename = g_strjoin (NULL, PACKAGE_DATA_DIR G_DIR_SEPARATOR_S PACKAGE G_DIR_SEPARATOR_S "xslt" G_DIR_SEPARATOR_S, xsltName, ".xml", NULL);
 	xsltDoc = xmlParseFile (filename);
 	if (!xsltDoc)
-		g_warning ("fatal: could not load rendering stylesheet (%s)!", xsltName);
-
-	g_free (filename);
+		g_warning ("fatal: could not load rendering stylesheet (%s)!", filename);
 
 	resDoc = xsltApplyStylesheet (i18n_filter, xsltDoc, (const gchar **)langParams->params);
 	if (!resDoc)
-		g_warning ("fatal: applying localization stylesheet failed (%s)!", xsltName);
+		g_warning ("fatal: applying localization stylesheet failed (%s)!", filename);
 
 	/* Use the following to debug XSLT transformation problems */
 	/* xsltSaveResultToFile (stdout, resDoc, i18n_filter); */
@@ -137,12 +121,27 @@ render_load_stylesheet (const gchar *xsltName)
 	/* 3. create localized rendering stylesheet */
 	xslt = xsltParseStylesheetDoc(resDoc);
 	if (!xslt)
-		g_warning("fatal: could not load rendering stylesheet (%s)!", xsltName);
+		g_warning("fatal: could not load rendering stylesheet (%s)!", filename);
 
 	xmlFreeDoc (xsltDoc);
 	xsltFreeStylesheet (i18n_filter);
+	
+	return xslt;
+}
+
+/* returns a referenced stylesheet, to be released using xslt_cache_release() */
+static xsltStylesheetPtr
+render_load_stylesheet (const gchar *xsltName)
+{
+	xsltStylesheetPtr	xslt;
+	gchar			*filename;
+
+	if (!langParams)
+		render_init ();
 
-	g_hash_table_insert (stylesheets, g_strdup (xsltName), xslt);
+	filename = g_strjoin (NULL, PACKAGE_DATA_DIR G_DIR_SEPARATOR_S PACKAGE G_DIR_SEPARATOR_S "xslt" G_DIR_SEPARATOR_S, xsltName, ".xml", NULL);
+	xslt = xslt_cache_get (filename, render_compile_stylesheet, NULL);
+	g_free (filename);
 	
 	return xslt;
 }
@@ -312,6 +311,7 @@ render_xml (xmlDocPtr doc, const gchar *xsltName, renderParamPtr paramSet)
 	resDoc = xsltApplyStylesheet (xslt, doc, (const gchar **)paramSet->params);
 	if (!resDoc) {
 		g_warning ("fatal: applying rendering stylesheet (%s) failed!", xsltName);
+		xslt_cache_release (xslt);
 		return NULL;
 	}
 	
@@ -327,6 +327,7 @@ render_xml (xmlDocPtr doc, const gchar *xsltName, renderParamPtr paramSet)
 
 	xmlOutputBufferClose (buf);
 	xmlFreeDoc (resDoc);
+	xslt_cache_release (xslt);
 	render_parameter_free (paramSet);
 	
 	if (output) {
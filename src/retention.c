@@ -0,0 +1,325 @@
+/**
+ * @file retention.c  item cache retention
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "retention.h"
+
+#include "common.h"
+#include "conf.h"
+#include "db.h"
+#include "debug.h"
+#include "itemlist.h"
+#include "newsbin.h"
+#include "node.h"
+#include "vfolder.h"
+#include "ui/liferea_shell.h"
+
+#define RETENTION_BATCH_SIZE	200		/**< maximum number of items removed per step */
+#define RETENTION_SIZE_MAX_ROWS	5000		/**< maximum number of items removed per run for the DB size limit */
+#define RETENTION_START_DELAY	(5*60)		/**< delay of the first full run after startup (seconds) */
+#define RETENTION_INTERVAL	(60*60)		/**< interval of full runs (seconds) */
+
+typedef enum {
+	RETENTION_STAGE_COUNT,	/**< trimming requested item sets to their maximum item count */
+	RETENTION_STAGE_AGE,	/**< removing items older than the maximum age */
+	RETENTION_STAGE_SIZE	/**< removing the oldest items until the DB fits its maximum size */
+} retentionStage;
+
+static GHashTable	*requests = NULL;	/**< node id -> maximum item count of item sets to trim */
+static guint		idle = 0;		/**< idle source of the running run (or 0) */
+static guint		timer = 0;		/**< timer source of the next full run (or 0) */
+static retentionStage	stage;			/**< current stage of the running run */
+static gboolean		fullRun = FALSE;	/**< TRUE if the running run checks age and size too */
+static GSList		*protectedIds = NULL;	/**< node ids of the news bins while running */
+static guint		runRows = 0;		/**< item rows removed by the running run */
+static gint64		runSize = 0;		/**< used DB size when the running run started */
+static gint		sizeRows = -1;		/**< items still to remove for the DB size limit (-1 if not yet estimated) */
+
+/* Removes the given items and updates the counters of the
+   given nodes. Returns the number of removed item rows. */
+static guint
+retention_remove (GArray *ids, GHashTable *nodeIds)
+{
+	GHashTableIter	iter;
+	gpointer	nodeId;
+	guint		removed;
+
+	db_begin_batch ();
+	removed = itemlist_remove_item_ids (ids);
+	db_end_batch ();
+
+	g_hash_table_iter_init (&iter, nodeIds);
+	while (g_hash_table_iter_next (&iter, &nodeId, NULL)) {
+		nodePtr node = node_from_id ((gchar *)nodeId);
+		if (node)
+			node_update_counters (node);
+	}
+	vfolder_foreach (node_update_counters);
+
+	runRows += removed;
+
+	return removed;
+}
+
+static GHashTable *
+retention_node_ids_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+/* Removes one batch of items exceeding the maximum item count
+   of a requested item set. Returns FALSE if there is nothing
+   left to trim. */
+static gboolean
+retention_count_step (void)
+{
+	GHashTableIter	iter;
+	GHashTable	*nodeIds;
+	GArray		*ids;
+	gpointer	nodeId, max;
+	guint		count, removed = 0;
+
+	if (!requests)
+		return FALSE;
+
+	g_hash_table_iter_init (&iter, requests);
+	while (g_hash_table_iter_next (&iter, &nodeId, &max)) {
+		ids = db_itemset_get_excess_items ((gchar *)nodeId, GPOINTER_TO_UINT (max), RETENTION_BATCH_SIZE);
+		count = ids->len;
+		if (count) {
+			debug3 (DEBUG_CACHE, "trimming %u items of node %s to the limit of %u", count, (gchar *)nodeId, GPOINTER_TO_UINT (max));
+			nodeIds = retention_node_ids_new ();
+			g_hash_table_insert (nodeIds, g_strdup ((gchar *)nodeId), GINT_TO_POINTER (1));
+			removed = retention_remove (ids, nodeIds);
+			g_hash_table_destroy (nodeIds);
+		}
+		g_array_free (ids, TRUE);
+
+		/* The item set is done when the rest fitted in this batch
+		   or nothing could be removed (e.g. the selected item) */
+		if ((count < RETENTION_BATCH_SIZE) || (0 == removed))
+			g_hash_table_iter_remove (&iter);
+
+		if (count)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Removes up to limit of the oldest items older than the given
+   time. Returns the number of removed items. */
+static guint
+retention_remove_oldest (glong before, guint limit)
+{
+	GHashTable	*nodeIds;
+	GArray		*ids;
+	guint		removed = 0;
+
+	nodeIds = retention_node_ids_new ();
+	ids = db_items_get_oldest (before, protectedIds, limit, nodeIds);
+	if (ids->len)
+		removed = retention_remove (ids, nodeIds);
+	g_array_free (ids, TRUE);
+	g_hash_table_destroy (nodeIds);
+
+	return removed;
+}
+
+static gboolean
+retention_age_step (void)
+{
+	GTimeVal	now;
+	gint		maxAge = 0;
+
+	conf_get_int_value (RETENTION_MAX_AGE, &maxAge);
+	if (maxAge <= 0)
+		return FALSE;
+
+	g_get_current_time (&now);
+	return (retention_remove_oldest (now.tv_sec - (glong)maxAge * 24 * 60 * 60, RETENTION_BATCH_SIZE) > 0);
+}
+
+/* The used DB size does not shrink reliably with each deleted
+   row (FTS delete markers, partly used pages), so it is measured
+   only once per run to estimate the number of items to remove
+   from the average row size. The next run measures again. */
+static gboolean
+retention_size_step (void)
+{
+	gint		maxSize = 0;
+	gint64		used, excess;
+	guint		count, removed;
+
+	if (sizeRows < 0) {
+		sizeRows = 0;
+
+		conf_get_int_value (RETENTION_MAX_DB_SIZE, &maxSize);
+		if (maxSize <= 0)
+			return FALSE;
+
+		used = db_get_used_size ();
+		excess = used - (gint64)maxSize * 1024 * 1024;
+		count = db_items_get_count ();
+		if ((excess <= 0) || (0 == count))
+			return FALSE;
+
+		/* rows to remove = excess / (used / count), rounded up */
+		sizeRows = (gint)MIN ((excess * count + used - 1) / used, RETENTION_SIZE_MAX_ROWS);
+		debug3 (DEBUG_CACHE, "DB exceeds its size limit by %" G_GINT64_FORMAT " bytes, removing %d of %u items", excess, sizeRows, count);
+	}
+
+	if (0 == sizeRows)
+		return FALSE;
+
+	removed = retention_remove_oldest (G_MAXLONG, MIN (sizeRows, RETENTION_BATCH_SIZE));
+	sizeRows = removed?(sizeRows - (gint)removed):0;
+
+	return (sizeRows > 0);
+}
+
+static void
+retention_finish_run (void)
+{
+	gint64	reclaimed;
+	gchar	*size;
+
+	reclaimed = MAX (0, runSize - db_get_used_size ());
+
+	debug3 (DEBUG_CACHE, "retention run finished: removed %u items, reclaimed %" G_GINT64_FORMAT " bytes%s", runRows, reclaimed, fullRun?" (full run)":"");
+
+	if (fullRun && runRows) {
+		size = g_format_size_for_display (reclaimed);
+		liferea_shell_set_status_bar (_("Cache cleanup removed %u items (%s)"), runRows, size);
+		g_free (size);
+	}
+
+	g_slist_foreach (protectedIds, (GFunc)g_free, NULL);
+	g_slist_free (protectedIds);
+	protectedIds = NULL;
+	fullRun = FALSE;
+}
+
+static gboolean
+retention_step_cb (gpointer user_data)
+{
+	gboolean	more = FALSE;
+
+	switch (stage) {
+		case RETENTION_STAGE_COUNT:
+			more = retention_count_step ();
+			break;
+		case RETENTION_STAGE_AGE:
+			more = retention_age_step ();
+			break;
+		case RETENTION_STAGE_SIZE:
+			more = retention_size_step ();
+			break;
+	}
+
+	if (more)
+		return TRUE;
+
+	if (fullRun && (stage < RETENTION_STAGE_SIZE)) {
+		stage++;
+		return TRUE;
+	}
+
+	/* Item sets merged while checking age and size */
+	if (requests && g_hash_table_size (requests) && (stage != RETENTION_STAGE_COUNT)) {
+		stage = RETENTION_STAGE_COUNT;
+		return TRUE;
+	}
+
+	retention_finish_run ();
+	idle = 0;
+
+	return FALSE;
+}
+
+static void
+retention_start_run (gboolean full)
+{
+	GSList	*iter;
+
+	if (full)
+		fullRun = TRUE;
+
+	if (idle)
+		return;
+
+	debug1 (DEBUG_CACHE, "starting %s retention run", fullRun?"full":"item count");
+
+	stage = RETENTION_STAGE_COUNT;
+	runRows = 0;
+	runSize = db_get_used_size ();
+	sizeRows = -1;
+
+	for (iter = newsbin_get_list (); iter; iter = g_slist_next (iter))
+		protectedIds = g_slist_prepend (protectedIds, g_strdup (((nodePtr)iter->data)->id));
+
+	idle = g_idle_add_full (G_PRIORITY_LOW, retention_step_cb, NULL, NULL);
+}
+
+void
+retention_request_node (const gchar *nodeId, guint max)
+{
+	if (!requests)
+		requests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_replace (requests, g_strdup (nodeId), GUINT_TO_POINTER (max));
+
+	retention_start_run (FALSE);
+}
+
+static gboolean
+retention_timer_cb (gpointer user_data)
+{
+	retention_start_run (TRUE);
+
+	timer = g_timeout_add_seconds (RETENTION_INTERVAL, retention_timer_cb, NULL);
+
+	return FALSE;
+}
+
+void
+retention_init (void)
+{
+	timer = g_timeout_add_seconds (RETENTION_START_DELAY, retention_timer_cb, NULL);
+}
+
+void
+retention_deinit (void)
+{
+	if (timer)
+		g_source_remove (timer);
+	timer = 0;
+
+	if (idle)
+		g_source_remove (idle);
+	idle = 0;
+
+	g_slist_foreach (protectedIds, (GFunc)g_free, NULL);
+	g_slist_free (protectedIds);
+	protectedIds = NULL;
+
+	if (requests)
+		g_hash_table_destroy (requests);
+	requests = NULL;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file retention.h  item cache retention
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _RETENTION_H
+#define _RETENTION_H
+
+#include <glib.h>
+
+/* The retention engine removes items from the cache DB according
+   to three policies:
+
+   - the maximum item count of an item set (checked after merging)
+   - the maximum item age (RETENTION_MAX_AGE, checked periodically)
+   - the maximum DB size (RETENTION_MAX_DB_SIZE, checked periodically)
+
+   Flagged items and items of news bins are never removed. The
+   oldest items are removed first.
+
+   Removal runs in the background from an idle callback that
+   removes one batch of items per call, so neither merging nor
+   the GUI is blocked by large removals. The SQLite connection
+   may only be used from the main thread, so no worker thread
+   is used. The number of removed items and reclaimed bytes is
+   reported when a run is finished. */
+
+/**
+ * Starts periodic retention runs.
+ */
+void retention_init (void);
+
+/**
+ * Stops all retention activity.
+ */
+void retention_deinit (void);
+
+/**
+ * Requests trimming the given item set to the given number
+ * of items. Trimming happens later in the background.
+ *
+ * @param nodeId	the node id of the item set
+ * @param max		maximum number of items to keep
+ */
+void retention_request_node (const gchar *nodeId, guint max);
+
+#endif
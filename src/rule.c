@@ -23,7 +23,9 @@
 #include <string.h>
 
 #include "common.h"
+#include "db.h"
 #include "debug.h"
+#include "metadata.h"
 
 #define ITEM_MATCH_RULE_ID		"exact"
 #define ITEM_TITLE_MATCH_RULE_ID	"exact_title"
@@ -75,18 +77,94 @@ rule_free (rulePtr rule)
 	g_free (rule);
 }
 
+/* text tokenizing */
+
+/* Text rules are matched like the SQLite FTS3 "simple" tokenizer
+   sees the text: tokens are runs of ASCII letters and digits and
+   non-ASCII characters, only ASCII characters are case folded. */
+
+#define RULE_IS_TOKEN_CHAR(c)	(g_ascii_isalnum (c) || ((guchar)(c) & 0x80))
+
+typedef struct ruleToken {
+	const gchar	*start;		/**< first character of the token */
+	gsize		length;		/**< length of the token in bytes */
+} ruleToken;
+
+/* Returns the tokens of the given text as an array of ruleToken */
+static GArray *
+rule_text_tokenize (const gchar *text)
+{
+	GArray		*tokens;
+	ruleToken	token;
+
+	tokens = g_array_new (FALSE, FALSE, sizeof (ruleToken));
+	while (*text) {
+		if (!RULE_IS_TOKEN_CHAR (*text)) {
+			text++;
+			continue;
+		}
+
+		token.start = text;
+		while (*text && RULE_IS_TOKEN_CHAR (*text))
+			text++;
+		token.length = text - token.start;
+		g_array_append_val (tokens, token);
+	}
+
+	return tokens;
+}
+
+/* Checks if the tokens of the text contain the tokens of the rule
+   value as a phrase of prefixes, like the FTS condition built by
+   rule_sql_fts_match() does. Without full text index (or without
+   tokens in the rule value) the SQL conditions use LIKE, so a case
+   insensitive substring match is done instead. */
+static gboolean
+rule_text_match (rulePtr rule, const gchar *text)
+{
+	GArray		*values, *tokens;
+	ruleToken	*value, *token;
+	guint		i, j;
+	gboolean	found = FALSE;
+
+	if (!text)
+		return FALSE;
+
+	values = rule_text_tokenize (rule->value);
+	if (!db_fts_available () || 0 == values->len) {
+		g_array_free (values, TRUE);
+		return (NULL != common_strcasestr (text, rule->value));
+	}
+
+	tokens = rule_text_tokenize (text);
+	for (i = 0; !found && (i + values->len <= tokens->len); i++) {
+		for (j = 0; j < values->len; j++) {
+			value = &g_array_index (values, ruleToken, j);
+			token = &g_array_index (tokens, ruleToken, i + j);
+			if ((token->length < value->length) ||
+			    (0 != g_ascii_strncasecmp (token->start, value->start, value->length)))
+				break;
+		}
+		found = (j == values->len);
+	}
+	g_array_free (tokens, TRUE);
+	g_array_free (values, TRUE);
+
+	return found;
+}
+
 /* rule conditions */
 
 static gboolean
 rule_check_item_title (rulePtr rule, itemPtr item)
 {
-	return (NULL != g_strstr_len (item->title, -1, rule->value));
+	return rule_text_match (rule, item->title);
 }
 
 static gboolean
 rule_check_item_description (rulePtr rule, itemPtr item)
 {
-	return (NULL != g_strstr_len (item->description, -1, rule->value));
+	return rule_text_match (rule, item->description);
 }
 
 static gboolean
@@ -95,6 +173,123 @@ rule_check_item_all (rulePtr rule, itemPtr item)
 	return rule_check_item_title (rule, item) || rule_check_item_description (rule, item);
 }
 
+/* SQL condition builders */
+
+/* Note: rule values never contain single quotes (see rule_new())
+   so they can be used in SQL string literals as is. */
+
+static gchar *
+rule_sql_fts_match (const gchar *ftsColumn, const gchar *value)
+{
+	GArray		*tokens;
+	ruleToken	*token;
+	GString		*match;
+	gchar		*result = NULL;
+	guint		i;
+
+	if (!db_fts_available ())
+		return NULL;
+
+	/* Use a phrase query of prefix tokens, the tokens never
+	   contain FTS query syntax characters (see rule_text_match()) */
+	match = g_string_new (NULL);
+	tokens = rule_text_tokenize (value);
+	for (i = 0; i < tokens->len; i++) {
+		token = &g_array_index (tokens, ruleToken, i);
+		g_string_append_printf (match, "%s%.*s*", match->len?" ":"", (int)token->length, token->start);
+	}
+	g_array_free (tokens, TRUE);
+
+	if (match->len)
+		result = g_strdup_printf ("items.item_id IN (SELECT docid FROM items_fts WHERE %s MATCH '\"%s\"')", ftsColumn, match->str);
+	g_string_free (match, TRUE);
+
+	return result;
+}
+
+static gchar *
+rule_sql_like_match (const gchar *column, const gchar *value)
+{
+	gchar	*escaped, *result;
+
+	escaped = common_strreplace (g_strdup (value), "\\", "\\\\");
+	escaped = common_strreplace (escaped, "%", "\\%");
+	escaped = common_strreplace (escaped, "_", "\\_");
+	result = g_strdup_printf ("ifnull(items.%s,'') LIKE '%%%s%%' ESCAPE '\\'", column, escaped);
+	g_free (escaped);
+
+	return result;
+}
+
+static gchar *
+rule_sql_item_title (rulePtr rule)
+{
+	gchar *result = rule_sql_fts_match ("items_fts.title", rule->value);
+
+	return result?result:rule_sql_like_match ("title", rule->value);
+}
+
+static gchar *
+rule_sql_item_description (rulePtr rule)
+{
+	gchar *result = rule_sql_fts_match ("items_fts.description", rule->value);
+
+	return result?result:rule_sql_like_match ("description", rule->value);
+}
+
+static gchar *
+rule_sql_item_all (rulePtr rule)
+{
+	gchar	*title, *description, *result;
+
+	result = rule_sql_fts_match ("items_fts", rule->value);
+	if (result)
+		return result;
+
+	title = rule_sql_like_match ("title", rule->value);
+	description = rule_sql_like_match ("description", rule->value);
+	result = g_strdup_printf ("(%s OR %s)", title, description);
+	g_free (title);
+	g_free (description);
+
+	return result;
+}
+
+static gchar *
+rule_sql_item_is_unread (rulePtr rule)
+{
+	return g_strdup ("items.read = 0");
+}
+
+static gchar *
+rule_sql_item_is_flagged (rulePtr rule)
+{
+	return g_strdup ("items.marked = 1");
+}
+
+static gchar *
+rule_sql_item_has_enc (rulePtr rule)
+{
+	return g_strdup ("items.item_id IN (SELECT item_id FROM metadata WHERE key = 'enclosure')");
+}
+
+static gchar *
+rule_sql_item_category (rulePtr rule)
+{
+	return g_strdup_printf ("items.item_id IN (SELECT item_id FROM metadata WHERE key = 'category' AND value = '%s')", rule->value);
+}
+
+gchar *
+rule_to_sql (rulePtr rule)
+{
+	if (!rule->ruleInfo->sqlFunc)
+		return NULL;
+
+	return (*((ruleSqlFunc)rule->ruleInfo->sqlFunc)) (rule);
+}
+
+/* in-memory rule checks */
+
 static gboolean
 rule_check_item_is_unread (rulePtr rule, itemPtr item)
 {
@@ -110,19 +305,31 @@ rule_check_item_is_flagged (rulePtr rule, itemPtr item)
 static gboolean
 rule_check_item_has_enc (rulePtr rule, itemPtr item)
 {
-	return FALSE; // FIXME
+	return (NULL != metadata_list_get (item->metadata, "enclosure"));
 }
 
 static gboolean
 rule_check_item_category (rulePtr rule, itemPtr item)
 {
-	return FALSE; // FIXME
+	GSList		*values, *iter;
+	gboolean	found = FALSE;
+
+	iter = values = metadata_list_get_values (item->metadata, "category");
+	while (iter && !found) {
+		found = g_str_equal (rule->value, iter->data);
+		iter = g_slist_next (iter);
+	}
+	g_slist_free (values);
+
+	return found;
 }
 
 /* rule initialization */
 
 static void
-rule_info_add (ruleCheckFunc checkFunc,
+rule_info_add (ruleSqlFunc sqlFunc,
+          ruleCheckFunc checkFunc,
+          guint fields,
           const gchar *ruleId, 
           gchar *title,
           gchar *positive,
@@ -137,7 +344,9 @@ rule_info_add (ruleCheckFunc checkFunc,
 	ruleInfo->positive = positive;
 	ruleInfo->negative = negative;
 	ruleInfo->needsParameter = needsParameter;	
+	ruleInfo->fields = fields;
 	ruleInfo->checkFunc = checkFunc;
+	ruleInfo->sqlFunc = sqlFunc;
 	ruleFunctions = g_slist_append (ruleFunctions, ruleInfo);
 }
 
@@ -146,16 +355,16 @@ rule_init (void)
 {
 	debug_enter ("rule_init");
 
-	/*        SQL condition builder function	in-memory check function	feedlist.opml rule id           rule menu label         positive menu option    negative menu option    has param */ 
-	/*        ========================================================================================================================================================================================*/
+	/*        SQL condition builder function	in-memory check function	item fields					feedlist.opml rule id           rule menu label         positive menu option    negative menu option    has param */ 
+	/*        ===============================================================================================================================================================================================================================================*/
 	
-	rule_info_add (rule_check_item_all,		ITEM_MATCH_RULE_ID,		_("Item"),		_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_item_title,		ITEM_TITLE_MATCH_RULE_ID,	_("Item title"),	_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_item_description,	ITEM_DESC_MATCH_RULE_ID,	_("Item body"),		_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_item_is_unread,	"unread",			_("Read status"),	_("is unread"),		_("is read"),		FALSE);
-	rule_info_add (rule_check_item_is_flagged,	"flagged",			_("Flag status"),	_("is flagged"),	_("is unflagged"),	FALSE);
-	rule_info_add (rule_check_item_has_enc,		"enclosure",			_("Podcast"),		_("included"),		_("not included"),	FALSE);
-	rule_info_add (rule_check_item_category,	"category",			_("Category"),		_("is set"),		_("is not set"),	TRUE);
+	rule_info_add (rule_sql_item_all,		rule_check_item_all,		RULE_FIELD_TITLE | RULE_FIELD_DESCRIPTION,	ITEM_MATCH_RULE_ID,		_("Item"),		_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_sql_item_title,		rule_check_item_title,		RULE_FIELD_TITLE,				ITEM_TITLE_MATCH_RULE_ID,	_("Item title"),	_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_sql_item_description,	rule_check_item_description,	RULE_FIELD_DESCRIPTION,				ITEM_DESC_MATCH_RULE_ID,	_("Item body"),		_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_sql_item_is_unread,		rule_check_item_is_unread,	RULE_FIELD_READ,				"unread",			_("Read status"),	_("is unread"),		_("is read"),		FALSE);
+	rule_info_add (rule_sql_item_is_flagged,	rule_check_item_is_flagged,	RULE_FIELD_FLAG,				"flagged",			_("Flag status"),	_("is flagged"),	_("is unflagged"),	FALSE);
+	rule_info_add (rule_sql_item_has_enc,		rule_check_item_has_enc,	RULE_FIELD_METADATA,				"enclosure",			_("Podcast"),		_("included"),		_("not included"),	FALSE);
+	rule_info_add (rule_sql_item_category,		rule_check_item_category,	RULE_FIELD_METADATA,				"category",			_("Category"),		_("is set"),		_("is not set"),	TRUE);
 
 	debug_exit ("rule_init");
 }
@@ -25,6 +25,17 @@
 
 #include "item.h"
 
+/** item fields a rule depends on */
+typedef enum {
+	RULE_FIELD_TITLE	= 1 << 0,	/**< item title */
+	RULE_FIELD_DESCRIPTION	= 1 << 1,	/**< item description */
+	RULE_FIELD_READ		= 1 << 2,	/**< item read status */
+	RULE_FIELD_FLAG		= 1 << 3,	/**< item flag status */
+	RULE_FIELD_METADATA	= 1 << 4	/**< item metadata (enclosures, categories...) */
+} ruleFields;
+
+#define RULE_FIELD_ALL	(RULE_FIELD_TITLE | RULE_FIELD_DESCRIPTION | RULE_FIELD_READ | RULE_FIELD_FLAG | RULE_FIELD_METADATA)
+
 /** rule info structure */
 typedef struct ruleInfo {
 	const gchar	*ruleId;	/**< rule id for cache file storage */
@@ -32,8 +43,10 @@ typedef struct ruleInfo {
 	gchar		*positive;	/**< text for positive logic selection */
 	gchar		*negative;	/**< text for negative logic selection */
 	gboolean	needsParameter;	/**< some rules may require no parameter... */
+	guint		fields;		/**< item fields the rule depends on (see ruleFields) */
 	
 	gpointer	checkFunc;	/**< the item check function */
+	gpointer	sqlFunc;	/**< the SQL condition builder function (or NULL) */
 } *ruleInfoPtr;
 
 /** structure to store a rule instance */
@@ -46,6 +59,9 @@ typedef struct rule {
 /** function type used to check items */
 typedef gboolean (*ruleCheckFunc)	(rulePtr rule, itemPtr item);
 
+/** function type used to build an SQL condition on the "items" table */
+typedef gchar * (*ruleSqlFunc)	(rulePtr rule);
+
 /**
  * Returns a list of rule infos. To be used for rule editor 
  * dialog setup.
@@ -66,6 +82,17 @@ GSList * rule_get_available_rules (void);
  */
 rulePtr rule_new (const gchar *ruleId, const gchar *value, gboolean additive);
 
+/**
+ * Builds an SQL condition on the "items" table matching exactly
+ * the items the given rule matches (ignoring the rule logic).
+ *
+ * @param rule	the rule
+ *
+ * @returns a newly allocated SQL condition (or NULL if the 
+ * rule cannot be expressed in SQL)
+ */
+gchar * rule_to_sql (rulePtr rule);
+
 /** 
  * Free's the given rule structure 
  *
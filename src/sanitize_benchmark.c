@@ -0,0 +1,218 @@
+/**
+ * @file sanitize_benchmark.c  HTML sanitizer benchmark
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Compares the former regex based validation and stripping of HTML
+   metadata (xhtml_is_well_formed() and xhtml_strip_dhtml()) with the
+   single pass xhtml_sanitize() on a corpus of real feed content.
+
+   The corpus is given as feed documents (e.g. saved with wget). All
+   RSS description and content:encoded and Atom content and summary
+   values are extracted and run through both paths.
+
+   Build with "make sanitize-benchmark" in src/ and run as
+
+      ./sanitize-benchmark [--rounds=N] [--verbose] feed.xml...  */
+
+#include <string.h>
+#include <glib.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "debug.h"
+#include "xml.h"
+
+/* xml.c refers to the feed parser for xml_parse_feed(),
+   which is not used here */
+struct xmlStreamParser *
+feed_parser_stream_new (feedParserCtxtPtr ctxt, gboolean freeCtxt)
+{
+	return NULL;
+}
+
+static gboolean
+sanitize_benchmark_is_html_element (xmlNodePtr cur)
+{
+	return (0 == xmlStrcmp (cur->name, BAD_CAST "description")) ||
+	       (0 == xmlStrcmp (cur->name, BAD_CAST "encoded")) ||
+	       (0 == xmlStrcmp (cur->name, BAD_CAST "content")) ||
+	       (0 == xmlStrcmp (cur->name, BAD_CAST "summary"));
+}
+
+/* Returns the value of an HTML element, child elements
+   (Atom XHTML content) are serialized as markup */
+static gchar *
+sanitize_benchmark_get_value (xmlNodePtr cur)
+{
+	xmlBufferPtr	buffer;
+	xmlNodePtr	child;
+	xmlChar		*text;
+	gchar		*value;
+
+	for (child = cur->children; child; child = child->next) {
+		if (XML_ELEMENT_NODE == child->type)
+			break;
+	}
+
+	if (!child) {
+		text = xmlNodeGetContent (cur);
+		value = g_strdup ((gchar *)text);
+		xmlFree (text);
+		return value;
+	}
+
+	buffer = xmlBufferCreate ();
+	for (child = cur->children; child; child = child->next)
+		xmlNodeDump (buffer, cur->doc, child, 0, 0);
+	value = g_strdup ((gchar *)xmlBufferContent (buffer));
+	xmlBufferFree (buffer);
+
+	return value;
+}
+
+static void
+sanitize_benchmark_collect (xmlNodePtr cur, GPtrArray *values)
+{
+	for (; cur; cur = cur->next) {
+		if (XML_ELEMENT_NODE != cur->type)
+			continue;
+
+		if (sanitize_benchmark_is_html_element (cur)) {
+			gchar *value = sanitize_benchmark_get_value (cur);
+			if (value && *value)
+				g_ptr_array_add (values, value);
+			else
+				g_free (value);
+		} else {
+			sanitize_benchmark_collect (cur->children, values);
+		}
+	}
+}
+
+/* the validation and stripping formerly done by metadata_list_append() */
+static gchar *
+sanitize_benchmark_regex_path (const gchar *html)
+{
+	gchar	*tmp, *result;
+
+	if (xhtml_is_well_formed (html))
+		tmp = g_strdup (html);
+	else
+		tmp = g_markup_escape_text (html, -1);
+	result = xhtml_strip_dhtml (tmp);
+	g_free (tmp);
+
+	return result;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext	*context;
+	GError		*error = NULL;
+	GPtrArray	*values;
+	GTimer		*timer;
+	gint		rounds = 10, i;
+	gboolean	verbose = FALSE;
+	guint		j, differences = 0;
+	gsize		bytes = 0;
+	gdouble		regexTime, scanTime;
+
+	GOptionEntry entries[] = {
+		{ "rounds", 'n', 0, G_OPTION_ARG_INT, &rounds, "Number of runs over the corpus (default 10)", "N" },
+		{ "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print values for which the results differ", NULL },
+		{ NULL }
+	};
+
+	context = g_option_context_new ("FEED...");
+	g_option_context_set_summary (context, "Compares the regex based HTML stripping with xhtml_sanitize()");
+	g_option_context_add_main_entries (context, entries, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free (context);
+
+	if (argc < 2 || rounds < 1) {
+		g_printerr ("Usage: %s [--rounds=N] [--verbose] FEED...\n", argv[0]);
+		return 1;
+	}
+
+	set_debug_level (0);
+	xml_init ();
+
+	/* 1. Collect the corpus */
+	values = g_ptr_array_new ();
+	for (i = 1; i < argc; i++) {
+		xmlDocPtr doc = xmlReadFile (argv[i], NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+		if (!doc) {
+			g_printerr ("Could not parse %s, skipping it\n", argv[i]);
+			continue;
+		}
+		sanitize_benchmark_collect (xmlDocGetRootElement (doc), values);
+		xmlFreeDoc (doc);
+	}
+
+	for (j = 0; j < values->len; j++)
+		bytes += strlen (g_ptr_array_index (values, j));
+
+	g_print ("corpus: %u values, %" G_GSIZE_FORMAT " bytes from %d files\n", values->len, bytes, argc - 1);
+	if (!values->len)
+		return 1;
+
+	/* 2. Compare the results once */
+	for (j = 0; j < values->len; j++) {
+		const gchar	*html = g_ptr_array_index (values, j);
+		gchar		*legacy = sanitize_benchmark_regex_path (html);
+		gchar		*result = xhtml_sanitize (html, XHTML_SANITIZE_ESCAPE_INVALID);
+
+		if (!g_str_equal (legacy, result)) {
+			differences++;
+			if (verbose)
+				g_print ("--- input:\n%s\n--- regex path:\n%s\n--- single pass:\n%s\n\n", html, legacy, result);
+		}
+		g_free (legacy);
+		g_free (result);
+	}
+
+	/* 3. Time both paths */
+	timer = g_timer_new ();
+	for (i = 0; i < rounds; i++)
+		for (j = 0; j < values->len; j++)
+			g_free (sanitize_benchmark_regex_path (g_ptr_array_index (values, j)));
+	regexTime = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	for (i = 0; i < rounds; i++)
+		for (j = 0; j < values->len; j++)
+			g_free (xhtml_sanitize (g_ptr_array_index (values, j), XHTML_SANITIZE_ESCAPE_INVALID));
+	scanTime = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_print ("regex path:  %.3fs (%d rounds)\n", regexTime, rounds);
+	g_print ("single pass: %.3fs (%d rounds)\n", scanTime, rounds);
+	g_print ("speedup:     %.1fx\n", (scanTime > 0.0)?(regexTime / scanTime):0.0);
+	g_print ("results differ for %u of %u values\n", differences, values->len);
+
+	g_ptr_array_foreach (values, (GFunc)g_free, NULL);
+	g_ptr_array_free (values, TRUE);
+	xmlCleanupParser ();
+
+	return 0;
+}
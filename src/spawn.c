@@ -0,0 +1,333 @@
+/**
+ * @file spawn.c  asynchronous command execution
+ *
+ * Copyright (C) 2011 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "spawn.h"
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "debug.h"
+
+#define SPAWN_READ_SIZE	65536	/**< bytes read per main loop dispatch */
+
+/** a running command */
+typedef struct spawnJob {
+	gchar		*command;	/**< the command line */
+	GPid		pid;		/**< process id of the shell (also its process group) */
+
+	GIOChannel	*input;		/**< pipe to the standard input (or NULL if closed) */
+	GIOChannel	*output;	/**< pipe from the standard output (or NULL if closed) */
+	GIOChannel	*errors;	/**< pipe from the standard error (or NULL if closed) */
+	guint		inputWatch;
+	guint		outputWatch;
+	guint		errorsWatch;
+	guint		childWatch;
+	guint		timeoutId;
+	GCancellable	*cancellable;	/**< cancellable to abort the command (or NULL) */
+	gulong		cancelledId;	/**< cancellable handler id (or 0) */
+
+	const gchar	*inputData;	/**< data to write to the standard input */
+	gsize		inputLength;	/**< length of the input data */
+	gsize		inputOffset;	/**< number of input bytes written so far */
+
+	GString		*out;		/**< standard output buffer */
+	GString		*err;		/**< standard error buffer */
+	gsize		maxOutput;	/**< size limit of each output buffer */
+	guint		timeout;	/**< run time limit in seconds */
+
+	gboolean	exited;		/**< TRUE if the process was reaped */
+	gint		status;		/**< wait status of the process */
+	gchar		*failure;	/**< first failure reason (or NULL) */
+
+	spawnResultFunc	callback;
+	gpointer	user_data;
+} *spawnJobPtr;
+
+static void
+spawn_child_setup (gpointer user_data)
+{
+	/* Get an own process group, so that on timeout all processes
+	   started by the shell can be killed. Also the child must not
+	   inherit our ignored SIGPIPE. */
+	setpgid (0, 0);
+	signal (SIGPIPE, SIG_DFL);
+}
+
+static GIOChannel *
+spawn_channel_new (gint fd)
+{
+	GIOChannel *channel = g_io_channel_unix_new (fd);
+
+	g_io_channel_set_encoding (channel, NULL, NULL);
+	g_io_channel_set_buffered (channel, FALSE);
+	g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+	g_io_channel_set_close_on_unref (channel, TRUE);
+
+	return channel;
+}
+
+static void
+spawn_channel_close (GIOChannel **channel, guint *watch)
+{
+	if (*watch)
+		g_source_remove (*watch);
+	*watch = 0;
+
+	if (*channel)
+		g_io_channel_unref (*channel);
+	*channel = NULL;
+}
+
+static void
+spawn_finish (spawnJobPtr job)
+{
+	struct spawnResult	result;
+
+	if (job->timeoutId)
+		g_source_remove (job->timeoutId);
+	job->timeoutId = 0;
+
+	if (job->cancelledId)
+		g_cancellable_disconnect (job->cancellable, job->cancelledId);
+	if (job->cancellable)
+		g_object_unref (job->cancellable);
+
+	result.size = job->out->len;
+	result.data = g_string_free (job->out, FALSE);
+	result.errors = g_string_free (job->err, job->err->len == 0);
+	result.exitStatus = (job->exited && WIFEXITED (job->status))?WEXITSTATUS (job->status):-1;
+	result.success = !job->failure && (0 == result.exitStatus);
+	result.failure = job->failure;
+	if (!result.failure && !result.success)
+		result.failure = g_strdup_printf (_("%s exited with status %d"), job->command, result.exitStatus);
+
+	debug3 (DEBUG_UPDATE, "command \"%s\" finished (%d bytes output, status %d)", job->command, result.size, result.exitStatus);
+
+	(*job->callback) (&result, job->user_data);
+
+	g_free (result.data);
+	g_free (result.errors);
+	g_free (result.failure);
+	g_free (job->command);
+	g_free (job);
+}
+
+static void
+spawn_check_finished (spawnJobPtr job)
+{
+	if (job->exited && !job->input && !job->output && !job->errors)
+		spawn_finish (job);
+}
+
+/* Terminates the command for the given reason. Output
+   received so far is dropped. */
+static void
+spawn_abort (spawnJobPtr job, gchar *failure)
+{
+	debug2 (DEBUG_UPDATE, "aborting command \"%s\": %s", job->command, failure);
+
+	if (!job->failure)
+		job->failure = failure;
+	else
+		g_free (failure);
+
+	if (!job->exited && job->pid) {
+		if (0 != kill (-job->pid, SIGKILL))
+			kill (job->pid, SIGKILL);
+	}
+
+	spawn_channel_close (&job->input, &job->inputWatch);
+	spawn_channel_close (&job->output, &job->outputWatch);
+	spawn_channel_close (&job->errors, &job->errorsWatch);
+	g_string_truncate (job->out, 0);
+
+	spawn_check_finished (job);
+}
+
+static gboolean
+spawn_write_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	spawnJobPtr	job = (spawnJobPtr)user_data;
+	GIOStatus	status = G_IO_STATUS_ERROR;
+	gsize		written = 0;
+
+	if (condition & G_IO_OUT)
+		status = g_io_channel_write_chars (channel, job->inputData + job->inputOffset,
+		                                   job->inputLength - job->inputOffset, &written, NULL);
+	job->inputOffset += written;
+
+	/* Stop on errors, which includes the command not
+	   reading all of its input, and on end of input */
+	if ((G_IO_STATUS_ERROR == status) || (job->inputOffset >= job->inputLength)) {
+		job->inputWatch = 0;
+		spawn_channel_close (&job->input, &job->inputWatch);
+		spawn_check_finished (job);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+spawn_read_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	spawnJobPtr	job = (spawnJobPtr)user_data;
+	GString		*buffer = (channel == job->output)?job->out:job->err;
+	GIOStatus	status;
+	gsize		len, count = 0;
+
+	/* Read directly into the buffer which grows exponentially */
+	len = buffer->len;
+	g_string_set_size (buffer, len + SPAWN_READ_SIZE);
+	status = g_io_channel_read_chars (channel, buffer->str + len, SPAWN_READ_SIZE, &count, NULL);
+	g_string_truncate (buffer, len + count);
+
+	if (buffer->len > job->maxOutput) {
+		if (channel == job->output)
+			job->outputWatch = 0;
+		else
+			job->errorsWatch = 0;
+		spawn_abort (job, g_strdup_printf (_("%s produced more than %lu bytes of output"), job->command, (gulong)job->maxOutput));
+		return FALSE;
+	}
+
+	if ((G_IO_STATUS_EOF == status) || (G_IO_STATUS_ERROR == status)) {
+		if (channel == job->output) {
+			job->outputWatch = 0;
+			spawn_channel_close (&job->output, &job->outputWatch);
+		} else {
+			job->errorsWatch = 0;
+			spawn_channel_close (&job->errors, &job->errorsWatch);
+		}
+		spawn_check_finished (job);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+spawn_child_cb (GPid pid, gint status, gpointer user_data)
+{
+	spawnJobPtr	job = (spawnJobPtr)user_data;
+
+	job->childWatch = 0;
+	job->exited = TRUE;
+	job->status = status;
+	g_spawn_close_pid (pid);
+
+	spawn_check_finished (job);
+}
+
+static gboolean
+spawn_timeout_cb (gpointer user_data)
+{
+	spawnJobPtr	job = (spawnJobPtr)user_data;
+
+	job->timeoutId = 0;
+	spawn_abort (job, g_strdup_printf (_("%s did not finish within %u seconds"), job->command, job->timeout));
+
+	return FALSE;
+}
+
+static void
+spawn_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+{
+	spawnJobPtr	job = (spawnJobPtr)user_data;
+
+	/* disconnecting from within the handler would dead-lock */
+	job->cancelledId = 0;
+	spawn_abort (job, g_strdup_printf (_("%s was cancelled"), job->command));
+}
+
+static gboolean
+spawn_failed_idle_cb (gpointer user_data)
+{
+	spawn_finish ((spawnJobPtr)user_data);
+
+	return FALSE;
+}
+
+void
+spawn_command (const gchar *command, const gchar *input, gsize inputLength,
+               guint timeout, gsize maxOutput, GCancellable *cancellable,
+               spawnResultFunc callback, gpointer user_data)
+{
+	spawnJobPtr	job;
+	gchar		*argv[] = { "/bin/sh", "-c", NULL, NULL };
+	gint		inFd, outFd, errFd;
+	GError		*error = NULL;
+	static gboolean	sigpipeIgnored = FALSE;
+
+	g_assert (NULL != callback);
+
+	/* Writing to a command that does not read all its
+	   input must not terminate us */
+	if (!sigpipeIgnored) {
+		signal (SIGPIPE, SIG_IGN);
+		sigpipeIgnored = TRUE;
+	}
+
+	job = g_new0 (struct spawnJob, 1);
+	job->command = g_strdup (command);
+	job->inputData = input;
+	job->inputLength = input?inputLength:0;
+	job->out = g_string_new (NULL);
+	job->err = g_string_new (NULL);
+	job->maxOutput = maxOutput;
+	job->timeout = timeout;
+	job->callback = callback;
+	job->user_data = user_data;
+	if (cancellable)
+		job->cancellable = g_object_ref (cancellable);
+
+	debug1 (DEBUG_UPDATE, "executing command \"%s\"...", command);
+
+	argv[2] = job->command;
+	if (g_cancellable_set_error_if_cancelled (cancellable, &error) ||
+	    !g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+	                               spawn_child_setup, NULL, &job->pid,
+	                               input?&inFd:NULL, &outFd, &errFd, &error)) {
+		job->failure = g_strdup_printf (_("Error: Could not execute \"%s\" (%s)"), command, error->message);
+		g_error_free (error);
+		job->exited = TRUE;
+		job->status = -1;
+		g_idle_add (spawn_failed_idle_cb, job);
+		return;
+	}
+
+	if (input) {
+		job->input = spawn_channel_new (inFd);
+		job->inputWatch = g_io_add_watch (job->input, G_IO_OUT | G_IO_ERR | G_IO_HUP, spawn_write_cb, job);
+	}
+	job->output = spawn_channel_new (outFd);
+	job->outputWatch = g_io_add_watch (job->output, G_IO_IN | G_IO_ERR | G_IO_HUP, spawn_read_cb, job);
+	job->errors = spawn_channel_new (errFd);
+	job->errorsWatch = g_io_add_watch (job->errors, G_IO_IN | G_IO_ERR | G_IO_HUP, spawn_read_cb, job);
+	job->childWatch = g_child_watch_add (job->pid, spawn_child_cb, job);
+
+	if (timeout)
+		job->timeoutId = g_timeout_add_seconds (timeout, spawn_timeout_cb, job);
+	if (cancellable)
+		job->cancelledId = g_cancellable_connect (cancellable, G_CALLBACK (spawn_cancelled_cb), job, NULL);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file spawn.h  asynchronous command execution
+ *
+ * Copyright (C) 2011 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _SPAWN_H
+#define _SPAWN_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/* Commands (subscription sources starting with '|' and post
+   processing filters) are run by a shell in a child process.
+   Input and output are passed through non-blocking pipes which
+   are serviced by the main loop, so no temporary files are needed
+   and the GUI is never blocked. Each command is killed when it
+   exceeds its run time, produces more output than allowed or
+   when it is cancelled. */
+
+/** result of a command execution */
+typedef struct spawnResult {
+	gchar		*data;		/**< standard output of the command (never NULL) */
+	gsize		size;		/**< length of the standard output */
+	gchar		*errors;	/**< standard error output of the command (or NULL) */
+	gint		exitStatus;	/**< exit status (-1 if the command did not exit normally) */
+	gboolean	success;	/**< TRUE if the command completed with exit status 0 */
+	gchar		*failure;	/**< error description if not successful (or NULL) */
+} *spawnResultPtr;
+
+/**
+ * Command result callback. It is called from the main loop.
+ * The callback can take over the output buffer by setting
+ * result->data to NULL, all other result data is free'd
+ * after the callback returns.
+ *
+ * @param result	the command result
+ * @param user_data	user data passed to spawn_command()
+ */
+typedef void (*spawnResultFunc) (spawnResultPtr result, gpointer user_data);
+
+/**
+ * Runs the given command line asynchronously using a shell.
+ * The callback is always called, also if the command could
+ * not be started.
+ *
+ * @param command	the command line
+ * @param input		data to pass to standard input (or NULL for none),
+ *			must be valid until the callback is called
+ * @param inputLength	length of the input data
+ * @param timeout	maximum run time in seconds (0 for no limit)
+ * @param maxOutput	maximum number of bytes accepted on each of
+ *			standard output and standard error
+ * @param cancellable	kills the command when cancelled (or NULL)
+ * @param callback	result callback
+ * @param user_data	result callback user data
+ */
+void spawn_command (const gchar *command, const gchar *input, gsize inputLength,
+                    guint timeout, gsize maxOutput, GCancellable *cancellable,
+                    spawnResultFunc callback, gpointer user_data);
+
+#endif
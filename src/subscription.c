@@ -30,6 +30,7 @@
 #include "feedlist.h"
 #include "metadata.h"
 #include "net.h"
+#include "update_scheduler.h"
 #include "ui/auth_dialog.h"
 #include "ui/itemview.h"
 #include "ui/liferea_shell.h"
@@ -39,6 +40,15 @@
 #define FEED_PROTOCOL_PREFIX "feed://"
 #define FEED_PROTOCOL_PREFIX2 "feed:"
 
+/* Limits of the adaptive update interval (in minutes) */
+#define ADAPTIVE_MIN_INTERVAL		10
+#define ADAPTIVE_MAX_INTERVAL		1440
+
+/* Number of updates without new items before backing off
+   and the maximum backoff (as power of two) */
+#define ADAPTIVE_UNCHANGED_THRESHOLD	3
+#define ADAPTIVE_MAX_BACKOFF		4
+
 subscriptionPtr
 subscription_new (const gchar *source,
                   const gchar *filter,
@@ -125,6 +135,7 @@ subscription_reset_update_counter (subscriptionPtr subscription, GTimeVal *now)
 		
 	subscription->updateState->lastPoll.tv_sec = now->tv_sec;
 	debug1 (DEBUG_UPDATE, "Resetting last poll counter to %ld.", subscription->updateState->lastPoll.tv_sec);
+	update_scheduler_schedule (subscription);
 }
 
 static void
@@ -218,6 +229,7 @@ subscription_process_update_result (const struct updateResult * const result, gp
 		liferea_shell_set_status_bar (_("\"%s\" is discontinued. Liferea won't updated it anymore!"), node_get_title (node));
 	} else if (304 == result->httpstatus) {
 		node->available = TRUE;
+		subscription_record_new_items (subscription, 0);
 		liferea_shell_set_status_bar (_("\"%s\" has not changed since last update"), node_get_title(node));
 	} else {
 		processing = TRUE;
@@ -239,9 +251,16 @@ subscription_process_update_result (const struct updateResult * const result, gp
 	
 	/* 4. generic postprocessing */
 
-	update_state_set_lastmodified (subscription->updateState, update_state_get_lastmodified (result->updateState));
+	/* A 304 response does not necessarily repeat the validators,
+	   so keep the ones we sent unless we got new ones. */
+	if (304 != result->httpstatus || update_state_get_lastmodified (result->updateState))
+		update_state_set_lastmodified (subscription->updateState, update_state_get_lastmodified (result->updateState));
+	if (304 != result->httpstatus || update_state_get_etag (result->updateState))
+		update_state_set_etag (subscription->updateState, update_state_get_etag (result->updateState));
 	update_state_set_cookies (subscription->updateState, update_state_get_cookies (result->updateState));
+	subscription->updateState->maxAge = update_state_get_max_age (result->updateState);
 	g_get_current_time (&subscription->updateState->lastPoll);
+	update_scheduler_schedule (subscription);
 	
 	itemview_update_node_info (subscription->node);
 	itemview_update ();
@@ -290,18 +309,15 @@ subscription_update (subscriptionPtr subscription, guint flags)
 void
 subscription_auto_update (subscriptionPtr subscription)
 {
-	gint		interval;
+	guint		interval;
 	guint		flags = 0;
 	GTimeVal	now;
 	
 	if (!subscription)
 		return;
 
-	interval = subscription_get_update_interval (subscription);
-	if (-1 == interval)
-		conf_get_int_value (DEFAULT_UPDATE_INTERVAL, &interval);
-			
-	if (-2 >= interval || 0 == interval)
+	interval = subscription_get_auto_update_interval (subscription, NULL);
+	if (0 == interval)
 		return;		/* don't update this subscription */
 		
 	g_get_current_time (&now);
@@ -310,6 +326,107 @@ subscription_auto_update (subscriptionPtr subscription)
 		subscription_update (subscription, flags);
 }
 
+void
+subscription_record_new_items (subscriptionPtr subscription, guint newCount)
+{
+	updateStatePtr	state = subscription->updateState;
+	GTimeVal	now;
+	glong		sample;
+
+	if (0 == newCount) {
+		state->unchangedCount++;
+		return;
+	}
+
+	g_get_current_time (&now);
+	if (state->lastArrival > 0 && now.tv_sec > state->lastArrival) {
+		/* Smooth the arrival interval, weighting the latest sample by 1/4 */
+		sample = (now.tv_sec - state->lastArrival) / newCount;
+		if (state->arrivalInterval > 0)
+			state->arrivalInterval = (3 * state->arrivalInterval + sample) / 4;
+		else
+			state->arrivalInterval = sample;
+	}
+	state->lastArrival = now.tv_sec;
+	state->unchangedCount = 0;
+
+	debug3 (DEBUG_UPDATE, "\"%s\" got %u new items, arrival interval is now %ld s", node_get_title (subscription->node), newCount, state->arrivalInterval);
+}
+
+guint
+subscription_get_auto_update_interval (subscriptionPtr subscription, gchar **reason)
+{
+	updateStatePtr	state = subscription->updateState;
+	gint		interval, globalInterval, feedInterval, maxInterval;
+	glong		maxAge;
+	gboolean	adaptive = FALSE;
+	gchar		*tmp = NULL;
+
+	if (reason)
+		*reason = NULL;
+
+	interval = subscription_get_update_interval (subscription);
+	if (-1 != interval)
+		return (interval > 0)?interval:0;
+
+	conf_get_int_value (DEFAULT_UPDATE_INTERVAL, &globalInterval);
+	conf_get_bool_value (ADAPTIVE_UPDATE, &adaptive);
+	if (globalInterval <= 0)
+		return 0;
+	if (!adaptive)
+		return globalInterval;
+
+	/* 1. Poll about twice per expected item arrival */
+	if (state->arrivalInterval > 0) {
+		interval = state->arrivalInterval / 120;
+		tmp = g_strdup_printf (ngettext ("New items arrive about every %ld minute.",
+		                                 "New items arrive about every %ld minutes.",
+		                                 state->arrivalInterval / 60), state->arrivalInterval / 60);
+	} else {
+		interval = globalInterval;
+		tmp = g_strdup (_("There is no item arrival history yet, so the default interval is used."));
+	}
+
+	/* 2. Back off exponentially while the feed does not change */
+	if (state->unchangedCount > ADAPTIVE_UNCHANGED_THRESHOLD) {
+		interval <<= MIN (state->unchangedCount - ADAPTIVE_UNCHANGED_THRESHOLD, ADAPTIVE_MAX_BACKOFF);
+		g_free (tmp);
+		tmp = g_strdup_printf (ngettext ("The feed had no new items in the last %u update.",
+		                                 "The feed had no new items in the last %u updates.",
+		                                 state->unchangedCount), state->unchangedCount);
+	}
+
+	maxInterval = MAX (ADAPTIVE_MAX_INTERVAL, globalInterval);
+	interval = CLAMP (interval, ADAPTIVE_MIN_INTERVAL, maxInterval);
+
+	/* 3. Never poll more often than the feed (syn:updatePeriod, <ttl>)
+	      or the server (Cache-Control max-age, Expires) asks for */
+	feedInterval = subscription_get_default_update_interval (subscription);
+	if (feedInterval > interval) {
+		interval = MIN (feedInterval, maxInterval);
+		g_free (tmp);
+		tmp = g_strdup_printf (ngettext ("The feed asks to be updated at most every %d minute.",
+		                                 "The feed asks to be updated at most every %d minutes.",
+		                                 feedInterval), feedInterval);
+	}
+
+	maxAge = (state->maxAge + 59) / 60;
+	if (maxAge > interval) {
+		interval = MIN (maxAge, maxInterval);
+		g_free (tmp);
+		tmp = g_strdup_printf (ngettext ("The server says the feed does not change for %ld minute.",
+		                                 "The server says the feed does not change for %ld minutes.",
+		                                 maxAge), maxAge);
+	}
+
+	if (reason)
+		*reason = tmp;
+	else
+		g_free (tmp);
+
+	return interval;
+}
+
 void
 subscription_cancel_update (subscriptionPtr subscription)
 {
@@ -338,6 +455,7 @@ subscription_set_update_interval (subscriptionPtr subscription, gint interval)
 				   interval... */
 	}
 	subscription->updateInterval = interval;
+	update_scheduler_schedule (subscription);
 	feedlist_schedule_save ();
 }
 
@@ -560,6 +678,8 @@ subscription_free (subscriptionPtr subscription)
 	if (!subscription)
 		return;
 		
+	update_scheduler_remove (subscription);
+
 	g_free (subscription->updateError);
 	g_free (subscription->filterError);
 	g_free (subscription->httpError);
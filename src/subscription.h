@@ -52,7 +52,7 @@ typedef struct subscription {
 	gint		updateInterval;		/**< user defined update interval in minutes */	
 	guint		defaultInterval;	/**< optional update interval as specified by the feed in minutes */
 	
-	GSList		*metadata;		/**< metadata list assigned to this subscription */
+	struct metadataList *metadata;		/**< metadata list assigned to this subscription */
 	
 	gchar		*updateError;		/**< textual description of processing errors */
 	gchar		*httpError;		/**< textual description of HTTP protocol errors */
@@ -145,6 +145,31 @@ void subscription_update (subscriptionPtr subscription, guint flags);
  */
 void subscription_auto_update (subscriptionPtr subscription);
 
+/**
+ * Returns the interval the subscription is automatically updated
+ * with. This is the user defined interval or the global default.
+ * When adaptive updating is enabled subscriptions using the global
+ * default get an interval based on the arrival of new items, on how
+ * often they did not change and on the update hints given by the
+ * feed and the server.
+ *
+ * @param subscription	the subscription
+ * @param reason	returns a description of the adaptive interval
+ *			or NULL if it was not used (optional, to be free'd)
+ *
+ * @returns the interval in minutes (0 for never updating)
+ */
+guint subscription_get_auto_update_interval (subscriptionPtr subscription, gchar **reason);
+
+/**
+ * Records the number of new items found by an update
+ * (0 for unchanged feeds) for the adaptive update interval.
+ *
+ * @param subscription	the subscription
+ * @param newCount	number of new items
+ */
+void subscription_record_new_items (subscriptionPtr subscription, guint newCount);
+
 /**
  * Cancels a currently running subscription update. This is to
  * be called when removing subscriptions or retriggering the update
@@ -221,7 +221,7 @@ enclosure_list_view_get_widget (EnclosureListView *elv)
 void
 enclosure_list_view_load (EnclosureListView *elv, itemPtr item)
 {
-	GSList		*list;
+	GSList		*list, *values;
 	guint		len;
 
 	/* cleanup old content */
@@ -235,7 +235,7 @@ enclosure_list_view_load (EnclosureListView *elv, itemPtr item)
 	elv->priv->enclosures = NULL;	
 	
 	/* decide visibility of the list */
-	list = metadata_list_get_values (item->metadata, "enclosure");
+	list = values = metadata_list_get_values (item->metadata, "enclosure");
 	len = g_slist_length (list);
 	if (len == 0) {
 		enclosure_list_view_hide (elv);
@@ -296,6 +296,7 @@ enclosure_list_view_load (EnclosureListView *elv, itemPtr item)
 		
 		list = list->next;
 	}
+	g_slist_free (values);
 }
 
 void
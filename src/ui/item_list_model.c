@@ -0,0 +1,800 @@
+/**
+ * @file item_list_model.c  lazy loading item list GtkTreeModel
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ui/item_list_model.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "date.h"
+#include "db.h"
+#include "debug.h"
+#include "node.h"
+#include "node_view.h"
+#include "ui/icons.h"
+
+#define ITEM_LIST_MODEL_PAGE_SIZE	64	/**< number of rows loaded from the DB at once */
+#define ITEM_LIST_MODEL_MAX_ROWS	2048	/**< number of cached rows that causes the cache to be dropped */
+
+/** cached column values of a single row */
+typedef struct itemListModelRow {
+	guint64		time;		/**< item date */
+	gchar		*timeStr;	/**< formatted item date */
+	gchar		*label;		/**< displayed title */
+	nodePtr		node;		/**< the item's node (or NULL) */
+	gboolean	readStatus;	/**< TRUE if the item is read */
+	gboolean	flagStatus;	/**< TRUE if the item is flagged */
+	gboolean	hasEnclosure;	/**< TRUE if the item has enclosures */
+	gfloat		align;		/**< title alignment */
+} *itemListModelRowPtr;
+
+#define ITEM_LIST_MODEL_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), ITEM_LIST_MODEL_TYPE, ItemListModelPrivate))
+
+struct ItemListModelPrivate {
+	gint		stamp;		/**< iter stamp of this model */
+
+	GArray		*ids;		/**< item ids (gulong) in display order */
+	GHashTable	*positions;	/**< item id -> position + 1 (positions valid only if not positionsDirty) */
+	gboolean	positionsDirty;	/**< TRUE if the positions need to be recalculated */
+
+	GHashTable	*rows;		/**< item id -> itemListModelRowPtr, cache of loaded rows */
+
+	gint		sortColumn;	/**< current sort column */
+	GtkSortType	sortOrder;	/**< current sort order */
+	gboolean	sorted;		/**< FALSE if items were added since the last sort */
+	guint		sortIdleId;	/**< idle source of a pending sort (or 0) */
+};
+
+static GType column_types[ITEMSTORE_LEN];
+
+static void item_list_model_tree_model_init (GtkTreeModelIface *iface);
+static void item_list_model_tree_sortable_init (GtkTreeSortableIface *iface);
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE_WITH_CODE (ItemListModel, item_list_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL, item_list_model_tree_model_init)
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_SORTABLE, item_list_model_tree_sortable_init));
+
+static void
+item_list_model_row_free (gpointer data)
+{
+	itemListModelRowPtr row = (itemListModelRowPtr)data;
+
+	g_free (row->timeStr);
+	g_free (row->label);
+	g_free (row);
+}
+
+static void
+item_list_model_finalize (GObject *object)
+{
+	ItemListModelPrivate *priv = ITEM_LIST_MODEL_GET_PRIVATE (object);
+
+	if (priv->sortIdleId)
+		g_source_remove (priv->sortIdleId);
+	g_array_free (priv->ids, TRUE);
+	g_hash_table_destroy (priv->positions);
+	g_hash_table_destroy (priv->rows);
+
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+item_list_model_class_init (ItemListModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	parent_class = g_type_class_peek_parent (klass);
+
+	object_class->finalize = item_list_model_finalize;
+
+	g_type_class_add_private (object_class, sizeof(ItemListModelPrivate));
+
+	column_types[IS_TIME]		= G_TYPE_UINT64;
+	column_types[IS_TIME_STR]	= G_TYPE_STRING;
+	column_types[IS_LABEL]		= G_TYPE_STRING;
+	column_types[IS_STATEICON]	= GDK_TYPE_PIXBUF;
+	column_types[IS_NR]		= G_TYPE_ULONG;
+	column_types[IS_PARENT]		= G_TYPE_POINTER;
+	column_types[IS_FAVICON]	= GDK_TYPE_PIXBUF;
+	column_types[IS_ENCICON]	= GDK_TYPE_PIXBUF;
+	column_types[IS_ENCLOSURE]	= G_TYPE_BOOLEAN;
+	column_types[IS_SOURCE]		= G_TYPE_POINTER;
+	column_types[IS_STATE]		= G_TYPE_UINT;
+	column_types[ITEMSTORE_UNREAD]	= G_TYPE_INT;
+	column_types[ITEMSTORE_ALIGN]	= G_TYPE_FLOAT;
+}
+
+static void
+item_list_model_init (ItemListModel *ilm)
+{
+	ilm->priv = ITEM_LIST_MODEL_GET_PRIVATE (ilm);
+	ilm->priv->stamp = g_random_int ();
+	ilm->priv->ids = g_array_new (FALSE, FALSE, sizeof (gulong));
+	ilm->priv->positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+	ilm->priv->rows = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, item_list_model_row_free);
+	ilm->priv->sortColumn = IS_TIME;
+	ilm->priv->sortOrder = GTK_SORT_DESCENDING;
+	ilm->priv->sorted = TRUE;
+}
+
+ItemListModel *
+item_list_model_new (void)
+{
+	return ITEM_LIST_MODEL (g_object_new (ITEM_LIST_MODEL_TYPE, NULL));
+}
+
+/* position handling */
+
+static void
+item_list_model_update_positions (ItemListModel *ilm)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	guint			i;
+
+	if (!priv->positionsDirty)
+		return;
+
+	for (i = 0; i < priv->ids->len; i++)
+		g_hash_table_insert (priv->positions, GUINT_TO_POINTER (g_array_index (priv->ids, gulong, i)), GINT_TO_POINTER (i + 1));
+
+	priv->positionsDirty = FALSE;
+}
+
+/* Returns the position of the given id or -1. The iter position
+   hint is checked first as it is valid unless rows were removed
+   or reordered since the iter was created. */
+static gint
+item_list_model_get_position (ItemListModel *ilm, gulong id, gint hint)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	gint			pos;
+
+	if ((hint >= 0) && ((guint)hint < priv->ids->len) && (g_array_index (priv->ids, gulong, hint) == id))
+		return hint;
+
+	item_list_model_update_positions (ilm);
+
+	pos = GPOINTER_TO_INT (g_hash_table_lookup (priv->positions, GUINT_TO_POINTER (id))) - 1;
+	if ((pos < 0) || ((guint)pos >= priv->ids->len) || (g_array_index (priv->ids, gulong, pos) != id))
+		return -1;
+
+	return pos;
+}
+
+static void
+item_list_model_set_iter (ItemListModel *ilm, GtkTreeIter *iter, gint pos)
+{
+	iter->stamp = ilm->priv->stamp;
+	iter->user_data = GUINT_TO_POINTER (g_array_index (ilm->priv->ids, gulong, pos));
+	iter->user_data2 = GINT_TO_POINTER (pos);
+	iter->user_data3 = NULL;
+}
+
+static gint
+item_list_model_iter_position (ItemListModel *ilm, GtkTreeIter *iter)
+{
+	g_return_val_if_fail (iter->stamp == ilm->priv->stamp, -1);
+
+	return item_list_model_get_position (ilm, GPOINTER_TO_UINT (iter->user_data), GPOINTER_TO_INT (iter->user_data2));
+}
+
+/* row cache */
+
+static gfloat
+item_list_model_title_alignment (const gchar *title)
+{
+	int txt_direction, app_direction;
+
+	if (!title || strlen(title) == 0)
+		return 0.;
+
+	txt_direction = pango_find_base_dir (title, -1);
+	app_direction = gtk_widget_get_default_direction ();
+	if ((txt_direction == PANGO_DIRECTION_LTR &&
+	     app_direction == GTK_TEXT_DIR_LTR) ||
+	    (txt_direction == PANGO_DIRECTION_RTL &&
+	     app_direction == GTK_TEXT_DIR_RTL))
+		return 0.; /* same direction, regular ("left") alignment */
+	else
+		return 1.;
+}
+
+static itemListModelRowPtr
+item_list_model_row_new (const gchar *title, gint64 time, const gchar *nodeId,
+                         gboolean readStatus, gboolean flagStatus, gboolean hasEnclosure)
+{
+	itemListModelRowPtr row = g_new0 (struct itemListModelRow, 1);
+
+	row->time = (guint64)time;
+	row->timeStr = (0 != time) ? date_format ((time_t)time, NULL) : g_strdup ("");
+	row->label = g_strstrip (g_strdup ((title && strlen (title)) ? title : _("*** No title ***")));
+	row->node = nodeId?node_from_id (nodeId):NULL;
+	row->readStatus = readStatus;
+	row->flagStatus = flagStatus;
+	row->hasEnclosure = hasEnclosure;
+	row->align = item_list_model_title_alignment (row->label);
+
+	return row;
+}
+
+/* Returns the cached row at the given position. On a cache
+   miss the following page of uncached rows is loaded at once,
+   as the tree view asks for the rows in display order. */
+static itemListModelRowPtr
+item_list_model_get_row (ItemListModel *ilm, gint pos)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	itemListModelRowPtr	row;
+	gulong			id, ids[ITEM_LIST_MODEL_PAGE_SIZE];
+	GSList			*rows, *iter;
+	guint			i, count = 0;
+
+	id = g_array_index (priv->ids, gulong, pos);
+	row = g_hash_table_lookup (priv->rows, GUINT_TO_POINTER (id));
+	if (row)
+		return row;
+
+	if (g_hash_table_size (priv->rows) >= ITEM_LIST_MODEL_MAX_ROWS)
+		g_hash_table_remove_all (priv->rows);
+
+	for (i = pos; (i < priv->ids->len) && (count < ITEM_LIST_MODEL_PAGE_SIZE); i++) {
+		gulong next = g_array_index (priv->ids, gulong, i);
+		if (!g_hash_table_lookup (priv->rows, GUINT_TO_POINTER (next)))
+			ids[count++] = next;
+	}
+
+	debug2 (DEBUG_GUI, "item list model: loading %u rows at position %d", count, pos);
+
+	rows = db_item_list_rows_load (ids, count);
+	for (iter = rows; iter; iter = g_slist_next (iter)) {
+		itemListRowPtr dbRow = (itemListRowPtr)iter->data;
+
+		g_hash_table_insert (priv->rows, GUINT_TO_POINTER (dbRow->id),
+		                     item_list_model_row_new (dbRow->title, dbRow->time, dbRow->nodeId,
+		                                              dbRow->readStatus, dbRow->flagStatus, dbRow->hasEnclosure));
+		db_item_list_row_free (dbRow);
+	}
+	g_slist_free (rows);
+
+	/* Items removed from the DB in the meantime get an empty
+	   row to avoid querying them again and again */
+	for (i = 0; i < count; i++) {
+		if (!g_hash_table_lookup (priv->rows, GUINT_TO_POINTER (ids[i])))
+			g_hash_table_insert (priv->rows, GUINT_TO_POINTER (ids[i]),
+			                     item_list_model_row_new (NULL, 0, NULL, TRUE, FALSE, FALSE));
+	}
+
+	return g_hash_table_lookup (priv->rows, GUINT_TO_POINTER (id));
+}
+
+/* GtkTreeModel implementation */
+
+static GtkTreeModelFlags
+item_list_model_get_flags (GtkTreeModel *model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+item_list_model_get_n_columns (GtkTreeModel *model)
+{
+	return ITEMSTORE_LEN;
+}
+
+static GType
+item_list_model_get_column_type (GtkTreeModel *model, gint index)
+{
+	g_return_val_if_fail ((index >= 0) && (index < ITEMSTORE_LEN), G_TYPE_INVALID);
+
+	return column_types[index];
+}
+
+static gboolean
+item_list_model_get_iter (GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	ItemListModel	*ilm = ITEM_LIST_MODEL (model);
+	gint		pos;
+
+	if (gtk_tree_path_get_depth (path) != 1)
+		return FALSE;
+
+	pos = gtk_tree_path_get_indices (path)[0];
+	if ((pos < 0) || ((guint)pos >= ilm->priv->ids->len))
+		return FALSE;
+
+	item_list_model_set_iter (ilm, iter, pos);
+	return TRUE;
+}
+
+static GtkTreePath *
+item_list_model_get_path (GtkTreeModel *model, GtkTreeIter *iter)
+{
+	gint	pos;
+
+	pos = item_list_model_iter_position (ITEM_LIST_MODEL (model), iter);
+	if (pos < 0)
+		return NULL;
+
+	return gtk_tree_path_new_from_indices (pos, -1);
+}
+
+static void
+item_list_model_get_value (GtkTreeModel *model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	ItemListModel		*ilm = ITEM_LIST_MODEL (model);
+	itemListModelRowPtr	row;
+	gint			pos;
+
+	g_return_if_fail ((column >= 0) && (column < ITEMSTORE_LEN));
+
+	g_value_init (value, column_types[column]);
+
+	if (IS_NR == column) {
+		g_value_set_ulong (value, GPOINTER_TO_UINT (iter->user_data));
+		return;
+	}
+
+	pos = item_list_model_iter_position (ilm, iter);
+	if (pos < 0)
+		return;
+
+	row = item_list_model_get_row (ilm, pos);
+	switch (column) {
+		case IS_TIME:
+			g_value_set_uint64 (value, row->time);
+			break;
+		case IS_TIME_STR:
+			g_value_set_string (value, row->timeStr);
+			break;
+		case IS_LABEL:
+			g_value_set_string (value, row->label);
+			break;
+		case IS_STATEICON:
+			g_value_set_object (value, row->flagStatus ? (gpointer)icon_get (ICON_FLAG) :
+			                           !row->readStatus ? (gpointer)icon_get (ICON_UNREAD) :
+			                           NULL);
+			break;
+		case IS_PARENT:
+		case IS_SOURCE:
+			g_value_set_pointer (value, row->node);
+			break;
+		case IS_FAVICON:
+			g_value_set_object (value, row->node?row->node->icon:NULL);
+			break;
+		case IS_ENCICON:
+			g_value_set_object (value, row->hasEnclosure?(gpointer)icon_get (ICON_ENCLOSURE):NULL);
+			break;
+		case IS_ENCLOSURE:
+			g_value_set_boolean (value, row->hasEnclosure);
+			break;
+		case IS_STATE:
+			g_value_set_uint (value, (row->flagStatus?2:0) + (row->readStatus?0:1));
+			break;
+		case ITEMSTORE_UNREAD:
+			g_value_set_int (value, row->readStatus ? PANGO_WEIGHT_NORMAL : PANGO_WEIGHT_BOLD);
+			break;
+		case ITEMSTORE_ALIGN:
+			g_value_set_float (value, row->align);
+			break;
+	}
+}
+
+static gboolean
+item_list_model_iter_next (GtkTreeModel *model, GtkTreeIter *iter)
+{
+	ItemListModel	*ilm = ITEM_LIST_MODEL (model);
+	gint		pos;
+
+	pos = item_list_model_iter_position (ilm, iter);
+	if ((pos < 0) || ((guint)pos + 1 >= ilm->priv->ids->len))
+		return FALSE;
+
+	item_list_model_set_iter (ilm, iter, pos + 1);
+	return TRUE;
+}
+
+static gboolean
+item_list_model_iter_nth_child (GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	ItemListModel	*ilm = ITEM_LIST_MODEL (model);
+
+	if (parent || (n < 0) || ((guint)n >= ilm->priv->ids->len))
+		return FALSE;
+
+	item_list_model_set_iter (ilm, iter, n);
+	return TRUE;
+}
+
+static gboolean
+item_list_model_iter_children (GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	return item_list_model_iter_nth_child (model, iter, parent, 0);
+}
+
+static gboolean
+item_list_model_iter_has_child (GtkTreeModel *model, GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint
+item_list_model_iter_n_children (GtkTreeModel *model, GtkTreeIter *iter)
+{
+	if (iter)
+		return 0;
+
+	return ITEM_LIST_MODEL (model)->priv->ids->len;
+}
+
+static gboolean
+item_list_model_iter_parent (GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	return FALSE;
+}
+
+static void
+item_list_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = item_list_model_get_flags;
+	iface->get_n_columns = item_list_model_get_n_columns;
+	iface->get_column_type = item_list_model_get_column_type;
+	iface->get_iter = item_list_model_get_iter;
+	iface->get_path = item_list_model_get_path;
+	iface->get_value = item_list_model_get_value;
+	iface->iter_next = item_list_model_iter_next;
+	iface->iter_children = item_list_model_iter_children;
+	iface->iter_has_child = item_list_model_iter_has_child;
+	iface->iter_n_children = item_list_model_iter_n_children;
+	iface->iter_nth_child = item_list_model_iter_nth_child;
+	iface->iter_parent = item_list_model_iter_parent;
+}
+
+/* sorting */
+
+static nodeViewSortType
+item_list_model_get_sort_type (gint sortColumn)
+{
+	switch (sortColumn) {
+		case IS_LABEL:
+			return NODE_VIEW_SORT_BY_TITLE;
+		case IS_STATE:
+			return NODE_VIEW_SORT_BY_STATE;
+		case IS_PARENT:
+		case IS_SOURCE:
+			return NODE_VIEW_SORT_BY_PARENT;
+		case IS_TIME:
+		default:
+			return NODE_VIEW_SORT_BY_TIME;
+	}
+}
+
+void
+item_list_model_sort (ItemListModel *ilm)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	GArray			*sorted;
+	GtkTreePath		*path;
+	gulong			*ids;
+	gint			*newOrder;
+	gboolean		*placed, changed = FALSE;
+	guint			i, n = 0, len = priv->ids->len;
+
+	if (priv->sortIdleId)
+		g_source_remove (priv->sortIdleId);
+	priv->sortIdleId = 0;
+	priv->sorted = TRUE;
+
+	if (len < 2)
+		return;
+
+	sorted = db_item_list_sort (priv->ids, item_list_model_get_sort_type (priv->sortColumn),
+	                            GTK_SORT_DESCENDING == priv->sortOrder);
+
+	item_list_model_update_positions (ilm);
+
+	/* new_order[new position] = old position, items
+	   not found in the DB keep their relative order
+	   at the end of the list */
+	newOrder = g_new (gint, len);
+	placed = g_new0 (gboolean, len);
+	for (i = 0; i < sorted->len; i++) {
+		gint pos = GPOINTER_TO_INT (g_hash_table_lookup (priv->positions, GUINT_TO_POINTER (g_array_index (sorted, gulong, i)))) - 1;
+		if ((pos < 0) || placed[pos])
+			continue;
+		placed[pos] = TRUE;
+		newOrder[n++] = pos;
+	}
+	for (i = 0; i < len; i++) {
+		if (!placed[i])
+			newOrder[n++] = i;
+	}
+	g_array_free (sorted, TRUE);
+	g_free (placed);
+
+	ids = g_new (gulong, len);
+	for (i = 0; i < len; i++) {
+		ids[i] = g_array_index (priv->ids, gulong, newOrder[i]);
+		if ((guint)newOrder[i] != i)
+			changed = TRUE;
+	}
+
+	if (changed) {
+		memcpy (priv->ids->data, ids, len * sizeof (gulong));
+		priv->positionsDirty = TRUE;
+		item_list_model_update_positions (ilm);
+
+		path = gtk_tree_path_new ();
+		gtk_tree_model_rows_reordered (GTK_TREE_MODEL (ilm), path, NULL, newOrder);
+		gtk_tree_path_free (path);
+	}
+
+	g_free (ids);
+	g_free (newOrder);
+}
+
+static gboolean
+item_list_model_sort_idle_cb (gpointer user_data)
+{
+	ItemListModel *ilm = ITEM_LIST_MODEL (user_data);
+
+	ilm->priv->sortIdleId = 0;
+	item_list_model_sort (ilm);
+
+	return FALSE;
+}
+
+static gboolean
+item_list_model_get_sort_column_id (GtkTreeSortable *sortable, gint *sort_column_id, GtkSortType *order)
+{
+	ItemListModelPrivate *priv = ITEM_LIST_MODEL (sortable)->priv;
+
+	if (sort_column_id)
+		*sort_column_id = priv->sortColumn;
+	if (order)
+		*order = priv->sortOrder;
+
+	return TRUE;
+}
+
+static void
+item_list_model_set_sort_column_id (GtkTreeSortable *sortable, gint sort_column_id, GtkSortType order)
+{
+	ItemListModel	*ilm = ITEM_LIST_MODEL (sortable);
+	gboolean	changed;
+
+	changed = (ilm->priv->sortColumn != sort_column_id) || (ilm->priv->sortOrder != order);
+	if (!changed && ilm->priv->sorted)
+		return;
+
+	ilm->priv->sortColumn = sort_column_id;
+	ilm->priv->sortOrder = order;
+	item_list_model_sort (ilm);
+
+	if (changed)
+		gtk_tree_sortable_sort_column_changed (sortable);
+}
+
+static void
+item_list_model_set_sort_func (GtkTreeSortable *sortable, gint sort_column_id,
+                               GtkTreeIterCompareFunc func, gpointer data, GDestroyNotify destroy)
+{
+	/* Sorting is done by the DB only */
+}
+
+static void
+item_list_model_set_default_sort_func (GtkTreeSortable *sortable,
+                                       GtkTreeIterCompareFunc func, gpointer data, GDestroyNotify destroy)
+{
+	/* Sorting is done by the DB only */
+}
+
+static gboolean
+item_list_model_has_default_sort_func (GtkTreeSortable *sortable)
+{
+	return FALSE;
+}
+
+static void
+item_list_model_tree_sortable_init (GtkTreeSortableIface *iface)
+{
+	iface->get_sort_column_id = item_list_model_get_sort_column_id;
+	iface->set_sort_column_id = item_list_model_set_sort_column_id;
+	iface->set_sort_func = item_list_model_set_sort_func;
+	iface->set_default_sort_func = item_list_model_set_default_sort_func;
+	iface->has_default_sort_func = item_list_model_has_default_sort_func;
+}
+
+/* item handling */
+
+void
+item_list_model_add (ItemListModel *ilm, gulong id)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	GtkTreeIter		iter;
+	GtkTreePath		*path;
+	gint			pos;
+
+	if (item_list_model_contains (ilm, id))
+		return;
+
+	pos = priv->ids->len;
+	g_array_append_val (priv->ids, id);
+	g_hash_table_insert (priv->positions, GUINT_TO_POINTER (id), GINT_TO_POINTER (pos + 1));
+
+	item_list_model_set_iter (ilm, &iter, pos);
+	path = gtk_tree_path_new_from_indices (pos, -1);
+	gtk_tree_model_row_inserted (GTK_TREE_MODEL (ilm), path, &iter);
+	gtk_tree_path_free (path);
+
+	/* New items are sorted into place later, so that a batch
+	   of additions causes only a single sort */
+	priv->sorted = FALSE;
+	if (!priv->sortIdleId)
+		priv->sortIdleId = g_idle_add (item_list_model_sort_idle_cb, ilm);
+}
+
+static gint
+item_list_model_position_compare (gconstpointer a, gconstpointer b)
+{
+	return *(const gint *)b - *(const gint *)a;
+}
+
+guint
+item_list_model_remove_many (ItemListModel *ilm, const gulong *ids, guint count)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	GtkTreePath		*path;
+	GArray			*positions;
+	guint			i, removed = 0;
+	gint			pos;
+
+	/* Look up all positions before changing the id array, so
+	   that the position hash is rebuilt at most once... */
+	positions = g_array_sized_new (FALSE, FALSE, sizeof (gint), count);
+	for (i = 0; i < count; i++) {
+		pos = item_list_model_get_position (ilm, ids[i], -1);
+		if (pos >= 0)
+			g_array_append_val (positions, pos);
+	}
+
+	/* ...and remove from the end, which keeps the positions
+	   of the rows still to be removed valid. */
+	g_array_sort (positions, item_list_model_position_compare);
+	for (i = 0; i < positions->len; i++) {
+		gulong	id;
+
+		pos = g_array_index (positions, gint, i);
+		if ((i > 0) && (pos == g_array_index (positions, gint, i - 1)))
+			continue;	/* duplicate id */
+
+		id = g_array_index (priv->ids, gulong, pos);
+		g_array_remove_index (priv->ids, pos);
+		g_hash_table_remove (priv->positions, GUINT_TO_POINTER (id));
+		g_hash_table_remove (priv->rows, GUINT_TO_POINTER (id));
+		if ((guint)pos < priv->ids->len)
+			priv->positionsDirty = TRUE;
+
+		path = gtk_tree_path_new_from_indices (pos, -1);
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (ilm), path);
+		gtk_tree_path_free (path);
+		removed++;
+	}
+	g_array_free (positions, TRUE);
+
+	return removed;
+}
+
+gboolean
+item_list_model_remove (ItemListModel *ilm, gulong id)
+{
+	return (1 == item_list_model_remove_many (ilm, &id, 1));
+}
+
+gboolean
+item_list_model_contains (ItemListModel *ilm, gulong id)
+{
+	return (NULL != g_hash_table_lookup (ilm->priv->positions, GUINT_TO_POINTER (id)));
+}
+
+gboolean
+item_list_model_get_iter_for_id (ItemListModel *ilm, gulong id, GtkTreeIter *iter)
+{
+	gint	pos;
+
+	if (!item_list_model_contains (ilm, id))
+		return FALSE;
+
+	pos = item_list_model_get_position (ilm, id, -1);
+	if (pos < 0)
+		return FALSE;
+
+	item_list_model_set_iter (ilm, iter, pos);
+	return TRUE;
+}
+
+gulong
+item_list_model_get_id (ItemListModel *ilm, GtkTreeIter *iter)
+{
+	g_return_val_if_fail (iter->stamp == ilm->priv->stamp, 0);
+
+	return GPOINTER_TO_UINT (iter->user_data);
+}
+
+gboolean
+item_list_model_is_unread (ItemListModel *ilm, GtkTreeIter *iter)
+{
+	gint	pos;
+
+	pos = item_list_model_iter_position (ilm, iter);
+	if (pos < 0)
+		return FALSE;
+
+	return !item_list_model_get_row (ilm, pos)->readStatus;
+}
+
+void
+item_list_model_update_item (ItemListModel *ilm, itemPtr item)
+{
+	GtkTreeIter	iter;
+	GtkTreePath	*path;
+
+	if (!item_list_model_get_iter_for_id (ilm, item->id, &iter))
+		return;
+
+	g_hash_table_insert (ilm->priv->rows, GUINT_TO_POINTER (item->id),
+	                     item_list_model_row_new (item->title, item->time, item->nodeId,
+	                                              item->readStatus, item->flagStatus, item->hasEnclosure));
+
+	path = gtk_tree_path_new_from_indices (GPOINTER_TO_INT (iter.user_data2), -1);
+	gtk_tree_model_row_changed (GTK_TREE_MODEL (ilm), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+void
+item_list_model_update_all (ItemListModel *ilm)
+{
+	g_hash_table_remove_all (ilm->priv->rows);
+}
+
+void
+item_list_model_clear (ItemListModel *ilm)
+{
+	ItemListModelPrivate	*priv = ilm->priv;
+	GtkTreePath		*path;
+
+	if (priv->sortIdleId)
+		g_source_remove (priv->sortIdleId);
+	priv->sortIdleId = 0;
+	priv->sorted = TRUE;
+
+	g_hash_table_remove_all (priv->positions);
+	g_hash_table_remove_all (priv->rows);
+	priv->positionsDirty = FALSE;
+
+	/* Deleting from the end avoids shifting the remaining rows */
+	while (priv->ids->len > 0) {
+		g_array_set_size (priv->ids, priv->ids->len - 1);
+		path = gtk_tree_path_new_from_indices (priv->ids->len, -1);
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (ilm), path);
+		gtk_tree_path_free (path);
+	}
+}
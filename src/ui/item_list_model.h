@@ -0,0 +1,199 @@
+/**
+ * @file item_list_model.h  lazy loading item list GtkTreeModel
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ITEM_LIST_MODEL_H
+#define _ITEM_LIST_MODEL_H
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "item.h"
+
+/* The item list model is a flat GtkTreeModel that holds nothing
+   but the ids of the listed items in display order. The column
+   values of a row are loaded from the DB only when the tree view
+   asks for them (which it does for visible rows only when using
+   fixed height mode) and are kept in a bounded row cache.
+
+   Sorting is done by the DB and applied by a single
+   "rows-reordered" signal. Items added after the initial load
+   are appended and sorted into place from an idle callback. */
+
+G_BEGIN_DECLS
+
+/** Enumeration of the columns in the item list model. */
+enum is_columns {
+	IS_TIME,		/**< Time of item creation */
+	IS_TIME_STR,		/**< Time of item creation as a string*/
+	IS_LABEL,		/**< Displayed name */
+	IS_STATEICON,		/**< Pixbuf reference to the item's state icon */
+	IS_NR,			/**< Item id, to lookup item ptr from parent feed */
+	IS_PARENT,		/**< Parent node pointer */
+	IS_FAVICON,		/**< Pixbuf reference to the item's feed's icon */
+	IS_ENCICON,		/**< Pixbuf reference to the item's enclosure icon */
+	IS_ENCLOSURE,		/**< Flag wether enclosure is attached or not */
+	IS_SOURCE,		/**< Source node pointer */
+	IS_STATE,		/**< Original item state (unread, flagged...) for sorting */
+	ITEMSTORE_UNREAD,	/**< Flag whether "unread" icon is to be shown */
+	ITEMSTORE_ALIGN,        /**< How to align title (RTL support) */
+	ITEMSTORE_LEN		/**< Number of columns in the itemstore */
+};
+
+#define ITEM_LIST_MODEL_TYPE		(item_list_model_get_type ())
+#define ITEM_LIST_MODEL(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), ITEM_LIST_MODEL_TYPE, ItemListModel))
+#define ITEM_LIST_MODEL_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST ((klass), ITEM_LIST_MODEL_TYPE, ItemListModelClass))
+#define IS_ITEM_LIST_MODEL(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), ITEM_LIST_MODEL_TYPE))
+#define IS_ITEM_LIST_MODEL_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), ITEM_LIST_MODEL_TYPE))
+
+typedef struct ItemListModel		ItemListModel;
+typedef struct ItemListModelClass	ItemListModelClass;
+typedef struct ItemListModelPrivate	ItemListModelPrivate;
+
+struct ItemListModel
+{
+	GObject		parent;
+
+	/*< private >*/
+	ItemListModelPrivate	*priv;
+};
+
+struct ItemListModelClass
+{
+	GObjectClass parent_class;
+};
+
+GType item_list_model_get_type (void);
+
+/**
+ * Creates a new empty item list model.
+ *
+ * @returns a new ItemListModel
+ */
+ItemListModel * item_list_model_new (void);
+
+/**
+ * Adds an item id to the model. Nothing happens if the
+ * id is already in the model.
+ *
+ * @param ilm	the ItemListModel
+ * @param id	the item id
+ */
+void item_list_model_add (ItemListModel *ilm, gulong id);
+
+/**
+ * Removes an item id from the model.
+ *
+ * @param ilm	the ItemListModel
+ * @param id	the item id
+ *
+ * @returns FALSE if the id was not in the model
+ */
+gboolean item_list_model_remove (ItemListModel *ilm, gulong id);
+
+/**
+ * Removes several item ids from the model. Unlike repeated
+ * calls of item_list_model_remove() the row positions are
+ * recalculated only once.
+ *
+ * @param ilm	the ItemListModel
+ * @param ids	array of item ids
+ * @param count	number of item ids
+ *
+ * @returns the number of removed rows
+ */
+guint item_list_model_remove_many (ItemListModel *ilm, const gulong *ids, guint count);
+
+/**
+ * Checks wether the given id is in the model.
+ *
+ * @param ilm	the ItemListModel
+ * @param id	the item id
+ *
+ * @returns TRUE if the item is in the model
+ */
+gboolean item_list_model_contains (ItemListModel *ilm, gulong id);
+
+/**
+ * Looks up the iter of the given item id.
+ *
+ * @param ilm	the ItemListModel
+ * @param id	the item id
+ * @param iter	the iter to set
+ *
+ * @returns FALSE if the id is not in the model
+ */
+gboolean item_list_model_get_iter_for_id (ItemListModel *ilm, gulong id, GtkTreeIter *iter);
+
+/**
+ * Returns the item id of the given iter.
+ *
+ * @param ilm	the ItemListModel
+ * @param iter	a valid iter
+ *
+ * @returns the item id
+ */
+gulong item_list_model_get_id (ItemListModel *ilm, GtkTreeIter *iter);
+
+/**
+ * Returns TRUE if the given row is an unread item. Loads
+ * the row from the DB if necessary.
+ *
+ * @param ilm	the ItemListModel
+ * @param iter	a valid iter
+ *
+ * @returns TRUE if the item is unread
+ */
+gboolean item_list_model_is_unread (ItemListModel *ilm, GtkTreeIter *iter);
+
+/**
+ * Updates the row of the given item from the item
+ * attributes without querying the DB.
+ *
+ * @param ilm	the ItemListModel
+ * @param item	the item
+ */
+void item_list_model_update_item (ItemListModel *ilm, itemPtr item);
+
+/**
+ * Drops all cached rows so that they are reloaded
+ * from the DB when shown the next time.
+ *
+ * @param ilm	the ItemListModel
+ */
+void item_list_model_update_all (ItemListModel *ilm);
+
+/**
+ * Removes all items from the model.
+ *
+ * @param ilm	the ItemListModel
+ */
+void item_list_model_clear (ItemListModel *ilm);
+
+/**
+ * Sorts the model by the current sort column using the DB.
+ *
+ * @param ilm	the ItemListModel
+ */
+void item_list_model_sort (ItemListModel *ilm);
+
+G_END_DECLS
+
+#endif
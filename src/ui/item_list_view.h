@@ -27,6 +27,7 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include "db.h"
 #include "item.h"
 #include "node_view.h"
 
@@ -116,9 +117,9 @@ void item_list_view_select (ItemListView *ilv, itemPtr item);
  * by background updates.
  *
  * @param ilv	the ItemListView
- * @param item	the item to add
+ * @param entry	the item list entry of the item to add
  */
-void item_list_view_add_item (ItemListView *ilv, itemPtr item);
+void item_list_view_add_entry (ItemListView *ilv, itemListEntryPtr entry);
 
 /**
  * Remove an item from an ItemListView. This method is expensive
@@ -130,6 +131,16 @@ void item_list_view_add_item (ItemListView *ilv, itemPtr item);
  */
 void item_list_view_remove_item (ItemListView *ilv, itemPtr item);
 
+/**
+ * Removes several items from an ItemListView at once. To be
+ * preferred over item_list_view_remove_item() for batches as
+ * the list positions are recalculated only once.
+ *
+ * @param ilv	the ItemListView
+ * @param items	list of the items to remove
+ */
+void item_list_view_remove_items (ItemListView *ilv, GSList *items);
+
 /**
  * Enable the favicon column of the currently displayed itemlist.
  *
@@ -147,7 +158,7 @@ void item_list_view_clear (ItemListView *ilv);
 
 /**
  * Update the ItemListView with the newly added items. To be called
- * after doing a batch of item_list_view_add_item() calls.
+ * after doing a batch of item_list_view_add_entry() calls.
  *
  * @param ilv	the ItemListView
  * @param hasEnclosures	TRUE if at least one item has an enclosure
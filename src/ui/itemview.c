@@ -137,18 +137,52 @@ itemview_set_displayed_node (nodePtr node)
 }
 
 void
-itemview_add_item (itemPtr item)
+itemview_add_entry (itemListEntryPtr entry)
 {
-	itemview->priv->hasEnclosures |= item->hasEnclosure;
+	itemview->priv->hasEnclosures |= entry->hasEnclosure;
 
 	if (ITEMVIEW_ALL_ITEMS != itemview->priv->mode)
 		/* add item in 3 pane mode */
-		item_list_view_add_item (itemview->priv->itemListView, item);
+		item_list_view_add_entry (itemview->priv->itemListView, entry);
 	else
 		/* force HTML update in 2 pane mode */
 		itemview->priv->needsHTMLViewUpdate = TRUE;
 		
-	htmlview_add_item (item);
+	htmlview_add_entry (entry);
+}
+
+void
+itemview_add_item (itemPtr item)
+{
+	struct itemListEntry	entry;
+	const gchar		*description = item_get_description (item);
+
+	entry.id = item->id;
+	entry.nodeId = item->nodeId;
+	entry.time = item->time;
+	entry.sourceId = item->validGuid?item->sourceId:NULL;
+	entry.hasEnclosure = item->hasEnclosure;
+	entry.hasContent = description && *description;
+
+	itemview_add_entry (&entry);
+}
+
+void
+itemview_begin_batch (void)
+{
+	htmlview_begin_batch ();
+}
+
+void
+itemview_end_batch (void)
+{
+	htmlview_end_batch ();
+}
+
+gboolean
+itemview_contains_id (gulong id)
+{
+	return item_list_view_contains_id (itemview->priv->itemListView, id);
 }
 
 void
@@ -167,6 +201,34 @@ itemview_remove_item (itemPtr item)
 	htmlview_remove_item (item);
 }
 
+void
+itemview_remove_items (GSList *items)
+{
+	GSList	*shown = NULL, *iter;
+
+	for (iter = items; iter; iter = g_slist_next (iter)) {
+		itemPtr item = (itemPtr)iter->data;
+
+		if (!item_list_view_contains_id (itemview->priv->itemListView, item->id))
+			continue;
+
+		shown = g_slist_prepend (shown, item);
+		htmlview_remove_item (item);
+	}
+
+	if (!shown)
+		return;
+
+	if (ITEMVIEW_ALL_ITEMS != itemview->priv->mode)
+		/* remove items in 3 pane mode */
+		item_list_view_remove_items (itemview->priv->itemListView, shown);
+	else
+		/* force HTML update in 2 pane mode */
+		itemview->priv->needsHTMLViewUpdate = TRUE;
+
+	g_slist_free (shown);
+}
+
 void
 itemview_select_item (itemPtr item)
 {
@@ -188,6 +250,10 @@ itemview_select_item (itemPtr item)
 void
 itemview_update_item (itemPtr item)
 {
+	/* Always drop the rendering, cached renderings of items
+	   not displayed right now would be outdated too */
+	htmlview_update_item (item);
+
 	/* Always update the GtkTreeView (bail-out done in ui_itemlist_update_item() */
 	if (ITEMVIEW_ALL_ITEMS != itemview->priv->mode)
 		item_list_view_update_item (itemview->priv->itemListView, item);
@@ -211,7 +277,6 @@ itemview_update_item (itemPtr item)
 	}
 	
 	itemview->priv->needsHTMLViewUpdate = TRUE;
-	htmlview_update_item (item);
 }
 
 void
@@ -225,6 +290,17 @@ itemview_update_all_items (void)
 	htmlview_update_all_items ();
 }
 
+void
+itemview_show_more_items (void)
+{
+	if (ITEMVIEW_ALL_ITEMS != itemview->priv->mode)
+		return;
+
+	htmlview_show_more ();
+	itemview->priv->needsHTMLViewUpdate = TRUE;
+	itemview_update ();
+}
+
 void
 itemview_update_node_info (nodePtr node)
 {
@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include "db.h"
 #include "item.h"
 #include "itemset.h"
 #include "node.h"
@@ -104,6 +105,34 @@ void itemview_set_mode (itemViewMode mode);
  */
 void itemview_add_item (itemPtr item);
 
+/**
+ * Like itemview_add_item(), but adds an item that is not
+ * loaded. The item is loaded only when it is displayed.
+ *
+ * @param entry		the item list entry of the item to add
+ */
+void itemview_add_entry (itemListEntryPtr entry);
+
+/**
+ * Starts a batch of itemview_add_(item|entry)() calls, e.g. when
+ * merging an item set. Batches may be nested.
+ */
+void itemview_begin_batch (void);
+
+/**
+ * Ends a batch started with itemview_begin_batch().
+ */
+void itemview_end_batch (void);
+
+/**
+ * Checks wether the given item is currently displayed.
+ *
+ * @param id	the item id
+ *
+ * @returns TRUE if the item is in the view
+ */
+gboolean itemview_contains_id (gulong id);
+
 /**
  * Removes a given item from the view.
  *
@@ -113,6 +142,13 @@ void itemview_add_item (itemPtr item);
  */
 void itemview_remove_item (itemPtr item);
 
+/**
+ * Removes several items from the view at once.
+ *
+ * @param items	list of the items to remove
+ */
+void itemview_remove_items (GSList *items);
+
 /**
  * Selects a given item in the view. The item must be
  * added using itemview_add_item before selecting.
@@ -133,6 +169,11 @@ void itemview_update_item (itemPtr item);
  */
 void itemview_update_all_items (void);
 
+/**
+ * Renders another window of older items in combined view.
+ */
+void itemview_show_more_items (void);
+
 /**
  * Requests updating the rendering of the node info view.
  *
@@ -42,6 +42,7 @@
 #include "ui/browser_tabs.h"
 #include "ui/liferea_shell.h"
 #include "ui/item_list_view.h"
+#include "ui/itemview.h"
 #include "ui/ui_common.h"
 #include "ui/ui_prefs.h"
 
@@ -295,6 +296,12 @@ liferea_htmlview_handle_URL (LifereaHtmlView *htmlview, const gchar *url)
 	if (liferea_htmlview_is_special_url (url)) {
 		if (htmlview->priv->internal) {
 	
+			/* the combined view "show more" link */
+			if (g_str_has_prefix (url, "liferea-show-more://")) {
+				itemview_show_more_items ();
+				return TRUE;
+			}
+
 			/* it is a generic item list URI type */		
 			uriType = internalUriTypes;
 			while (uriType->suffix) {
@@ -385,7 +385,7 @@ subscription_prop_dialog_load (SubscriptionPropDialog *spd,
 	gint 		interval;
 	gint		default_update_interval;
 	gint		defaultInterval, spinSetInterval;
-	gchar 		*defaultIntervalStr;
+	gchar 		*defaultIntervalStr, *adaptiveReason;
 	nodePtr		node = subscription->node;
 	feedPtr		feed = (feedPtr)node->data;
 
@@ -433,6 +433,17 @@ subscription_prop_dialog_load (SubscriptionPropDialog *spd,
 	else
 		defaultIntervalStr = g_strdup(_("This feed specifies no default update interval."));
 
+	/* add the adaptive update interval and its reason */
+	interval = subscription_get_auto_update_interval (subscription, &adaptiveReason);
+	if (adaptiveReason) {
+		gchar *tmp = defaultIntervalStr;
+		defaultIntervalStr = g_strdup_printf (ngettext ("%s\nThe adaptive update interval is %d minute. %s",
+		                                                "%s\nThe adaptive update interval is %d minutes. %s",
+		                                                interval), tmp, interval, adaptiveReason);
+		g_free (tmp);
+		g_free (adaptiveReason);
+	}
+
 	gtk_label_set_text(GTK_LABEL(liferea_dialog_lookup(spd->priv->dialog, "feedUpdateInfo")), defaultIntervalStr);
 	g_free(defaultIntervalStr);
 
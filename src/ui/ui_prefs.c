@@ -38,6 +38,7 @@
 #include "folder.h"
 #include "itemlist.h"
 #include "social.h"
+#include "update_scheduler.h"
 #include "ui/enclosure_list_view.h"
 #include "ui/ui_indicator.h"
 #include "ui/item_list_view.h"
@@ -175,6 +176,13 @@ on_startupactionbtn_toggled (GtkButton *button, gpointer user_data)
 	conf_set_int_value (STARTUP_FEED_ACTION, enabled?0:1);
 }
 
+void
+on_adaptiveupdatebtn_toggled (GtkToggleButton *button, gpointer user_data)
+{
+	conf_set_bool_value (ADAPTIVE_UPDATE, gtk_toggle_button_get_active (button));
+	update_scheduler_reschedule_all ();
+}
+
 void
 on_browsercmd_changed (GtkEditable *editable, gpointer user_data)
 {
@@ -276,6 +284,7 @@ on_default_update_interval_value_changed (GtkSpinButton *spinbutton, gpointer us
 		updateInterval *= 1440;		/* days */
 
 	conf_set_int_value (DEFAULT_UPDATE_INTERVAL, updateInterval);
+	update_scheduler_reschedule_all ();
 }
 
 static void
@@ -474,7 +483,7 @@ void on_prefbtn_clicked(void) {
 	gint			folder_display_mode, browse_key_setting;
 	gint			proxy_port, browser_place;
 	gint			enclosure_download_tool;
-	gboolean		folder_display_hide_read, disable_javascript;
+	gboolean		folder_display_hide_read, disable_javascript, adaptive_update;
 	gboolean		browse_inside_application, enable_plugins;
 	gboolean		show_tray_icon, show_popup_windows;
 	gboolean		show_new_count_in_tray, dont_minimize_to_tray;
@@ -555,6 +564,10 @@ void on_prefbtn_clicked(void) {
 		gtk_spin_button_set_value (GTK_SPIN_BUTTON (widget), tmp);
 		g_signal_connect (G_OBJECT (widget), "changed", G_CALLBACK (on_default_update_interval_value_changed), NULL);
 
+		/* check box for adaptive update intervals */
+		conf_get_bool_value (ADAPTIVE_UPDATE, &adaptive_update);
+		gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (liferea_dialog_lookup (prefdialog, "adaptiveupdatebtn")), adaptive_update);
+
 		/* ================== panel 2 "folders" ==================== */
 
 		g_signal_connect(G_OBJECT(liferea_dialog_lookup(prefdialog, "updateAllFavicons")), "clicked", G_CALLBACK(on_updateallfavicons_clicked), NULL);
@@ -30,23 +30,72 @@
 
 #include <unistd.h>
 #include <stdio.h>
-#include <sys/wait.h>
 #include <string.h>
 
 #include "common.h"
+#include "conf.h"
 #include "debug.h"
 #include "net.h"
+#include "spawn.h"
 #include "xml.h"
+#include "xslt_cache.h"
 #include "ui/liferea_shell.h"
 #include "ui/ui_tray.h"
 
-/** global update job list, used for lookups when cancelling */
-static GSList	*jobs = NULL;
-
-static GAsyncQueue *pendingHighPrioJobs = NULL;
-static GAsyncQueue *pendingJobs = NULL;
+/** set of all update jobs, used for lookups when cancelling */
+static GHashTable	*jobs = NULL;
+/** owner -> GSList of its update jobs (jobs without owner are not listed) */
+static GHashTable	*jobsByOwner = NULL;
+
+/** pending jobs, dispatching state and statistics of a host */
+typedef struct updateHost {
+	gchar		*name;		/**< host name ("" for commands and local files) */
+	GQueue		*highPrioJobs;	/**< pending user triggered jobs */
+	GQueue		*jobs;		/**< other pending jobs */
+	guint		active;		/**< number of running jobs */
+	gboolean	queued;		/**< TRUE if in the host ring */
+	glong		backoffUntil;	/**< no jobs are started before this time (seconds since epoch) */
+	guint		backoff;	/**< current backoff period if there is no Retry-After (seconds) */
+
+	guint		dispatched;	/**< number of jobs started */
+	guint		delayed;	/**< number of jobs that had to wait for the host limit or a backoff */
+	guint		maxPending;	/**< maximum number of pending jobs */
+	gint64		waitTime;	/**< total time jobs were pending (ms) */
+	guint		throttled;	/**< number of 429 and 503 responses */
+} *updateHostPtr;
+
+static GHashTable *hosts = NULL;	/**< host name -> updateHostPtr */
+static GQueue *hostRing = NULL;		/**< hosts with pending jobs in round-robin order */
 static guint numberOfActiveJobs = 0;
-#define MAX_ACTIVE_JOBS	5
+static guint maxActiveJobs = 0;
+static guint maxJobsPerHost = 0;
+
+/** worker thread pools of the filter and parse stages */
+static GThreadPool *filterPool = NULL;
+static GThreadPool *parsePool = NULL;
+
+/** received data of a job waiting for the streaming parser */
+typedef struct updateStreamQueue {
+	GQueue		*chunks;	/**< received chunks (GString) not yet parsed */
+	gboolean	scheduled;	/**< TRUE while a parse worker task of the job is queued or running */
+	gboolean	complete;	/**< TRUE once the download finished */
+	gboolean	failed;		/**< TRUE once the parser stopped on a fatal error (worker only) */
+} *updateStreamQueuePtr;
+
+/** protects the chunks and the scheduled and complete flags of all stream queues */
+G_LOCK_DEFINE_STATIC (streamQueues);
+
+#define DEFAULT_MAX_ACTIVE_JOBS		5
+#define DEFAULT_MAX_JOBS_PER_HOST	2
+#define DEFAULT_HOST_BACKOFF		60	/* seconds */
+#define MAX_HOST_BACKOFF		3600	/* seconds */
+#define DEFAULT_MAX_FILTER_THREADS	2
+#define DEFAULT_MAX_PARSE_THREADS	2
+#define DEFAULT_COMMAND_TIMEOUT		60	/* seconds */
+#define DEFAULT_COMMAND_MAX_OUTPUT	32768	/* KB */
+
+static void update_parse_stage (updateJobPtr job);
+static gboolean update_dequeue_job (gpointer user_data);
 
 /* update state interface */
 
@@ -68,6 +117,21 @@ update_state_set_lastmodified (updateStatePtr state, glong lastModified)
 	state->lastModified = lastModified;
 }
 
+const gchar *
+update_state_get_etag (updateStatePtr state)
+{
+	return state->etag;
+}
+
+void
+update_state_set_etag (updateStatePtr state, const gchar *etag)
+{
+	g_free (state->etag);
+	state->etag = NULL;
+	if (etag)
+		state->etag = g_strdup (etag);
+}
+
 const gchar *
 update_state_get_cookies (updateStatePtr state)
 {
@@ -83,6 +147,18 @@ update_state_set_cookies (updateStatePtr state, const gchar *cookies)
 		state->cookies = g_strdup (cookies);
 }
 
+glong
+update_state_get_max_age (updateStatePtr state)
+{
+	return state->maxAge;
+}
+
+void
+update_state_set_max_age (updateStatePtr state, glong maxAge)
+{
+	state->maxAge = maxAge;
+}
+
 updateStatePtr
 update_state_copy (updateStatePtr state)
 {
@@ -90,7 +166,12 @@ update_state_copy (updateStatePtr state)
 	
 	newState = update_state_new ();
 	update_state_set_lastmodified (newState, update_state_get_lastmodified (state));
+	update_state_set_etag (newState, update_state_get_etag (state));
 	update_state_set_cookies (newState, update_state_get_cookies (state));
+	update_state_set_max_age (newState, update_state_get_max_age (state));
+	newState->unchangedCount = state->unchangedCount;
+	newState->lastArrival = state->lastArrival;
+	newState->arrivalInterval = state->arrivalInterval;
 	
 	return newState;
 }
@@ -102,6 +183,7 @@ update_state_free (updateStatePtr updateState)
 		return;
 
 	g_free (updateState->cookies);
+	g_free (updateState->etag);
 	g_free (updateState);
 }
 
@@ -125,6 +207,7 @@ update_request_free (updateRequestPtr request)
 	g_free (request->postdata);
 	g_free (request->source);
 	g_free (request->filtercmd);
+	xml_stream_parser_free (request->stream);
 	g_free (request);
 }
 
@@ -161,6 +244,11 @@ update_result_free (updateResultPtr result)
 		
 	update_state_free (result->updateState);
 
+	if (result->doc)
+		xmlFreeDoc (result->doc);
+	if (result->parseErrors)
+		g_string_free (result->parseErrors, TRUE);
+
 	g_free (result->data);
 	g_free (result->source);
 	g_free (result->contentType);
@@ -211,6 +299,7 @@ update_job_new (gpointer owner,
 	job->user_data = user_data;
 	job->flags = flags;	
 	job->state = REQUEST_STATE_INITIALIZED;
+	job->cancellable = g_cancellable_new ();
 	
 	return job;
 }
@@ -221,73 +310,121 @@ update_job_get_state (updateJobPtr job)
 	return job->state;
 }
 
+static void
+update_job_register (updateJobPtr job)
+{
+	GSList	*ownerJobs;
+
+	g_hash_table_insert (jobs, job, job);
+	if (!job->owner)
+		return;
+
+	/* steal the list, as replacing it would free it */
+	ownerJobs = g_hash_table_lookup (jobsByOwner, job->owner);
+	g_hash_table_steal (jobsByOwner, job->owner);
+	g_hash_table_insert (jobsByOwner, job->owner, g_slist_prepend (ownerJobs, job));
+}
+
+static void
+update_job_unregister (updateJobPtr job)
+{
+	GSList	*ownerJobs;
+
+	if (!jobs || !g_hash_table_remove (jobs, job) || !job->owner)
+		return;
+
+	ownerJobs = g_hash_table_lookup (jobsByOwner, job->owner);
+	g_hash_table_steal (jobsByOwner, job->owner);
+	ownerJobs = g_slist_remove (ownerJobs, job);
+	if (ownerJobs)
+		g_hash_table_insert (jobsByOwner, job->owner, ownerJobs);
+}
+
+static void
+update_stream_chunk_free (GString *chunk)
+{
+	g_string_free (chunk, TRUE);
+}
+
 static void
 update_job_free (updateJobPtr job)
 {
 	if (!job)
 		return;
 		
-	jobs = g_slist_remove (jobs, job);
+	update_job_unregister (job);
+
+	if (job->timeout)
+		g_source_remove (job->timeout);
+	g_object_unref (job->cancellable);
+
+	if (job->streamQueue) {
+		g_queue_foreach (job->streamQueue->chunks, (GFunc)update_stream_chunk_free, NULL);
+		g_queue_free (job->streamQueue->chunks);
+		g_free (job->streamQueue);
+	}
 	
 	update_request_free (job->request);
 	update_result_free (job->result);
 	g_free (job);
 }
 
-/* filter idea (and some of the code) was taken from Snownews */
-static gchar *
-update_exec_filter_cmd (gchar *cmd, gchar *data, gchar **errorOutput, size_t *size)
-{
-	int		fd, status;
-	gchar		*command;
-	const gchar	*tmpdir = g_get_tmp_dir();
-	char		*tmpfilename;
-	char		*out = NULL;
-	FILE		*file, *p;
-	
-	*errorOutput = NULL;
-	tmpfilename = g_build_filename (tmpdir, "liferea-XXXXXX", NULL);
-	
-	fd = g_mkstemp(tmpfilename);
-	
-	if(fd == -1) {
-		debug1(DEBUG_UPDATE, "Error opening temp file %s to use for filtering!", tmpfilename);
-		*errorOutput = g_strdup_printf(_("Error opening temp file %s to use for filtering!"), tmpfilename);
-		g_free(tmpfilename);
-		return NULL;
-	}	
-		
-	file = fdopen(fd, "w");
-	fwrite(data, strlen(data), 1, file);
-	fclose(file);
-
-	*size = 0;
-	command = g_strdup_printf("%s < %s", cmd, tmpfilename);
-	p = popen(command, "r");
-	g_free(command);
-	if(NULL != p) {
-		while(!feof(p) && !ferror(p)) {
-			size_t len;
-			out = g_realloc(out, *size+1025);
-			len = fread(&out[*size], 1, 1024, p);
-			if(len > 0)
-				*size += len;
-		}
-		status = pclose(p);
-		if(!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
-			*errorOutput = g_strdup_printf(_("%s exited with status %d"),
-			                              cmd, WEXITSTATUS(status));
-			*size = 0;
-		}
-		out[*size] = '\0';
+static guint
+update_get_conf_uint (const gchar *key, guint defaultValue)
+{
+	gint	value;
+
+	if (!conf_get_int_value (key, &value) || value <= 0)
+		return defaultValue;
+
+	return (guint)value;
+}
+
+/* Runs a filter command or a command source with the configured limits */
+static void
+update_spawn (const gchar *command, const gchar *input, gsize inputLength, spawnResultFunc callback, updateJobPtr job)
+{
+	guint	timeout, maxOutput;
+
+	timeout = update_get_conf_uint (UPDATE_COMMAND_TIMEOUT, DEFAULT_COMMAND_TIMEOUT);
+	maxOutput = update_get_conf_uint (UPDATE_COMMAND_MAX_OUTPUT, DEFAULT_COMMAND_MAX_OUTPUT);
+
+	spawn_command (command, input, inputLength, timeout, (gsize)maxOutput * 1024, job->cancellable, callback, job);
+}
+
+static void
+update_exec_filter_cmd_cb (spawnResultPtr result, gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)user_data;
+
+	g_free (job->result->data);
+	if (result->success) {
+		job->result->data = result->data;
+		job->result->size = result->size;
+		result->data = NULL;
 	} else {
-		g_warning(_("Error: Could not open pipe \"%s\""), command);
-		*errorOutput = g_strdup_printf(_("Error: Could not open pipe \"%s\""), command);
+		/* like before a failed filter leaves no data to parse */
+		job->result->data = g_strdup ("");
+		job->result->size = 0;
+		if (result->errors)
+			job->result->filterErrors = g_strdup_printf ("%s\n%s", result->failure, result->errors);
+		else
+			job->result->filterErrors = g_strdup (result->failure);
 	}
-	/* Clean up. */
-	unlink (tmpfilename);
-	g_free (tmpfilename);
-	return out;
+
+	update_parse_stage (job);
+}
+
+/* filter idea was taken from Snownews, the filter gets the
+   downloaded data on its standard input */
+static void
+update_exec_filter_cmd (updateJobPtr job)
+{
+	debug1 (DEBUG_UPDATE, "filtering result of request (%s)", job->request->source);
+
+	g_assert (NULL == job->result->filterErrors);
+
+	update_spawn (job->request->filtercmd, job->result->data, job->result->size, update_exec_filter_cmd_cb, job);
 }
 
 static gchar *
@@ -307,8 +444,8 @@ update_apply_xslt (updateJobPtr job)
 			break;
 		}
 
-		/* load localization stylesheet */
-		xslt = xsltParseStylesheetFile (job->request->filtercmd);
+		/* get the compiled filter stylesheet */
+		xslt = xslt_cache_get (job->request->filtercmd, NULL, NULL);
 		if (!xslt) {
 			g_warning ("fatal: could not load filter stylesheet \"%s\"!", job->request->filtercmd);
 			break;
@@ -337,77 +474,117 @@ update_apply_xslt (updateJobPtr job)
 	if (resDoc)
 		xmlFreeDoc (resDoc);
 	if (xslt)
-		xsltFreeStylesheet (xslt);
+		xslt_cache_release (xslt);
 	
 	return output;
 }
 
+static gboolean
+update_filter_is_xslt (const gchar *filtercmd)
+{
+	/* we allow two types of filters: XSLT stylesheets and arbitrary commands */
+	return (strlen (filtercmd) > 4) &&
+	       (0 == strcmp (".xsl", filtercmd + strlen (filtercmd) - 4));
+}
+
 static void
 update_apply_filter (updateJobPtr job)
 {
 	gchar	*filterResult;
-	size_t	len = 0;
 
 	g_assert (NULL == job->result->filterErrors);
 
-	/* we allow two types of filters: XSLT stylesheets and arbitrary commands */
-	if ((strlen (job->request->filtercmd) > 4) &&
-	    (0 == strcmp (".xsl", job->request->filtercmd + strlen (job->request->filtercmd) - 4))) {
-		filterResult = update_apply_xslt (job);
-		len = strlen (filterResult);
-	} else {
-		filterResult = update_exec_filter_cmd (job->request->filtercmd, job->result->data, &(job->result->filterErrors), &len);
-	}
-
+	filterResult = update_apply_xslt (job);
 	if (filterResult) {
 		g_free (job->result->data);
 		job->result->data = filterResult;
-		job->result->size = len;
+		job->result->size = strlen (filterResult);
 	}
 }
 
+static void
+update_exec_cmd_cb (spawnResultPtr result, gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)user_data;
+
+	job->result->data = result->data;
+	job->result->size = result->size;
+	result->data = NULL;
+
+	if (result->success) {
+		job->result->httpstatus = 200;
+	} else {
+		if (-1 == result->exitStatus && job->callback)
+			liferea_shell_set_status_bar ("%s", result->failure);
+		job->result->httpstatus = 404;	/* FIXME: maybe setting request->returncode would be better */
+	}
+
+	update_process_finished_job (job);
+}
+
 static void
 update_exec_cmd (updateJobPtr job)
 {
-	FILE	*f;
-	int	status;
-	size_t	len;
-	
-	job->result = update_result_new ();
-		
 	/* if the first char is a | we have a pipe else a file */
-	debug1 (DEBUG_UPDATE, "executing command \"%s\"...", (job->request->source) + 1);	
-	f = popen ((job->request->source) + 1, "r");
-	if (f) {
-		while (!feof (f) && !ferror (f)) {
-			job->result->data = g_realloc (job->result->data, job->result->size + 1025);
-			len = fread (&job->result->data[job->result->size], 1, 1024, f);
-			if (len > 0)
-				job->result->size += len;
-		}
-		status = pclose (f);
-		if (WIFEXITED (status) && WEXITSTATUS (status) == 0)
-			job->result->httpstatus = 200;
-		else 
-			job->result->httpstatus = 404;	/* FIXME: maybe setting request->returncode would be better */
+	update_spawn ((job->request->source) + 1, NULL, 0, update_exec_cmd_cb, job);
+}
 
-		if (job->result->data)
-			job->result->data[job->result->size] = '\0';
+static void
+update_load_file_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)user_data;
+	gchar		*filename, *data = NULL;
+	gsize		length = 0;
+	GError		*error = NULL;
+
+	if (job->timeout)
+		g_source_remove (job->timeout);
+	job->timeout = 0;
+
+	filename = g_file_get_path (G_FILE (source));
+
+	if (g_file_load_contents_finish (G_FILE (source), res, &data, &length, NULL, &error) && length > 0) {
+		job->result->data = data;
+		job->result->size = length;
+		job->result->httpstatus = 200;
+		debug2 (DEBUG_UPDATE, "Successfully read %d bytes from file %s.", job->result->size, filename);
 	} else {
-		liferea_shell_set_status_bar (_("Error: Could not open pipe \"%s\""), (job->request->source) + 1);
-		job->result->httpstatus = 404;	/* FIXME: maybe setting request->returncode would be better */
+		g_free (data);
+		if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+			liferea_shell_set_status_bar (_("Error: There is no file \"%s\""), filename);
+			job->result->httpstatus = 404;	/* FIXME: maybe setting request->returncode would be better */
+		} else {
+			/* Cancelled jobs have no callback, otherwise the read timed out */
+			if (job->callback)
+				liferea_shell_set_status_bar (_("Error: Could not open file \"%s\""), filename);
+			job->result->httpstatus = 403;	/* FIXME: maybe setting request->returncode would be better */
+		}
+		if (error)
+			g_error_free (error);
 	}
-	
+
+	g_free (filename);
 	update_process_finished_job (job);
 }
 
+static gboolean
+update_load_file_timeout_cb (gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)user_data;
+
+	job->timeout = 0;
+	debug1 (DEBUG_UPDATE, "reading %s timed out", job->request->source);
+	g_cancellable_cancel (job->cancellable);
+
+	return FALSE;
+}
+
 static void
 update_load_file (updateJobPtr job)
 {
-	gchar *filename = job->request->source;
-	gchar *anchor;
-	
-	job->result = update_result_new ();
+	gchar	*filename = job->request->source;
+	gchar	*anchor;
+	GFile	*file;
 	
 	if (!strncmp (filename, "file://",7))
 		filename += 7;
@@ -416,21 +593,14 @@ update_load_file (updateJobPtr job)
 	if (anchor)
 		*anchor = 0;	 /* strip anchors from filenames */
 
-	if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
-		/* we have a file... */
-		if ((!g_file_get_contents (filename, &(job->result->data), &(job->result->size), NULL)) || (job->result->data[0] == '\0')) {
-			job->result->httpstatus = 403;	/* FIXME: maybe setting request->returncode would be better */
-			liferea_shell_set_status_bar (_("Error: Could not open file \"%s\""), filename);
-		} else {
-			job->result->httpstatus = 200;
-			debug2 (DEBUG_UPDATE, "Successfully read %d bytes from file %s.", job->result->size, filename);
-		}
-	} else {
-		liferea_shell_set_status_bar (_("Error: There is no file \"%s\""), filename);
-		job->result->httpstatus = 404;	/* FIXME: maybe setting request->returncode would be better */
-	}
-	
-	update_process_finished_job (job);
+	/* Read asynchronously as the file might be on a slow
+	   file system, the timeout does also apply to hanging
+	   network mounts. */
+	file = g_file_new_for_path (filename);
+	job->timeout = g_timeout_add_seconds (update_get_conf_uint (UPDATE_COMMAND_TIMEOUT, DEFAULT_COMMAND_TIMEOUT),
+	                                      update_load_file_timeout_cb, job);
+	g_file_load_contents_async (file, job->cancellable, update_load_file_cb, job);
+	g_object_unref (file);
 }
 
 static void
@@ -462,25 +632,234 @@ update_job_run (updateJobPtr job)
 	}
 }
 
+/* host queue handling */
+
+static gint64
+update_get_time_ms (void)
+{
+	GTimeVal	now;
+
+	g_get_current_time (&now);
+	return (gint64)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+/* Returns the lower case host name of an URI source
+   or "" for commands and local files */
+static gchar *
+update_get_host_name (const gchar *source)
+{
+	const gchar	*start, *end, *tmp;
+
+	if ('|' == *source || !strstr (source, "://") || !strncmp (source, "file://", 7))
+		return g_strdup ("");
+
+	start = strstr (source, "://") + 3;
+	end = start + strcspn (start, "/?#");
+
+	/* skip user info */
+	tmp = g_strstr_len (start, end - start, "@");
+	if (tmp)
+		start = tmp + 1;
+
+	/* strip the port */
+	tmp = g_strstr_len (start, end - start, ":");
+	if (tmp)
+		end = tmp;
+
+	return g_ascii_strdown (start, end - start);
+}
+
+static void
+update_host_debug_statistics (updateHostPtr host)
+{
+	debug6 (DEBUG_UPDATE, "host \"%s\": %u jobs, %u delayed, max. %u pending, %" G_GINT64_FORMAT " ms total wait, %u throttled",
+	        host->name, host->dispatched, host->delayed, host->maxPending, host->waitTime, host->throttled);
+}
+
+static void
+update_host_free (updateHostPtr host)
+{
+	update_host_debug_statistics (host);
+
+	g_queue_free (host->highPrioJobs);
+	g_queue_free (host->jobs);
+	g_free (host->name);
+	g_free (host);
+}
+
+static gboolean
+update_host_can_run (updateHostPtr host, glong now)
+{
+	if (host->backoffUntil > now)
+		return FALSE;
+
+	/* Local sources are not limited per host */
+	if (!*(host->name))
+		return TRUE;
+
+	return host->active < maxJobsPerHost;
+}
+
+static void
+update_host_push_job (updateJobPtr job)
+{
+	updateHostPtr	host;
+	gchar		*name;
+	GTimeVal	now;
+	guint		pending;
+
+	name = update_get_host_name (job->request->source);
+	host = g_hash_table_lookup (hosts, name);
+	if (!host) {
+		host = g_new0 (struct updateHost, 1);
+		host->name = name;
+		host->highPrioJobs = g_queue_new ();
+		host->jobs = g_queue_new ();
+		g_hash_table_insert (hosts, host->name, host);
+	} else {
+		g_free (name);
+	}
+
+	job->host = host;
+	job->queuedAt = update_get_time_ms ();
+
+	if (job->flags & FEED_REQ_PRIORITY_HIGH)
+		g_queue_push_tail (host->highPrioJobs, job);
+	else
+		g_queue_push_tail (host->jobs, job);
+
+	g_get_current_time (&now);
+	if (!update_host_can_run (host, now.tv_sec))
+		host->delayed++;
+
+	pending = g_queue_get_length (host->highPrioJobs) + g_queue_get_length (host->jobs);
+	host->maxPending = MAX (host->maxPending, pending);
+
+	if (!host->queued) {
+		g_queue_push_tail (hostRing, host);
+		host->queued = TRUE;
+	}
+}
+
+/* Returns the next job to run. User triggered jobs come first,
+   otherwise the hosts that can run a job are served round-robin. */
+static updateJobPtr
+update_host_pop_job (void)
+{
+	updateHostPtr	host = NULL;
+	updateJobPtr	job;
+	GQueue		*queue = NULL;
+	GList		*iter = NULL;
+	GTimeVal	now;
+	gint		pass;
+
+	g_get_current_time (&now);
+
+	for (pass = 0; pass < 2 && !queue; pass++) {
+		for (iter = hostRing->head; iter; iter = g_list_next (iter)) {
+			host = (updateHostPtr)iter->data;
+			if (!update_host_can_run (host, now.tv_sec))
+				continue;
+
+			queue = (0 == pass)?host->highPrioJobs:host->jobs;
+			if (!g_queue_is_empty (queue))
+				break;
+			queue = NULL;
+		}
+	}
+
+	if (!queue)
+		return NULL;
+
+	job = (updateJobPtr)g_queue_pop_head (queue);
+
+	/* Move the host to the end of the ring */
+	g_queue_delete_link (hostRing, iter);
+	if (g_queue_is_empty (host->highPrioJobs) && g_queue_is_empty (host->jobs)) {
+		host->queued = FALSE;
+		update_host_debug_statistics (host);
+	} else
+		g_queue_push_tail (hostRing, host);
+
+	host->active++;
+	host->dispatched++;
+	host->waitTime += update_get_time_ms () - job->queuedAt;
+
+	return job;
+}
+
+static void
+update_host_remove_job (updateJobPtr job)
+{
+	updateHostPtr	host = job->host;
+
+	if (!g_queue_remove (host->highPrioJobs, job))
+		g_queue_remove (host->jobs, job);
+
+	if (host->queued && g_queue_is_empty (host->highPrioJobs) && g_queue_is_empty (host->jobs)) {
+		g_queue_remove (hostRing, host);
+		host->queued = FALSE;
+	}
+}
+
+static gboolean
+update_host_backoff_over_cb (gpointer user_data)
+{
+	g_idle_add (update_dequeue_job, NULL);
+
+	return FALSE;
+}
+
+/* Called for every finished job to track the host load and backoff */
+static void
+update_host_job_finished (updateJobPtr job)
+{
+	updateHostPtr	host = job->host;
+	GTimeVal	now;
+	glong		delay;
+
+	g_assert (host->active > 0);
+	host->active--;
+
+	if (429 != job->result->httpstatus && 503 != job->result->httpstatus) {
+		if (job->result->httpstatus)
+			host->backoff = 0;
+		return;
+	}
+
+	/* The host is overloaded or rate limits us, so stop
+	   sending requests for the time it asks for */
+	host->throttled++;
+	if (job->result->retryAfter > 0) {
+		delay = MIN (job->result->retryAfter, MAX_HOST_BACKOFF);
+	} else {
+		host->backoff = host->backoff?MIN (2 * host->backoff, MAX_HOST_BACKOFF):DEFAULT_HOST_BACKOFF;
+		delay = host->backoff;
+	}
+
+	g_get_current_time (&now);
+	if (now.tv_sec + delay <= host->backoffUntil)
+		return;
+
+	debug3 (DEBUG_UPDATE, "host \"%s\" answered %d, backing off for %ld s", host->name, job->result->httpstatus, delay);
+	host->backoffUntil = now.tv_sec + delay;
+	g_timeout_add_seconds (delay, update_host_backoff_over_cb, NULL);
+}
+
 static gboolean
 update_dequeue_job (gpointer user_data)
 {
 	updateJobPtr job;
 	
-	if (!pendingJobs)
+	if (!hostRing)
 		return FALSE;	/* we must be in shutdown */
 		
-	if (numberOfActiveJobs >= MAX_ACTIVE_JOBS) 
+	if (numberOfActiveJobs >= maxActiveJobs) 
 		return FALSE;	/* we'll be called again when a job finishes */
 	
-
-	job = (updateJobPtr)g_async_queue_try_pop(pendingHighPrioJobs);
-
+	job = update_host_pop_job ();
 	if (!job)
-		job = (updateJobPtr)g_async_queue_try_pop(pendingJobs);
-
-	if(!job)
-		return FALSE;	/* no request at the moment */
+		return FALSE;	/* no request at the moment or all hosts busy */
 
 	numberOfActiveJobs++;
 
@@ -509,29 +888,67 @@ update_execute_request (gpointer owner,
 	
 	job = update_job_new (owner, request, callback, user_data, flags);
 	job->state = REQUEST_STATE_PENDING;	
-	jobs = g_slist_append (jobs, job);
-
-	if (flags & FEED_REQ_PRIORITY_HIGH) {
-		g_async_queue_push (pendingHighPrioJobs, (gpointer)job);
-	} else {
-		g_async_queue_push (pendingJobs, (gpointer)job);
-	}
+	update_job_register (job);
+	update_host_push_job (job);
 
 	g_idle_add (update_dequeue_job, NULL);
 	return job;
 }
 
+/* Aborts whatever the job is doing. As this might free the
+   job right away it must not be used afterwards. */
+static void
+update_job_cancel (updateJobPtr job)
+{
+	GCancellable	*cancellable;
+
+	job->callback = NULL;
+
+	/* Pending jobs are just dropped from their host queue */
+	if (REQUEST_STATE_PENDING == job->state) {
+		debug1 (DEBUG_UPDATE, "dropping pending request (%s)", job->request->source);
+		update_host_remove_job (job);
+		update_job_free (job);
+		return;
+	}
+
+	/* The cancellable kills commands and filters, aborts file
+	   reads and makes the filter and parse workers skip the job */
+	cancellable = g_object_ref (job->cancellable);
+	if (REQUEST_STATE_PROCESSING == job->state)
+		network_cancel_request (job);
+	g_cancellable_cancel (cancellable);
+	g_object_unref (cancellable);
+}
+
+void
+update_job_cancel_all (void)
+{
+	GList	*allJobs, *iter;
+
+	if (!jobs)
+		return;
+
+	/* cancelling may finish and free the job, so work on a copy */
+	allJobs = g_hash_table_get_keys (jobs);
+	for (iter = allJobs; iter; iter = g_list_next (iter))
+		update_job_cancel ((updateJobPtr)iter->data);
+	g_list_free (allJobs);
+}
+
 void
 update_job_cancel_by_owner (gpointer owner)
 {
-	GSList	*iter = jobs;
+	GSList	*ownerJobs, *iter;
 
-	while (iter) {
-		updateJobPtr job = (updateJobPtr)iter->data;
-		if (job->owner == owner)
-			job->callback = NULL;
-		iter = g_slist_next (iter);
-	}
+	if (!jobs || !owner)
+		return;
+
+	/* cancelling may finish and free the job, so work on a copy */
+	ownerJobs = g_slist_copy (g_hash_table_lookup (jobsByOwner, owner));
+	for (iter = ownerJobs; iter; iter = g_slist_next (iter))
+		update_job_cancel ((updateJobPtr)iter->data);
+	g_slist_free (ownerJobs);
 }
 
 static gboolean
@@ -547,6 +964,180 @@ update_process_result_idle_cb (gpointer user_data)
 	return FALSE;
 }
 
+/* The filter and parse stage workers must not touch anything but
+   the job they were passed. Cancelling is done by the main loop
+   resetting the job callback, which is checked only in
+   update_process_result_idle_cb(), and cancelling the job's
+   cancellable, which makes the workers skip the job. */
+
+/* Terminates the document of the request's streaming parser,
+   whatever the parser did not consume is the result DOM */
+static void
+update_stream_finish (updateJobPtr job)
+{
+	errorCtxtPtr	errors;
+
+	errors = g_new0 (struct errorCtxt, 1);
+	errors->msg = g_string_new (NULL);
+
+	job->result->doc = xml_stream_parser_finish (job->request->stream, errors);
+	job->result->parseErrors = errors->msg;
+	job->result->parseErrorCount = errors->errorCount;
+	job->result->parsed = TRUE;
+	job->result->stream = job->request->stream;
+	g_free (errors);
+}
+
+/* Passes the queued chunks of a download to the streaming parser.
+   Only one task per job is scheduled at a time. The task ends
+   when the queue is empty, the next received chunk schedules a
+   new one. The task finding the download complete finishes it. */
+static void
+update_stream_stage_run (updateJobPtr job)
+{
+	updateStreamQueuePtr	queue = job->streamQueue;
+	GString			*chunk;
+	gboolean		complete = FALSE;
+
+	do {
+		G_LOCK (streamQueues);
+		chunk = (GString *)g_queue_pop_head (queue->chunks);
+		if (!chunk) {
+			queue->scheduled = FALSE;
+			complete = queue->complete;
+		}
+		G_UNLOCK (streamQueues);
+
+		if (chunk) {
+			/* after a fatal error or cancelling chunks are just dropped */
+			if (!queue->failed && !g_cancellable_is_cancelled (job->cancellable))
+				queue->failed = !xml_stream_parser_push (job->request->stream, chunk->str, chunk->len);
+			update_stream_chunk_free (chunk);
+		}
+	} while (chunk);
+
+	if (!complete)
+		return;
+
+	if (!g_cancellable_is_cancelled (job->cancellable)) {
+		debug1 (DEBUG_UPDATE, "finishing streamed result of request (%s)", job->request->source);
+		update_stream_finish (job);
+	}
+
+	g_idle_add (update_process_result_idle_cb, job);
+}
+
+void
+update_job_push_chunk (updateJobPtr job, const gchar *data, gsize length)
+{
+	gboolean	schedule;
+
+	if (!job->request->stream || !parsePool)
+		return;
+
+	G_LOCK (streamQueues);
+	if (!job->streamQueue) {
+		job->streamQueue = g_new0 (struct updateStreamQueue, 1);
+		job->streamQueue->chunks = g_queue_new ();
+	}
+	g_queue_push_tail (job->streamQueue->chunks, g_string_new_len (data, length));
+	schedule = !job->streamQueue->scheduled;
+	job->streamQueue->scheduled = TRUE;
+	G_UNLOCK (streamQueues);
+
+	if (schedule)
+		g_thread_pool_push (parsePool, job, NULL);
+}
+
+/* Marks the download of a streamed job complete. The job is passed
+   on by the parse worker once it parsed all queued chunks. */
+static void
+update_stream_complete (updateJobPtr job)
+{
+	gboolean	schedule;
+
+	G_LOCK (streamQueues);
+	job->streamQueue->complete = TRUE;
+	schedule = !job->streamQueue->scheduled;
+	job->streamQueue->scheduled = TRUE;
+	G_UNLOCK (streamQueues);
+
+	if (schedule)
+		g_thread_pool_push (parsePool, job, NULL);
+}
+
+static void
+update_parse_stage_run (gpointer data, gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)data;
+	errorCtxtPtr	errors;
+
+	if (job->streamQueue) {
+		update_stream_stage_run (job);
+		return;
+	}
+
+	if (g_cancellable_is_cancelled (job->cancellable)) {
+		g_idle_add (update_process_result_idle_cb, job);
+		return;
+	}
+
+	debug1 (DEBUG_UPDATE, "parsing result of request (%s)", job->request->source);
+
+	/* Data that was not received in chunks (files, commands...)
+	   is passed to the streaming parser at once */
+	if (job->request->stream) {
+		xml_stream_parser_push (job->request->stream, job->result->data, job->result->size);
+		update_stream_finish (job);
+		g_idle_add (update_process_result_idle_cb, job);
+		return;
+	}
+
+	errors = g_new0 (struct errorCtxt, 1);
+	errors->msg = g_string_new (NULL);
+
+	job->result->doc = xml_parse (job->result->data, job->result->size, errors);
+	job->result->parseErrors = errors->msg;
+	job->result->parseErrorCount = errors->errorCount;
+	job->result->parsed = TRUE;
+	g_free (errors);
+
+	g_idle_add (update_process_result_idle_cb, job);
+}
+
+static void
+update_parse_stage (updateJobPtr job)
+{
+	/* Streamed downloads were parsed while being received... */
+	if (job->streamQueue) {
+		update_stream_complete (job);
+		return;
+	}
+
+	/* ...other results of requests asking for a DOM that do
+	   have data are passed to the parse workers... */
+	if (job->request->parseXml && job->result->data && job->result->size > 0 &&
+	    !g_cancellable_is_cancelled (job->cancellable)) {
+		g_thread_pool_push (parsePool, job, NULL);
+		return;
+	}
+
+	g_idle_add (update_process_result_idle_cb, job);
+}
+
+static void
+update_filter_stage_run (gpointer data, gpointer user_data)
+{
+	updateJobPtr	job = (updateJobPtr)data;
+
+	if (!g_cancellable_is_cancelled (job->cancellable)) {
+		debug1 (DEBUG_UPDATE, "filtering result of request (%s)", job->request->source);
+		update_apply_filter (job);
+	}
+
+	update_parse_stage (job);
+}
+
 void
 update_process_finished_job (updateJobPtr job)
 {
@@ -554,45 +1145,88 @@ update_process_finished_job (updateJobPtr job)
 	
 	g_assert(numberOfActiveJobs > 0);
 	numberOfActiveJobs--;
+	if (hosts)
+		update_host_job_finished (job);
 	g_idle_add (update_dequeue_job, NULL);
 
 	/* Handling abandoned requests (e.g. after feed deletion) */
 	if (job->callback == NULL) {	
 		debug1 (DEBUG_UPDATE, "freeing cancelled request (%s)", job->request->source);
-		update_job_free (job);
+
+		/* a parse worker may still use the job, it drops the
+		   queued chunks and passes the job on for freeing */
+		if (job->streamQueue)
+			update_stream_complete (job);
+		else
+			update_job_free (job);
 		return;
 	} 
 
-	/* Finally execute the postfilter */
-	if (job->result->data && job->request->filtercmd) 
-		update_apply_filter (job);
-		
-	g_idle_add (update_process_result_idle_cb, job);
+	/* Finally execute the postfilter and parse stages, filter
+	   commands are run as child processes serviced by the main loop */
+	if (job->result->data && job->request->filtercmd) {
+		if (update_filter_is_xslt (job->request->filtercmd))
+			g_thread_pool_push (filterPool, job, NULL);
+		else
+			update_exec_filter_cmd (job);
+	} else
+		update_parse_stage (job);
 }
 
-
 void
 update_init (void)
 {
-	pendingJobs = g_async_queue_new ();
-	pendingHighPrioJobs = g_async_queue_new ();
+	guint	maxFilterThreads, maxParseThreads;
+
+	jobs = g_hash_table_new (g_direct_hash, g_direct_equal);
+	jobsByOwner = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_slist_free);
+	hosts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)update_host_free);
+	hostRing = g_queue_new ();
+
+	maxActiveJobs = update_get_conf_uint (UPDATE_FETCH_CONCURRENCY, DEFAULT_MAX_ACTIVE_JOBS);
+	maxJobsPerHost = update_get_conf_uint (UPDATE_HOST_CONCURRENCY, DEFAULT_MAX_JOBS_PER_HOST);
+	network_set_max_conns_per_host (maxJobsPerHost);
+	maxFilterThreads = update_get_conf_uint (UPDATE_FILTER_CONCURRENCY, DEFAULT_MAX_FILTER_THREADS);
+	maxParseThreads = update_get_conf_uint (UPDATE_PARSE_CONCURRENCY, DEFAULT_MAX_PARSE_THREADS);
+
+	filterPool = g_thread_pool_new (update_filter_stage_run, NULL, maxFilterThreads, FALSE, NULL);
+	parsePool = g_thread_pool_new (update_parse_stage_run, NULL, maxParseThreads, FALSE, NULL);
+
+	debug4 (DEBUG_UPDATE, "update concurrency: %u downloads (%u per host), %u filter threads, %u parser threads", maxActiveJobs, maxJobsPerHost, maxFilterThreads, maxParseThreads);
 }
 
 void
 update_deinit (void)
 {
-	GSList	*iter = jobs;
+	GList	*allJobs, *iter;
 
 	/* Cancel all jobs, to avoid async callbacks accessing the GUI */
-	while (iter) {
-		updateJobPtr job = (updateJobPtr)iter->data;
-		job->callback = NULL;
-		iter = g_slist_next (iter);
+	update_job_cancel_all ();
+
+	/* Workers skip cancelled jobs, so the queued stage work is
+	   done quickly. The filter pool goes first as its tasks
+	   pass jobs on to the parse pool. */
+	g_thread_pool_free (filterPool, FALSE, TRUE);
+	g_thread_pool_free (parsePool, FALSE, TRUE);
+	filterPool = NULL;
+	parsePool = NULL;
+
+	/* The main loop won't run the result callbacks the workers
+	   scheduled anymore, so those jobs are freed here */
+	allJobs = g_hash_table_get_keys (jobs);
+	for (iter = allJobs; iter; iter = g_list_next (iter)) {
+		if (g_idle_remove_by_data (iter->data))
+			update_job_free ((updateJobPtr)iter->data);
 	}
+	g_list_free (allJobs);
 
-	g_async_queue_unref (pendingJobs);
-	g_async_queue_unref (pendingHighPrioJobs);
+	g_queue_free (hostRing);
+	g_hash_table_destroy (hosts);
+	hostRing = NULL;
+	hosts = NULL;
 	
-	g_slist_free (jobs);
+	g_hash_table_destroy (jobsByOwner);
+	g_hash_table_destroy (jobs);
+	jobsByOwner = NULL;
 	jobs = NULL;
 }
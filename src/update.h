@@ -24,6 +24,8 @@
 
 #include <time.h>
 #include <glib.h>
+#include <gio/gio.h>
+#include <libxml/tree.h>
 
 /* Update requests do represent feed updates, favicon and enclosure 
    downloads. A request can be started synchronously or asynchronously.
@@ -39,8 +41,32 @@
    
    Finally the request system has an on/offline state. When offline
    no new network requests are accepted. Filesystem and internal 
-   requests are still processed. Currently running downloads are 
-   not terminated. */
+   requests are still processed. 
+   
+   Cancelling a job (e.g. when going offline or removing a
+   subscription) drops it from its host queue if it is still
+   pending. Otherwise its download is aborted, its commands and
+   filters are killed and the filter and parse workers skip it.
+   The result callback of a cancelled job is never called. 
+   
+   Processing of a request is done in stages: fetching (network,
+   file or command), filtering (post processing filter) and parsing
+   (building the XML DOM if the request asks for it). XSLT filters
+   and the parse stage are run by bounded worker thread pools. 
+   Commands (sources and filters) are run as child processes whose
+   pipes are serviced by the main loop. Only the result callback
+   is executed in the main loop. 
+   
+   Requests with a streaming parser are parsed by it instead of
+   into a full DOM. Network data is queued while it is received
+   and passed to the parser by the parse workers, so parsing goes
+   along with the download. 
+   
+   Pending jobs are queued per host. Hosts are served round-robin,
+   each with a limited number of concurrent jobs, so that many
+   subscriptions of one host neither overload it nor delay the
+   subscriptions of other hosts. A host answering 429 or 503 is not
+   sent new requests until its Retry-After period is over. */
 
 typedef enum {
 	REQUEST_STATE_INITIALIZED = 0,	/**< request struct newly created */
@@ -76,9 +102,14 @@ typedef struct updateOptions {
 /** defines all state data an updatable object (e.g. a feed) needs */
 typedef struct updateState {
 	glong		lastModified;		/**< Last modified string as sent by the server */
+	gchar		*etag;			/**< ETag as sent by the server */
 	GTimeVal	lastPoll;		/**< time at which the feed was last updated */
 	GTimeVal	lastFaviconPoll;	/**< time at which the feeds favicon was last updated */
 	gchar		*cookies;		/**< cookies to be used */	
+	glong		maxAge;			/**< freshness lifetime from Cache-Control or Expires in seconds (0 if none) */
+	guint		unchangedCount;		/**< number of successive updates without new items */
+	glong		lastArrival;		/**< time new items were last found (0 if unknown) */
+	glong		arrivalInterval;	/**< smoothed interval between new item arrivals in seconds (0 if unknown) */
 } *updateStatePtr;
 
 /** structure describing a HTTP update request */
@@ -93,6 +124,8 @@ typedef struct updateRequest {
 	updateOptionsPtr options;	/**< Update options for the request */
 	gchar		*filtercmd;	/**< Command will filter output of URL */
 	updateStatePtr	updateState;	/**< Update state of the requested object (etags, last modified...) */
+	gboolean	parseXml;	/**< TRUE if the result is to be parsed into a DOM by the parse stage */
+	struct xmlStreamParser *stream;	/**< parser to use instead of building a full DOM (optional) */
 } *updateRequestPtr;
 
 /** structure to store results of the processing of an update request */
@@ -107,6 +140,13 @@ typedef struct updateResult {
 	gchar		*contentType;	/**< Content type of received data */
 	gchar		*filterErrors;	/**< Error messages from filter execution */
 	
+	gboolean	parsed;		/**< TRUE if the parse stage was run for this result */
+	xmlDocPtr	doc;		/**< DOM of the received data as built by the parse stage (or NULL) */
+	GString		*parseErrors;	/**< XML parser error messages of the parse stage (or NULL) */
+	gint		parseErrorCount;/**< number of XML parser errors of the parse stage */
+	struct xmlStreamParser *stream;	/**< the request's streaming parser if it built the DOM (or NULL) */
+	glong		retryAfter;	/**< seconds to wait before the next request to the host as given by Retry-After (0 if none) */
+	
 	updateStatePtr	updateState;	/**< New update state of the requested object (etags, last modified...) */
 } *updateResultPtr;
 
@@ -119,6 +159,11 @@ typedef struct updateJob {
 	gpointer		user_data;	/**< result processing user data */
 	updateFlags		flags;		/**< request and result processing flags */
 	gint			state;		/**< State of the job (enum request_state) */
+	GCancellable		*cancellable;	/**< cancelled with the job, aborts running commands and file reads */
+	guint			timeout;	/**< file read timeout source id (or 0) */
+	struct updateHost	*host;		/**< the host queue the job is dispatched from */
+	gint64			queuedAt;	/**< time the job was queued (in ms) */
+	struct updateStreamQueue *streamQueue;	/**< received data waiting for the streaming parser (or NULL) */
 } *updateJobPtr;
 
 /**
@@ -131,9 +176,15 @@ updateStatePtr update_state_new (void);
 glong update_state_get_lastmodified (updateStatePtr state);
 void update_state_set_lastmodified (updateStatePtr state, glong lastmodified);
 
+const gchar * update_state_get_etag (updateStatePtr state);
+void update_state_set_etag (updateStatePtr state, const gchar *etag);
+
 const gchar * update_state_get_cookies (updateStatePtr state);
 void update_state_set_cookies (updateStatePtr state, const gchar *cookies);
 
+glong update_state_get_max_age (updateStatePtr state);
+void update_state_set_max_age (updateStatePtr state, glong maxAge);
+
 /**
  * Copies the given update state.
  *
@@ -250,12 +301,32 @@ updateJobPtr update_execute_request (gpointer owner,
 void update_process_finished_job (updateJobPtr job);
 
 /**
- * Cancel all pending requests for the given owner.
+ * Queues received data for the streaming parser of the job's
+ * request. The data is parsed by a parse worker. Does nothing
+ * if the request has no streaming parser.
  *
- * @param owner		pointer passed in update_request_new()
+ * @param job		the update job
+ * @param data		the received data
+ * @param length	length of the data
+ */
+void update_job_push_chunk (updateJobPtr job, const gchar *data, gsize length);
+
+/**
+ * Cancels all requests of the given owner. Pending jobs are
+ * dropped, downloads are aborted and commands and filters are
+ * killed. The result callbacks of the jobs are not called.
+ *
+ * @param owner		pointer passed in update_execute_request()
  */
 void update_job_cancel_by_owner (gpointer owner);
 
+/**
+ * Cancels all requests like update_job_cancel_by_owner() does.
+ * Note that owners keeping a reference to their job need to be
+ * cancelled using update_job_cancel_by_owner() instead.
+ */
+void update_job_cancel_all (void);
+
 /**
  * Method to query the update state of currently processed jobs.
  *
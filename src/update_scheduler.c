@@ -0,0 +1,399 @@
+/**
+ * @file update_scheduler.c  deadline ordered subscription update scheduling
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "update_scheduler.h"
+
+#include "debug.h"
+#include "net_monitor.h"
+#include "node.h"
+#include "fl_sources/node_source.h"
+
+#define UPDATE_SCHEDULER_MAX_JITTER		60	/**< maximum random delay of a regular update (seconds) */
+#define UPDATE_SCHEDULER_OVERDUE_SPREAD		60	/**< period overdue updates are spread over (seconds) */
+#define UPDATE_SCHEDULER_SOURCE_DELAY		10	/**< delay of the first node source root check (seconds) */
+#define UPDATE_SCHEDULER_SOURCE_INTERVAL	60	/**< interval of node source root checks (seconds) */
+#define UPDATE_SCHEDULER_OFFLINE_RECHECK	60	/**< interval of online checks while offline (seconds) */
+
+typedef enum {
+	SCHEDULE_NONE,		/**< not updated automatically */
+	SCHEDULE_FEED,		/**< default source subscription updated by its interval */
+	SCHEDULE_SOURCE		/**< node source root asked periodically */
+} scheduleType;
+
+/** schedule state of a subscription */
+typedef struct scheduleEntry {
+	subscriptionPtr	subscription;
+	glong		due;		/**< due time in seconds since epoch */
+	gint		pos;		/**< position in the heap (-1 if not scheduled) */
+} *scheduleEntryPtr;
+
+static GPtrArray	*heap = NULL;		/**< min-heap of scheduled entries ordered by due time */
+static GHashTable	*entries = NULL;	/**< subscription -> scheduleEntryPtr of all known subscriptions */
+static guint		timer = 0;		/**< timer source of the earliest due time (or 0) */
+static glong		timerDue = 0;		/**< due time the timer was set for */
+static gboolean		started = FALSE;	/**< TRUE once update_scheduler_start() was called */
+
+static gboolean update_scheduler_dispatch_cb (gpointer user_data);
+
+/* heap handling */
+
+#define HEAP_ENTRY(pos) ((scheduleEntryPtr)g_ptr_array_index (heap, (pos)))
+
+static void
+update_scheduler_heap_set (guint pos, scheduleEntryPtr entry)
+{
+	g_ptr_array_index (heap, pos) = entry;
+	entry->pos = pos;
+}
+
+static void
+update_scheduler_sift_up (guint pos)
+{
+	scheduleEntryPtr	entry = HEAP_ENTRY (pos);
+
+	while (pos > 0) {
+		guint parent = (pos - 1) / 2;
+		if (HEAP_ENTRY (parent)->due <= entry->due)
+			break;
+		update_scheduler_heap_set (pos, HEAP_ENTRY (parent));
+		pos = parent;
+	}
+	update_scheduler_heap_set (pos, entry);
+}
+
+static void
+update_scheduler_sift_down (guint pos)
+{
+	scheduleEntryPtr	entry = HEAP_ENTRY (pos);
+	guint			child;
+
+	while ((child = 2 * pos + 1) < heap->len) {
+		if ((child + 1 < heap->len) && (HEAP_ENTRY (child + 1)->due < HEAP_ENTRY (child)->due))
+			child++;
+		if (entry->due <= HEAP_ENTRY (child)->due)
+			break;
+		update_scheduler_heap_set (pos, HEAP_ENTRY (child));
+		pos = child;
+	}
+	update_scheduler_heap_set (pos, entry);
+}
+
+static void
+update_scheduler_heap_remove (scheduleEntryPtr entry)
+{
+	scheduleEntryPtr	last;
+	guint			pos;
+
+	if (entry->pos < 0)
+		return;
+
+	pos = entry->pos;
+	last = g_ptr_array_remove_index (heap, heap->len - 1);
+	entry->pos = -1;
+	if (last != entry) {
+		update_scheduler_heap_set (pos, last);
+		update_scheduler_sift_up (pos);
+		update_scheduler_sift_down (last->pos);
+	}
+}
+
+/* timer handling */
+
+static void
+update_scheduler_arm (void)
+{
+	GTimeVal	now;
+	glong		due;
+
+	if (!started)
+		return;
+
+	if (0 == heap->len) {
+		if (timer)
+			g_source_remove (timer);
+		timer = 0;
+		return;
+	}
+
+	due = HEAP_ENTRY (0)->due;
+	if (timer && (timerDue == due))
+		return;
+
+	if (timer)
+		g_source_remove (timer);
+
+	g_get_current_time (&now);
+	timerDue = due;
+	timer = g_timeout_add_seconds ((due > now.tv_sec)?(due - now.tv_sec):0, update_scheduler_dispatch_cb, NULL);
+}
+
+static void
+update_scheduler_set_due (scheduleEntryPtr entry, glong due)
+{
+	entry->due = due;
+	if (entry->pos < 0) {
+		g_ptr_array_add (heap, entry);
+		update_scheduler_sift_up (heap->len - 1);
+	} else {
+		update_scheduler_sift_up (entry->pos);
+		update_scheduler_sift_down (entry->pos);
+	}
+
+	update_scheduler_arm ();
+}
+
+/* scheduling */
+
+static void
+update_scheduler_init_tables (void)
+{
+	if (entries)
+		return;
+
+	heap = g_ptr_array_new ();
+	entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+}
+
+static scheduleType
+update_scheduler_get_type (subscriptionPtr subscription)
+{
+	nodePtr	node = subscription->node;
+
+	if (!node || !node->source || !node->source->root)
+		return SCHEDULE_NONE;
+
+	/* Node source roots (except the feed list root) */
+	if (node->source->root == node)
+		return (NODE_SOURCE_TYPE (node)->capabilities & NODE_SOURCE_CAPABILITY_IS_ROOT)?SCHEDULE_NONE:SCHEDULE_SOURCE;
+
+	/* Subscriptions of other node sources are updated by the source */
+	if (NODE_SOURCE_TYPE (node->source->root)->capabilities & NODE_SOURCE_CAPABILITY_IS_ROOT)
+		return SCHEDULE_FEED;
+
+	return SCHEDULE_NONE;
+}
+
+/* Returns the update interval of a subscription in seconds
+   or 0 if it is not to be updated automatically */
+static glong
+update_scheduler_get_interval (subscriptionPtr subscription)
+{
+	if (subscription->discontinued)
+		return 0;
+
+	return subscription_get_auto_update_interval (subscription, NULL) * 60;
+}
+
+static glong
+update_scheduler_jitter (glong max)
+{
+	if (max <= 0)
+		return 0;
+
+	return g_random_int_range (0, max + 1);
+}
+
+void
+update_scheduler_schedule (subscriptionPtr subscription)
+{
+	scheduleEntryPtr	entry;
+	scheduleType		type;
+	GTimeVal		now;
+	glong			interval, due;
+
+	if (!subscription)
+		return;
+
+	type = update_scheduler_get_type (subscription);
+	if (SCHEDULE_NONE == type) {
+		update_scheduler_remove (subscription);
+		return;
+	}
+
+	update_scheduler_init_tables ();
+	entry = g_hash_table_lookup (entries, subscription);
+	if (!entry) {
+		entry = g_new0 (struct scheduleEntry, 1);
+		entry->subscription = subscription;
+		entry->pos = -1;
+		g_hash_table_insert (entries, subscription, entry);
+	}
+
+	g_get_current_time (&now);
+
+	/* Node sources check on their own when to update */
+	if (SCHEDULE_SOURCE == type) {
+		if (entry->pos < 0)
+			update_scheduler_set_due (entry, now.tv_sec + UPDATE_SCHEDULER_SOURCE_DELAY);
+		return;
+	}
+
+	interval = update_scheduler_get_interval (subscription);
+	if (!interval) {
+		/* keep it known for update_scheduler_reschedule_all() */
+		update_scheduler_heap_remove (entry);
+		update_scheduler_arm ();
+		return;
+	}
+
+	due = subscription->updateState->lastPoll.tv_sec + interval + update_scheduler_jitter (MIN (interval / 20, UPDATE_SCHEDULER_MAX_JITTER));
+	if (due < now.tv_sec)
+		due = now.tv_sec + update_scheduler_jitter (UPDATE_SCHEDULER_OVERDUE_SPREAD);
+
+	update_scheduler_set_due (entry, due);
+}
+
+void
+update_scheduler_remove (subscriptionPtr subscription)
+{
+	scheduleEntryPtr	entry;
+
+	if (!entries)
+		return;
+
+	entry = g_hash_table_lookup (entries, subscription);
+	if (!entry)
+		return;
+
+	update_scheduler_heap_remove (entry);
+	g_hash_table_remove (entries, subscription);
+	update_scheduler_arm ();
+}
+
+void
+update_scheduler_reschedule_all (void)
+{
+	GList	*subscriptions, *iter;
+
+	if (!entries)
+		return;
+
+	subscriptions = g_hash_table_get_keys (entries);
+	for (iter = subscriptions; iter; iter = g_list_next (iter))
+		update_scheduler_schedule ((subscriptionPtr)iter->data);
+	g_list_free (subscriptions);
+}
+
+glong
+update_scheduler_get_due_time (subscriptionPtr subscription)
+{
+	scheduleEntryPtr	entry = NULL;
+
+	if (entries)
+		entry = g_hash_table_lookup (entries, subscription);
+
+	return (entry && entry->pos >= 0)?entry->due:0;
+}
+
+/* dispatching */
+
+static void
+update_scheduler_run (subscriptionPtr subscription, glong now)
+{
+	scheduleEntryPtr	entry;
+	nodePtr			node = subscription->node;
+	glong			interval;
+
+	if (node->source->root == node) {
+		node_source_auto_update (node);
+
+		entry = g_hash_table_lookup (entries, subscription);
+		if (entry)
+			update_scheduler_set_due (entry, now + UPDATE_SCHEDULER_SOURCE_INTERVAL);
+		return;
+	}
+
+	subscription_auto_update (subscription);
+
+	/* Starting the update reschedules the subscription,
+	   if it did not start try again after the interval */
+	entry = g_hash_table_lookup (entries, subscription);
+	if (entry && (entry->pos < 0)) {
+		interval = update_scheduler_get_interval (subscription);
+		if (interval)
+			update_scheduler_set_due (entry, now + interval);
+	}
+}
+
+static gboolean
+update_scheduler_dispatch_cb (gpointer user_data)
+{
+	GSList		*due = NULL, *iter;
+	GTimeVal	now;
+
+	timer = 0;
+	g_get_current_time (&now);
+
+	if (!network_monitor_is_online ()) {
+		debug0 (DEBUG_UPDATE, "no update processing because we are offline!");
+		timerDue = now.tv_sec + UPDATE_SCHEDULER_OFFLINE_RECHECK;
+		timer = g_timeout_add_seconds (UPDATE_SCHEDULER_OFFLINE_RECHECK, update_scheduler_dispatch_cb, NULL);
+		return FALSE;
+	}
+
+	/* Take all due entries first as running them reschedules them */
+	while (heap->len > 0 && HEAP_ENTRY (0)->due <= now.tv_sec) {
+		scheduleEntryPtr entry = HEAP_ENTRY (0);
+		update_scheduler_heap_remove (entry);
+		due = g_slist_prepend (due, entry->subscription);
+	}
+	due = g_slist_reverse (due);
+
+	debug1 (DEBUG_UPDATE, "%u scheduled subscription updates are due", g_slist_length (due));
+
+	for (iter = due; iter; iter = g_slist_next (iter)) {
+		/* skip subscriptions removed while running the others */
+		if (g_hash_table_lookup (entries, iter->data))
+			update_scheduler_run ((subscriptionPtr)iter->data, now.tv_sec);
+	}
+	g_slist_free (due);
+
+	update_scheduler_arm ();
+
+	return FALSE;
+}
+
+void
+update_scheduler_start (void)
+{
+	update_scheduler_init_tables ();
+	started = TRUE;
+
+	debug1 (DEBUG_UPDATE, "update scheduler started with %u scheduled subscriptions", heap->len);
+
+	update_scheduler_arm ();
+}
+
+void
+update_scheduler_stop (void)
+{
+	if (timer)
+		g_source_remove (timer);
+	timer = 0;
+	started = FALSE;
+
+	if (!entries)
+		return;
+
+	g_hash_table_destroy (entries);
+	g_ptr_array_free (heap, TRUE);
+	entries = NULL;
+	heap = NULL;
+}
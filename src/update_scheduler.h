@@ -0,0 +1,87 @@
+/**
+ * @file update_scheduler.h  deadline ordered subscription update scheduling
+ *
+ * Copyright (C) 2012 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _UPDATE_SCHEDULER_H
+#define _UPDATE_SCHEDULER_H
+
+#include <glib.h>
+
+#include "subscription.h"
+
+/* The update scheduler keeps all automatically updated subscriptions
+   in a min-heap ordered by the time their next update is due. A single
+   timer is set to the earliest due time, so the feed list is never
+   walked periodically and nothing runs while no update is due.
+
+   Due times get a random jitter so that subscriptions with the same
+   interval or last poll time do not all fire at once. Overdue
+   subscriptions (e.g. after being offline) are spread over a short
+   period instead of being updated all at the same moment.
+
+   Subscriptions of the default feed list source are scheduled by their
+   update interval. Roots of other node sources decide on their own
+   whether to update and are just asked to do so once a minute. */
+
+/**
+ * Starts the scheduler timer. To be called once the feed list
+ * is loaded and all subscriptions were scheduled.
+ */
+void update_scheduler_start (void);
+
+/**
+ * Stops the scheduler and forgets all subscriptions.
+ */
+void update_scheduler_stop (void);
+
+/**
+ * (Re)calculates the next update time of the given subscription
+ * from its last poll time and update interval. Subscriptions that
+ * are not to be updated automatically are removed from the schedule.
+ * To be called whenever one of those values changes.
+ *
+ * @param subscription	the subscription
+ */
+void update_scheduler_schedule (subscriptionPtr subscription);
+
+/**
+ * Removes the given subscription from the schedule.
+ *
+ * @param subscription	the subscription
+ */
+void update_scheduler_remove (subscriptionPtr subscription);
+
+/**
+ * Recalculates the next update time of all known subscriptions.
+ * To be called when the default update interval changes or when
+ * going online.
+ */
+void update_scheduler_reschedule_all (void);
+
+/**
+ * Returns the time the next automatic update of the given
+ * subscription is due.
+ *
+ * @param subscription	the subscription
+ *
+ * @returns due time in seconds since epoch (0 if not scheduled)
+ */
+glong update_scheduler_get_due_time (subscriptionPtr subscription);
+
+#endif
@@ -18,6 +18,8 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <string.h>
+
 #include "vfolder.h"
 
 #include "common.h"
@@ -44,6 +46,8 @@ vfolder_new (nodePtr node)
 	debug_enter ("vfolder_new");
 
 	vfolder = g_new0 (struct vfolder, 1);
+	vfolder->members = g_hash_table_new (g_direct_hash, g_direct_equal);
+	vfolder->links = g_hash_table_new (g_direct_hash, g_direct_equal);
 	vfolder->itemset = g_new0 (struct itemSet, 1);
 	vfolder->itemset->nodeId = node->id;
 	vfolder->itemset->ids = NULL;
@@ -142,37 +146,245 @@ vfolder_foreach_data (vfolderActionDataFunc func, itemPtr item)
 	}
 }
 
-void
-vfolder_remove_item (vfolderPtr vfolder, itemPtr item)
+gboolean
+vfolder_has_item_id (vfolderPtr vfolder, gulong id)
+{
+	return (NULL != g_hash_table_lookup (vfolder->members, GUINT_TO_POINTER (id)));
+}
+
+/* rebuilds the membership set after the id list was replaced,
+   the unread ids are fetched from the DB in a single query */
+static void
+vfolder_index_members (vfolderPtr vfolder)
 {
-	if (!vfolder->itemset->ids)
+	GList	*unread, *iter;
+
+	g_hash_table_remove_all (vfolder->members);
+	g_hash_table_remove_all (vfolder->links);
+	vfolder->unreadCount = 0;
+
+	iter = vfolder->itemset->ids;
+	while (iter) {
+		g_hash_table_insert (vfolder->members, iter->data, GUINT_TO_POINTER (VFOLDER_MEMBER_READ));
+		g_hash_table_insert (vfolder->links, iter->data, iter);
+		iter = g_list_next (iter);
+	}
+
+	unread = iter = db_search_folder_load_unread (vfolder->node->id);
+	while (iter) {
+		if (g_hash_table_lookup (vfolder->members, iter->data)) {
+			g_hash_table_insert (vfolder->members, iter->data, GUINT_TO_POINTER (VFOLDER_MEMBER_UNREAD));
+			vfolder->unreadCount++;
+		}
+		iter = g_list_next (iter);
+	}
+	g_list_free (unread);
+}
+
+/* syncs the stored read state of a member with the given item */
+static void
+vfolder_update_member (vfolderPtr vfolder, itemPtr item)
+{
+	vfolderMemberState	state, newState;
+
+	state = GPOINTER_TO_UINT (g_hash_table_lookup (vfolder->members, GUINT_TO_POINTER (item->id)));
+	if (!state)
 		return;
-		
-	vfolder->itemset->ids = g_list_remove (vfolder->itemset->ids, GUINT_TO_POINTER (item->id));
+
+	newState = item->readStatus?VFOLDER_MEMBER_READ:VFOLDER_MEMBER_UNREAD;
+	if (state == newState)
+		return;
+
+	g_hash_table_insert (vfolder->members, GUINT_TO_POINTER (item->id), GUINT_TO_POINTER (newState));
+	if (VFOLDER_MEMBER_UNREAD == newState)
+		vfolder->unreadCount++;
+	else
+		vfolder->unreadCount--;
+	vfolder->node->needsUpdate = TRUE;
+}
+
+/* drops a member using its stored list link, so no list search is needed */
+static void
+vfolder_remove_member (vfolderPtr vfolder, gpointer id)
+{
+	vfolderMemberState	state;
+	GList			*link;
+
+	state = GPOINTER_TO_UINT (g_hash_table_lookup (vfolder->members, id));
+	if (!state)
+		return;
+
+	g_hash_table_remove (vfolder->members, id);
+	if (VFOLDER_MEMBER_UNREAD == state)
+		vfolder->unreadCount--;
+
+	link = g_hash_table_lookup (vfolder->links, id);
+	g_hash_table_remove (vfolder->links, id);
+	vfolder->itemset->ids = g_list_delete_link (vfolder->itemset->ids, link);
 	vfolder->node->needsUpdate = TRUE;
 }
 
+void
+vfolder_remove_item (vfolderPtr vfolder, itemPtr item)
+{
+	vfolder_remove_member (vfolder, GUINT_TO_POINTER (item->id));
+}
+
 void
 vfolder_add_item (vfolderPtr vfolder, itemPtr item)
 {
-	vfolder->itemset->ids = g_list_append (vfolder->itemset->ids, GUINT_TO_POINTER (item->id));
+	if (vfolder_has_item_id (vfolder, item->id))
+		return;
+
+	if (item->readStatus) {
+		g_hash_table_insert (vfolder->members, GUINT_TO_POINTER (item->id), GUINT_TO_POINTER (VFOLDER_MEMBER_READ));
+	} else {
+		g_hash_table_insert (vfolder->members, GUINT_TO_POINTER (item->id), GUINT_TO_POINTER (VFOLDER_MEMBER_UNREAD));
+		vfolder->unreadCount++;
+	}
+	vfolder->itemset->ids = g_list_prepend (vfolder->itemset->ids, GUINT_TO_POINTER (item->id));
+	g_hash_table_insert (vfolder->links, GUINT_TO_POINTER (item->id), vfolder->itemset->ids);
 	vfolder->node->needsUpdate = TRUE;
 }
 
 void
 vfolder_merge_item (vfolderPtr vfolder, itemPtr item)
 {
-	gboolean found = itemset_has_item_id (vfolder->itemset, item->id);
+	gboolean found = vfolder_has_item_id (vfolder, item->id);
 
 	if (itemset_check_item (vfolder->itemset, item)) {
 		if (!found)
 			vfolder_add_item (vfolder, item);
+		else
+			vfolder_update_member (vfolder, item);
 	} else {
 		if (found)
 			vfolder_remove_item (vfolder, item);
 	}
 }
 
+void
+vfolder_item_changed (itemPtr item, guint fields)
+{
+	GSList	*iter = vfolders;
+
+	while (iter) {
+		vfolderPtr vfolder = (vfolderPtr)iter->data;
+
+		/* Only folders with rules looking at the changed fields
+		   can change their membership. All others just need
+		   their unread counter to be kept in sync. */
+		if (itemset_get_rule_fields (vfolder->itemset) & fields)
+			vfolder_merge_item (vfolder, item);
+		else
+			vfolder_update_member (vfolder, item);
+		iter = g_slist_next (iter);
+	}
+}
+
+/* number of items loaded at once when re-checking read members */
+#define VFOLDER_READ_BATCH_SIZE	100
+
+/* re-checks the given members against the rules of the search folder,
+   the items are loaded from the DB in batches */
+static void
+vfolder_merge_item_ids (vfolderPtr vfolder, GArray *ids)
+{
+	GSList	*items, *iter;
+	guint	i;
+
+	for (i = 0; i < ids->len; i += VFOLDER_READ_BATCH_SIZE) {
+		items = db_items_load_many (&g_array_index (ids, gulong, i), MIN (ids->len - i, VFOLDER_READ_BATCH_SIZE));
+		for (iter = items; iter; iter = g_slist_next (iter)) {
+			vfolder_merge_item (vfolder, (itemPtr)iter->data);
+			item_unload ((itemPtr)iter->data);
+		}
+		g_slist_free (items);
+	}
+}
+
+void
+vfolder_items_read (GSList *ids)
+{
+	GSList	*iter = vfolders;
+	GArray	*reevaluateIds = g_array_new (FALSE, FALSE, sizeof (gulong));
+
+	while (iter) {
+		vfolderPtr	vfolder = (vfolderPtr)iter->data;
+		guint		fields = itemset_get_rule_fields (vfolder->itemset);
+		gboolean	keepRead = TRUE;
+		GSList		*idIter;
+
+		/* Rules looking at nothing but the read status give the
+		   same result for all read items, so check a read dummy
+		   item once instead of loading the items. */
+		if (RULE_FIELD_READ == fields) {
+			struct item readItem;
+
+			memset (&readItem, 0, sizeof (readItem));
+			readItem.readStatus = TRUE;
+			keepRead = itemset_check_item (vfolder->itemset, &readItem);
+		}
+
+		g_array_set_size (reevaluateIds, 0);
+		for (idIter = ids; idIter; idIter = g_slist_next (idIter)) {
+			vfolderMemberState state = GPOINTER_TO_UINT (g_hash_table_lookup (vfolder->members, idIter->data));
+
+			if (VFOLDER_MEMBER_UNREAD != state)
+				continue;
+
+			if ((fields & RULE_FIELD_READ) && (RULE_FIELD_READ != fields)) {
+				gulong id = GPOINTER_TO_UINT (idIter->data);
+				g_array_append_val (reevaluateIds, id);
+			} else if (!keepRead) {
+				vfolder_remove_member (vfolder, idIter->data);
+			} else {
+				g_hash_table_insert (vfolder->members, idIter->data, GUINT_TO_POINTER (VFOLDER_MEMBER_READ));
+				vfolder->unreadCount--;
+				vfolder->node->needsUpdate = TRUE;
+			}
+		}
+
+		if (reevaluateIds->len)
+			vfolder_merge_item_ids (vfolder, reevaluateIds);
+
+		iter = g_slist_next (iter);
+	}
+
+	g_array_free (reevaluateIds, TRUE);
+}
+
+void
+vfolder_items_removed (const gulong *ids, guint count)
+{
+	GSList		*iter = vfolders;
+	GHashTable	*removed;
+	guint		i;
+
+	if (!count)
+		return;
+
+	removed = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < count; i++)
+		g_hash_table_insert (removed, GUINT_TO_POINTER (ids[i]), GUINT_TO_POINTER (1));
+
+	while (iter) {
+		vfolderPtr	vfolder = (vfolderPtr)iter->data;
+		GList		*idIter, *next;
+
+		/* filter the member list in a single pass instead of
+		   searching it once for every removed id */
+		for (idIter = vfolder->itemset->ids; idIter; idIter = next) {
+			next = g_list_next (idIter);
+			if (g_hash_table_lookup (removed, idIter->data))
+				vfolder_remove_member (vfolder, idIter->data);
+		}
+		iter = g_slist_next (iter);
+	}
+
+	g_hash_table_destroy (removed);
+}
+
 GSList *
 vfolder_get_all_with_item_id (gulong id)
 {
@@ -181,7 +393,7 @@ vfolder_get_all_with_item_id (gulong id)
 	
 	while (iter) {
 		vfolderPtr vfolder = (vfolderPtr)iter->data;
-		if (g_list_find (vfolder->itemset->ids, GUINT_TO_POINTER (id)))
+		if (vfolder_has_item_id (vfolder, id))
 			result = g_slist_append (result, vfolder);
 		iter = g_slist_next (iter);
 	}
@@ -200,7 +412,9 @@ vfolder_import (nodePtr node,
 	debug1 (DEBUG_CACHE, "import vfolder: title=%s", node_get_title (node));
 
 	vfolder = vfolder_new (node);
+	itemset_free (vfolder->itemset);
 	vfolder->itemset = db_search_folder_load (node->id);
+	vfolder_index_members (vfolder);
 	
 	vfolder_import_rules (cur, vfolder);
 }
@@ -249,6 +463,9 @@ vfolder_reset (vfolderPtr vfolder)
 
 	g_list_free (vfolder->itemset->ids);
 	vfolder->itemset->ids = NULL;
+	g_hash_table_remove_all (vfolder->members);
+	g_hash_table_remove_all (vfolder->links);
+	vfolder->unreadCount = 0;
 	db_search_folder_reset (vfolder->node->id);
 }
 
@@ -270,6 +487,9 @@ vfolder_free (nodePtr node)
 	
 	vfolders = g_slist_remove (vfolders, vfolder);
 	itemset_free (vfolder->itemset);
+	g_hash_table_destroy (vfolder->members);
+	g_hash_table_destroy (vfolder->links);
+	g_list_free (vfolder->loaderIds);
 		
 	debug_exit ("vfolder_free");
 }
@@ -283,12 +503,11 @@ vfolder_update_counters (nodePtr node)
 {
 	vfolderPtr vfolder = (vfolderPtr) node->data;
 	
-	/* There is no unread handling for search folders
-	   for performance reasons. So set everything to 0 
-	   here and don't bother with GUI updates... */
+	/* Both counters are maintained incrementally on
+	   each membership and read state change. */
 	vfolder->node->needsUpdate = TRUE;
-	vfolder->node->unreadCount = 0;
-	vfolder->node->itemCount = g_list_length (vfolder->itemset->ids);
+	vfolder->node->unreadCount = vfolder->unreadCount;
+	vfolder->node->itemCount = g_hash_table_size (vfolder->members);
 }
 
 static void
@@ -320,6 +539,7 @@ vfolder_get_node_type (void)
 { 
 	static struct nodeType nti = {
 		NODE_CAPABILITY_SHOW_ITEM_FAVICONS |
+		NODE_CAPABILITY_SHOW_UNREAD_COUNT |
 		NODE_CAPABILITY_SHOW_ITEM_COUNT,
 		"vfolder",
 		NULL,
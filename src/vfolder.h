@@ -35,14 +35,25 @@
    GUI wise a search folder is a type of node in the subscription list.
 */
 
+/** read state of a search folder member as stored in the member set */
+typedef enum {
+	VFOLDER_MEMBER_READ = 1,	/**< member item is read */
+	VFOLDER_MEMBER_UNREAD		/**< member item is unread */
+} vfolderMemberState;
+
 /** search folder data structure */
 typedef struct vfolder {
 	struct node	*node;		/**< the feed list node of this search folder */
 	
 	itemSetPtr	itemset;	/**< the itemset with the rules and matching items */
+	GHashTable	*members;	/**< item ids in itemset->ids mapped to their read state (see vfolderMemberState) */
+	GHashTable	*links;		/**< item ids mapped to their link in itemset->ids for constant time removal */
+	guint		unreadCount;	/**< number of unread members, kept in sync with the members states */
 
 	gboolean	reloading;	/**< if the search folder is in async reloading */
 	gulong		maxLoadedId;	/**< when in reloading maximum scanned id so far */
+	gboolean	queryLoading;	/**< when in reloading TRUE if matching ids were fetched by an SQL query */
+	GList		*loaderIds;	/**< when in query reloading the matching ids still to be loaded */
 } *vfolderPtr;
 
 /**
@@ -71,6 +82,16 @@ typedef void 	(*vfolderActionDataFunc)	(vfolderPtr vfolder, itemPtr item);
  */
 void vfolder_foreach_data (vfolderActionDataFunc func, itemPtr item);
 
+/**
+ * Checks wether the given item is a member of the search folder.
+ *
+ * @param vfolder	search folder
+ * @param id		the item id
+ *
+ * @returns TRUE if the item is a member
+ */
+gboolean vfolder_has_item_id (vfolderPtr vfolder, gulong id);
+
 /**
  * Method to remove an item from a search folder.
  *
@@ -96,6 +117,35 @@ void vfolder_add_item (vfolderPtr vfolder, itemPtr item);
  */
 void vfolder_merge_item (vfolderPtr vfolder, itemPtr item);
 
+/**
+ * Re-evaluates the given item against all search folders whose
+ * rules depend on at least one of the given changed item fields.
+ * Updates the unread counters of all search folders containing
+ * the item.
+ *
+ * @param item		the changed item
+ * @param fields	the changed item fields (see ruleFields)
+ */
+void vfolder_item_changed (itemPtr item, guint fields);
+
+/**
+ * Updates all search folders after the given items were marked
+ * read in the DB. Items are only loaded for search folders whose
+ * rules depend on the read state.
+ *
+ * @param ids		list of item ids
+ */
+void vfolder_items_read (GSList *ids);
+
+/**
+ * Removes the given items from all search folders after
+ * they were removed from the DB.
+ *
+ * @param ids		array of item ids
+ * @param count		number of item ids
+ */
+void vfolder_items_removed (const gulong *ids, guint count);
+
 /**
  * Returns a list of all search folders currently matching
  * the given item id.
@@ -28,32 +28,97 @@
 
 #define VFOLDER_LOADER_BATCH_SIZE 	100
 
+/* Search folders whose rules can be compiled to SQL get their
+   candidate item ids from a single (full text indexed) query and
+   only load and check those. Otherwise all items are scanned in
+   batches. Either way the loaded items are checked against the
+   rules in memory, so that the result is the same as for items
+   added to the search folder later. */
+
+/* Returns the given items that match the search folder rules
+   and unloads the others. */
+static GSList *
+vfolder_loader_check_items (vfolderPtr vfolder, GSList *loaded)
+{
+	GSList	*iter, *result = NULL;
+
+	for (iter = loaded; iter; iter = g_slist_next (iter)) {
+		itemPtr	item = (itemPtr)iter->data;
+		if (itemset_check_item (vfolder->itemset, item))
+			result = g_slist_prepend (result, item);
+		else
+			item_unload (item);
+	}
+	g_slist_free (loaded);
+
+	return g_slist_reverse (result);
+}
+
+static void
+vfolder_loader_add_members (vfolderPtr vfolder, GSList *items)
+{
+	while (items) {
+		vfolder_add_item (vfolder, (itemPtr)items->data);
+		items = g_slist_next (items);
+	}
+}
+
+static gboolean
+vfolder_loader_query_fetch_cb (gpointer user_data, GSList **resultItems)
+{
+	vfolderPtr	vfolder = (vfolderPtr)user_data;
+	gulong		ids[VFOLDER_LOADER_BATCH_SIZE];
+	guint		count;
+
+	/* The item loader drops results of the last fetch,
+	   so finish only once all ids were delivered */
+	if (!vfolder->loaderIds) {
+		debug1 (DEBUG_CACHE, "search folder '%s' reload complete", vfolder->node->title);
+		vfolder->reloading = FALSE;
+		vfolder->queryLoading = FALSE;
+		return FALSE;
+	}
+
+	for (count = 0; vfolder->loaderIds && (count < VFOLDER_LOADER_BATCH_SIZE); count++) {
+		ids[count] = GPOINTER_TO_UINT (vfolder->loaderIds->data);
+		vfolder->loaderIds = g_list_delete_link (vfolder->loaderIds, vfolder->loaderIds);
+	}
+	*resultItems = vfolder_loader_check_items (vfolder, db_items_load_many (ids, count));
+
+	vfolder_loader_add_members (vfolder, *resultItems);
+
+	/* Save items to DB (except for search results) */
+	if (vfolder->node)
+		db_search_folder_add_items (vfolder->node->id, *resultItems);
+
+	return TRUE;
+}
+
 static gboolean
 vfolder_loader_fetch_cb (gpointer user_data, GSList **resultItems)
 {
 	vfolderPtr	vfolder = (vfolderPtr)user_data;
-	itemSetPtr	items = g_new0 (struct itemSet, 1);
+	itemSetPtr	items;
 	GList		*iter;
+	gulong		ids[VFOLDER_LOADER_BATCH_SIZE];
+	guint		count = 0;
 	gboolean	result;
 
+	if (vfolder->queryLoading)
+		return vfolder_loader_query_fetch_cb (user_data, resultItems);
+
+	items = g_new0 (struct itemSet, 1);
+
 	/* 1. Fetch a batch of items */
 	result = db_itemset_get (items, vfolder->maxLoadedId, VFOLDER_LOADER_BATCH_SIZE);
 	vfolder->maxLoadedId += VFOLDER_LOADER_BATCH_SIZE;
 
 	if (result) {
 		/* 2. Match all items against search folder */
-		iter = items->ids;
-		while (iter) {
-			gulong id = GPOINTER_TO_UINT (iter->data);
-
-			itemPtr	item = db_item_load (id);
-			if (itemset_check_item (vfolder->itemset, item))
-				*resultItems = g_slist_append (*resultItems, item);
-			else
-				item_unload (item);
-
-			iter = g_list_next (iter);
-		}
+		for (iter = items->ids; iter && (count < VFOLDER_LOADER_BATCH_SIZE); iter = g_list_next (iter))
+			ids[count++] = GPOINTER_TO_UINT (iter->data);
+
+		*resultItems = vfolder_loader_check_items (vfolder, db_items_load_many (ids, count));
 	} else {
 		debug1 (DEBUG_CACHE, "search folder '%s' reload complete", vfolder->node->title);
 		vfolder->reloading = FALSE;
@@ -61,6 +126,8 @@ vfolder_loader_fetch_cb (gpointer user_data, GSList **resultItems)
 
 	itemset_free (items);
 
+	vfolder_loader_add_members (vfolder, *resultItems);
+
 	/* 3. Save items to DB (except for search results) */
 	if (vfolder->node)
 		db_search_folder_add_items (vfolder->node->id, *resultItems);
@@ -71,7 +138,8 @@ vfolder_loader_fetch_cb (gpointer user_data, GSList **resultItems)
 ItemLoader *
 vfolder_loader_new (nodePtr node) 
 {
-	vfolderPtr vfolder = (vfolderPtr)node->data;
+	vfolderPtr	vfolder = (vfolderPtr)node->data;
+	gchar		*sql;
 
 	if(vfolder->reloading) {
 		debug1 (DEBUG_CACHE, "search folder '%s' still reloading", node->title);
@@ -83,5 +151,17 @@ vfolder_loader_new (nodePtr node)
 	vfolder->reloading = TRUE;
 	vfolder->maxLoadedId = 0;
 
+	g_list_free (vfolder->loaderIds);
+	vfolder->loaderIds = NULL;
+	vfolder->queryLoading = FALSE;
+
+	sql = itemset_to_sql (vfolder->itemset);
+	if (sql) {
+		debug2 (DEBUG_CACHE, "search folder '%s' uses query: %s", node->title, sql);
+		vfolder->loaderIds = db_itemset_query (sql);
+		vfolder->queryLoading = TRUE;
+		g_free (sql);
+	}
+
         return item_loader_new (vfolder_loader_fetch_cb, node, vfolder);
 }
@@ -31,9 +31,11 @@
 #include <libxml/entities.h>
 #include <libxml/HTMLparser.h>
 #include <libxml/xpath.h>
+#include <libxml/SAX2.h>
 
 #include "common.h"
 #include "debug.h"
+#include "update.h"
 
 static void xml_buffer_parse_error(void *ctxt, const gchar * msg, ...);
 
@@ -301,6 +303,359 @@ xhtml_strip_unsupported_tags (const gchar *html)
 	return xhtml_strip(html, unsupported_tag_strippers);
 }
 
+/* single pass sanitizer */
+
+typedef struct xhtmlTag {
+	const gchar	*name;		/**< tag name in the sanitized string */
+	gsize		length;		/**< length of the tag name */
+} xhtmlTag;
+
+static inline gboolean
+xhtml_is_name_start_char (gchar c)
+{
+	return g_ascii_isalpha (c) || ('_' == c) || (':' == c) || (c & 0x80);
+}
+
+static inline gboolean
+xhtml_is_name_char (gchar c)
+{
+	return xhtml_is_name_start_char (c) || g_ascii_isdigit (c) || ('-' == c) || ('.' == c);
+}
+
+/* Returns the length of the XML name starting at p (0 if there is none) */
+static gsize
+xhtml_scan_name (const gchar *p)
+{
+	const gchar	*start = p;
+
+	if (!xhtml_is_name_start_char (*p))
+		return 0;
+
+	while (xhtml_is_name_char (*p))
+		p++;
+
+	return p - start;
+}
+
+/* Returns the length of the character or entity reference starting
+   with the '&' at p (0 if it is not a valid reference). Besides the
+   predefined XML entities the HTML entities are accepted just like
+   xml_process_entities() does when parsing. */
+static gsize
+xhtml_scan_reference (const gchar *p)
+{
+	const gchar	*start = p++;
+	gchar		name[16];
+	gsize		len;
+
+	if ('#' == *p) {
+		p++;
+		if ('x' == *p) {
+			p++;
+			if (!g_ascii_isxdigit (*p))
+				return 0;
+			while (g_ascii_isxdigit (*p))
+				p++;
+		} else {
+			if (!g_ascii_isdigit (*p))
+				return 0;
+			while (g_ascii_isdigit (*p))
+				p++;
+		}
+	} else {
+		len = xhtml_scan_name (p);
+		if (!len || len >= sizeof (name))
+			return 0;
+		memcpy (name, p, len);
+		name[len] = 0;
+		if (!xmlGetPredefinedEntity (BAD_CAST name) && !htmlEntityLookup (BAD_CAST name))
+			return 0;
+		p += len;
+	}
+
+	if (';' != *p)
+		return 0;
+
+	return p - start + 1;
+}
+
+static inline gboolean
+xhtml_name_equals (const gchar *name, gsize length, const gchar *tag)
+{
+	return (length == strlen (tag)) && !g_ascii_strncasecmp (name, tag, length);
+}
+
+/* Elements which are removed including their content */
+static gboolean
+xhtml_is_dhtml_element (const gchar *name, gsize length)
+{
+	return xhtml_name_equals (name, length, "script") ||
+	       xhtml_name_equals (name, length, "iframe") ||
+	       xhtml_name_equals (name, length, "meta");
+}
+
+/* Tags which are removed but whose content is kept */
+static gboolean
+xhtml_is_unsupported_element (const gchar *name, gsize length)
+{
+	return xhtml_name_equals (name, length, "wbr");
+}
+
+/* Event handler attributes like onload or onclick */
+static gboolean
+xhtml_is_event_handler (const gchar *name, gsize length)
+{
+	return (length > 2) && !g_ascii_strncasecmp (name, "on", 2);
+}
+
+/* Scans the start or end tag at p and appends the sanitized tag
+   to out unless it is to be removed. Returns the position after
+   the tag. */
+static const gchar *
+xhtml_sanitize_tag (const gchar *p, GString *out, GArray *stack, guint *skipDepth, guint flags, gboolean *valid)
+{
+	const gchar	*start = p, *mark, *name;
+	gsize		nameLength;
+	gboolean	closing, emit, drop, unsupported, space;
+	guint		i;
+
+	p++;
+	closing = ('/' == *p);
+	if (closing)
+		p++;
+	while (g_ascii_isspace (*p)) {
+		*valid = FALSE;
+		p++;
+	}
+
+	name = p;
+	nameLength = xhtml_scan_name (p);
+	if (!nameLength) {
+		/* a stray '<' which is kept as text */
+		*valid = FALSE;
+		if (!*skipDepth)
+			g_string_append_c (out, '<');
+		return start + 1;
+	}
+	p += nameLength;
+
+	drop = xhtml_is_dhtml_element (name, nameLength);
+	unsupported = (flags & XHTML_SANITIZE_STRIP_UNSUPPORTED) && xhtml_is_unsupported_element (name, nameLength);
+	emit = !*skipDepth && !drop && !unsupported;
+
+	if (closing) {
+		while (g_ascii_isspace (*p))
+			p++;
+		if ('>' != *p) {
+			*valid = FALSE;
+			while (*p && ('>' != *p))
+				p++;
+		}
+		if (*p)
+			p++;
+
+		/* Find the matching start tag. Unmatched end tags
+		   are kept when recovering and elements not closed
+		   are implicitly closed. */
+		for (i = stack->len; i > 0; i--) {
+			xhtmlTag *tag = &g_array_index (stack, xhtmlTag, i - 1);
+			if ((tag->length == nameLength) && !strncmp (tag->name, name, nameLength))
+				break;
+		}
+
+		if (0 == i) {
+			*valid = FALSE;
+		} else {
+			if (i != stack->len)
+				*valid = FALSE;
+			g_array_set_size (stack, i - 1);
+		}
+
+		if (emit)
+			g_string_append_len (out, start, p - start);
+		if (stack->len < *skipDepth)
+			*skipDepth = 0;
+
+		return p;
+	}
+
+	if (emit)
+		g_string_append_len (out, start, p - start);
+
+	/* attributes */
+	while (TRUE) {
+		const gchar	*attrName;
+		gsize		attrLength;
+
+		mark = p;
+		space = FALSE;
+		while (g_ascii_isspace (*p)) {
+			space = TRUE;
+			p++;
+		}
+
+		if (!*p) {
+			*valid = FALSE;
+			break;
+		}
+
+		if (('>' == *p) || (('/' == *p) && ('>' == *(p + 1)))) {
+			if ('/' == *p) {
+				p++;
+			} else {
+				xhtmlTag tag = { name, nameLength };
+				g_array_append_val (stack, tag);
+				if (drop && !*skipDepth)
+					*skipDepth = stack->len;
+			}
+			p++;
+			if (emit)
+				g_string_append_len (out, mark, p - mark);
+			break;
+		}
+
+		attrName = p;
+		attrLength = xhtml_scan_name (p);
+		if (!attrLength || !space) {
+			*valid = FALSE;
+			if (!attrLength) {
+				/* skip garbage inside the tag */
+				p++;
+				if (emit)
+					g_string_append_len (out, mark, p - mark);
+				continue;
+			}
+		}
+		p += attrLength;
+
+		while (g_ascii_isspace (*p))
+			p++;
+		if ('=' == *p) {
+			p++;
+			while (g_ascii_isspace (*p))
+				p++;
+			if (('"' == *p) || ('\'' == *p)) {
+				gchar quote = *p++;
+
+				while (*p && (quote != *p)) {
+					if ('&' == *p) {
+						gsize len = xhtml_scan_reference (p);
+						if (len) {
+							p += len;
+							continue;
+						}
+						*valid = FALSE;
+					} else if ('<' == *p) {
+						*valid = FALSE;
+					}
+					p++;
+				}
+				if (*p)
+					p++;
+				else
+					*valid = FALSE;
+			} else {
+				/* unquoted HTML attribute value */
+				*valid = FALSE;
+				while (*p && !g_ascii_isspace (*p) && ('>' != *p))
+					p++;
+			}
+		} else {
+			/* HTML attribute without value */
+			*valid = FALSE;
+		}
+
+		if (emit && !xhtml_is_event_handler (attrName, attrLength))
+			g_string_append_len (out, mark, p - mark);
+	}
+
+	return p;
+}
+
+/* Scans to the given terminator and appends everything
+   including the terminator to out. */
+static const gchar *
+xhtml_sanitize_section (const gchar *p, const gchar *terminator, GString *out, guint skipDepth, gboolean *valid)
+{
+	const gchar	*end;
+
+	end = strstr (p, terminator);
+	if (end) {
+		end += strlen (terminator);
+	} else {
+		*valid = FALSE;
+		end = p + strlen (p);
+	}
+
+	if (!skipDepth)
+		g_string_append_len (out, p, end - p);
+
+	return end;
+}
+
+gchar *
+xhtml_sanitize (const gchar *html, guint flags)
+{
+	GString		*out;
+	GArray		*stack;
+	const gchar	*p = html, *mark;
+	guint		skipDepth = 0;	/* stack depth of the element being removed (0 if none) */
+	gboolean	valid = TRUE;
+
+	if (!html)
+		return NULL;
+
+	out = g_string_sized_new (strlen (html));
+	stack = g_array_sized_new (FALSE, FALSE, sizeof (xhtmlTag), 16);
+
+	while (*p) {
+		/* Invalid content would be escaped anyway */
+		if (!valid && (flags & XHTML_SANITIZE_ESCAPE_INVALID))
+			break;
+
+		if ('&' == *p) {
+			gsize len = xhtml_scan_reference (p);
+			if (!len) {
+				valid = FALSE;
+				len = 1;
+			}
+			if (!skipDepth)
+				g_string_append_len (out, p, len);
+			p += len;
+		} else if ('<' != *p) {
+			mark = p;
+			while (*p && ('<' != *p) && ('&' != *p))
+				p++;
+			if (!skipDepth)
+				g_string_append_len (out, mark, p - mark);
+		} else if (g_str_has_prefix (p, "<!--")) {
+			p = xhtml_sanitize_section (p, "-->", out, skipDepth, &valid);
+		} else if (g_str_has_prefix (p, "<![CDATA[")) {
+			p = xhtml_sanitize_section (p, "]]>", out, skipDepth, &valid);
+		} else if (g_str_has_prefix (p, "<?")) {
+			p = xhtml_sanitize_section (p, "?>", out, skipDepth, &valid);
+		} else if ('!' == *(p + 1)) {
+			/* no DOCTYPE or other declarations in content */
+			valid = FALSE;
+			p = xhtml_sanitize_section (p, ">", out, skipDepth, &valid);
+		} else {
+			p = xhtml_sanitize_tag (p, out, stack, &skipDepth, flags, &valid);
+		}
+	}
+
+	if (stack->len > 0)
+		valid = FALSE;
+	g_array_free (stack, TRUE);
+
+	if (!valid && (flags & XHTML_SANITIZE_ESCAPE_INVALID)) {
+		debug1 (DEBUG_PARSING, "not well formed HTML: %s", html);
+		g_string_free (out, TRUE);
+		return g_markup_escape_text (html, -1);
+	}
+
+	return g_string_free (out, FALSE);
+}
+
 typedef struct {
 	gchar	*data;
 	gint	length;
@@ -424,6 +779,7 @@ xml_buffer_parse_error (void *ctxt, const gchar * msg, ...)
 }
 
 static xmlDocPtr entities = NULL;
+G_LOCK_DEFINE_STATIC (entities);
 
 static xmlEntityPtr
 xml_process_entities (void *ctxt, const xmlChar *name)
@@ -433,12 +789,15 @@ xml_process_entities (void *ctxt, const xmlChar *name)
 	
 	entity = xmlGetPredefinedEntity (name);
 	if (!entity) {
+		/* parsing might happen in the update worker threads */
+		G_LOCK (entities);
 		if(!entities) {
 			/* loading HTML entities from external DTD file */
 			entities = xmlNewDoc (BAD_CAST "1.0");
 			xmlCreateIntSubset (entities, BAD_CAST "HTML entities", NULL, PACKAGE_DATA_DIR "/" PACKAGE "/dtd/html.ent");
 			entities->extSubset = xmlParseDTD (entities->intSubset->ExternalID, entities->intSubset->SystemID);
 		}
+		G_UNLOCK (entities);
 		
 		if (NULL != (found = xmlGetDocEntity (entities, name))) {
 			/* returning as faked predefined entity... */
@@ -550,6 +909,149 @@ xml_parse (gchar *data, size_t length, errorCtxtPtr errCtx)
 	return doc;
 }
 
+/* streaming parser */
+
+#define XML_STREAM_CHUNK_SIZE	65536
+
+struct xmlStreamParser {
+	xmlParserCtxtPtr	ctxt;		/**< libxml2 push parser context (created with the first chunk) */
+	xmlSAXHandler		sax;		/**< SAX2 tree builder with element hook */
+	xmlStreamElementFunc	func;		/**< element callback */
+	gpointer		user_data;	/**< element callback user data */
+	GDestroyNotify		destroy;	/**< user data destroy function (or NULL) */
+	struct errorCtxt	errors;		/**< errors collected while pushing */
+	gboolean		finished;	/**< TRUE if the document was terminated */
+};
+
+static void
+xml_stream_parser_end_element (void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI)
+{
+	xmlParserCtxtPtr	ctxt = (xmlParserCtxtPtr)ctx;
+	xmlStreamParserPtr	parser = (xmlStreamParserPtr)ctxt->_private;
+	xmlNodePtr		cur = ctxt->node;
+
+	xmlSAX2EndElementNs (ctx, localname, prefix, URI);
+
+	/* The root element is never passed as it has to
+	   survive for the remaining document. */
+	if (!cur || !cur->parent || cur->parent->type != XML_ELEMENT_NODE)
+		return;
+
+	if ((*parser->func) (cur, parser->user_data)) {
+		xmlUnlinkNode (cur);
+		xmlFreeNode (cur);
+	}
+}
+
+xmlStreamParserPtr
+xml_stream_parser_new (xmlStreamElementFunc func, gpointer user_data, GDestroyNotify destroy)
+{
+	xmlStreamParserPtr	parser;
+
+	g_assert (NULL != func);
+
+	parser = g_new0 (struct xmlStreamParser, 1);
+	parser->func = func;
+	parser->user_data = user_data;
+	parser->destroy = destroy;
+	parser->errors.msg = g_string_new (NULL);
+
+	xmlSAXVersion (&parser->sax, 2);
+	parser->sax.getEntity = xml_process_entities;
+	parser->sax.endElementNs = xml_stream_parser_end_element;
+
+	return parser;
+}
+
+gboolean
+xml_stream_parser_push (xmlStreamParserPtr parser, const gchar *data, gsize length)
+{
+	gsize	offset = 0, chunk;
+	gint	result = 0;
+
+	if (parser->finished)
+		return FALSE;
+
+	xmlSetGenericErrorFunc (&parser->errors, (xmlGenericErrorFunc)xml_buffer_parse_error);
+
+	if (!parser->ctxt) {
+		/* libxml2 needs the first bytes to detect the encoding */
+		offset = MIN (length, 4);
+		parser->ctxt = xmlCreatePushParserCtxt (&parser->sax, NULL, data, offset, NULL);
+		if (parser->ctxt)
+			parser->ctxt->_private = parser;
+		else
+			result = -1;
+	}
+
+	/* libxml2 copies each chunk into its input buffer before
+	   parsing it, so large buffers are passed in pieces */
+	while ((0 == result) && (offset < length)) {
+		chunk = MIN (length - offset, XML_STREAM_CHUNK_SIZE);
+		result = xmlParseChunk (parser->ctxt, data + offset, chunk, 0);
+		offset += chunk;
+	}
+
+	/* reset the errorfunc like xml_parse() does */
+	xmlSetGenericErrorFunc (NULL, NULL);
+
+	return (0 == result);
+}
+
+xmlDocPtr
+xml_stream_parser_finish (xmlStreamParserPtr parser, errorCtxtPtr errors)
+{
+	xmlDocPtr	doc = NULL;
+
+	if (parser->ctxt && !parser->finished) {
+		xmlSetGenericErrorFunc (&parser->errors, (xmlGenericErrorFunc)xml_buffer_parse_error);
+		xmlParseChunk (parser->ctxt, NULL, 0, 1);
+		xmlSetGenericErrorFunc (NULL, NULL);
+
+		doc = parser->ctxt->myDoc;
+		parser->ctxt->myDoc = NULL;
+
+		/* Like xml_parse() we do not return broken documents */
+		if (doc && !parser->ctxt->wellFormed) {
+			xmlFreeDoc (doc);
+			doc = NULL;
+		}
+	}
+	parser->finished = TRUE;
+
+	if (errors) {
+		g_string_append (errors->msg, parser->errors.msg->str);
+		errors->errorCount += parser->errors.errorCount;
+	}
+
+	return doc;
+}
+
+gpointer
+xml_stream_parser_get_user_data (xmlStreamParserPtr parser)
+{
+	return parser->user_data;
+}
+
+void
+xml_stream_parser_free (xmlStreamParserPtr parser)
+{
+	if (!parser)
+		return;
+
+	if (parser->ctxt) {
+		if (parser->ctxt->myDoc)
+			xmlFreeDoc (parser->ctxt->myDoc);
+		xmlFreeParserCtxt (parser->ctxt);
+	}
+
+	if (parser->destroy)
+		(*parser->destroy) (parser->user_data);
+
+	g_string_free (parser->errors.msg, TRUE);
+	g_free (parser);
+}
+
 xmlDocPtr
 xml_parse_feed (feedParserCtxtPtr fpc)
 {
@@ -569,8 +1071,25 @@ xml_parse_feed (feedParserCtxtPtr fpc)
 
 	errors = g_new0 (struct errorCtxt, 1);
 	errors->msg = fpc->feed->parseErrors;
-	
-	fpc->doc = xml_parse (fpc->data, (size_t)fpc->dataLength, errors);
+
+	if (fpc->result && fpc->result->parsed) {
+		/* the update parse stage already did the work, the
+		   document stays owned (and is freed) by the result */
+		fpc->doc = fpc->result->doc;
+		if (fpc->result->parseErrors)
+			g_string_append (fpc->feed->parseErrors, fpc->result->parseErrors->str);
+		errors->errorCount = fpc->result->parseErrorCount;
+	} else {
+		xmlStreamParserPtr	stream;
+
+		/* Use the streaming parser so that items are collected
+		   and dropped from the DOM while parsing */
+		stream = feed_parser_stream_new (fpc, FALSE);
+		xml_stream_parser_push (stream, fpc->data, fpc->dataLength);
+		fpc->doc = xml_stream_parser_finish (stream, errors);
+		xml_stream_parser_free (stream);
+	}
+
 	if (!fpc->doc) {
 		debug1 (DEBUG_PARSING, "xml_parse_feed(): could not parse feed \"%s\"!", fpc->subscription->node->title);
 		g_string_prepend (fpc->feed->parseErrors, _("XML Parser: Could not parse document:\n"));
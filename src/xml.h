@@ -69,6 +69,8 @@ gchar * xhtml_extract (xmlNodePtr cur, gint xhtmlMode, const gchar *defaultBase)
 
 /**
  * Strips some DHTML constructs from the given HTML string.
+ * Superseded by xhtml_sanitize() and kept as the reference
+ * for sanitize_benchmark.c. Not thread safe.
  *
  * @param html	some HTML content
  *
@@ -86,6 +88,29 @@ gchar * xhtml_strip_dhtml (const gchar *html);
  */
 gchar * xhtml_strip_unsupported_tags (const gchar *html);
 
+/** flags for xhtml_sanitize() */
+typedef enum {
+	XHTML_SANITIZE_ESCAPE_INVALID		= (1<<0),	/**< escape content that is not well formed */
+	XHTML_SANITIZE_STRIP_UNSUPPORTED	= (1<<1)	/**< also strip tags we cannot render */
+} xhtmlSanitizeFlags;
+
+/**
+ * Checks the given XHTML fragment for well formedness and
+ * strips DHTML (script, iframe and meta elements and event
+ * handler attributes) in a single scan. This replaces
+ * xhtml_is_well_formed() followed by xhtml_strip_dhtml().
+ *
+ * Content which is not well formed is escaped when
+ * XHTML_SANITIZE_ESCAPE_INVALID is given, otherwise the
+ * stripping is done as good as possible.
+ *
+ * @param html	some XHTML content
+ * @param flags	xhtmlSanitizeFlags
+ *
+ * @return newly allocated sanitized string
+ */
+gchar * xhtml_sanitize (const gchar *html, guint flags);
+
 /**
  * Convert the given string to proper XHTML content.
  * Note: this function does not respect relative URLs
@@ -186,4 +211,71 @@ xmlDocPtr xml_parse (gchar *data, size_t length, errorCtxtPtr errors);
  */
 xmlDocPtr xml_parse_feed (feedParserCtxtPtr fpc);
 
+/**
+ * Function type called by the streaming parser for each element
+ * that was completely parsed. The element is still linked into
+ * the document which allows to inspect its parents.
+ *
+ * @param cur		the completed element
+ * @param user_data	user data passed to xml_stream_parser_new()
+ *
+ * @returns TRUE if the element was consumed and can be dropped from the document
+ */
+typedef gboolean (*xmlStreamElementFunc)(xmlNodePtr cur, gpointer user_data);
+
+typedef struct xmlStreamParser *xmlStreamParserPtr;
+
+/**
+ * Creates a push parser which builds a DOM from incrementally
+ * passed data. Completed elements are passed to the given function
+ * which can consume them to keep the document small.
+ *
+ * @param func		element callback
+ * @param user_data	element callback user data
+ * @param destroy	function to free the user data with the parser (or NULL)
+ *
+ * @returns a new streaming parser (to be free'd using xml_stream_parser_free())
+ */
+xmlStreamParserPtr xml_stream_parser_new (xmlStreamElementFunc func, gpointer user_data, GDestroyNotify destroy);
+
+/**
+ * Passes the next chunk of a document to the streaming parser.
+ * Large chunks are passed on to libxml2 in pieces.
+ *
+ * @param parser	the streaming parser
+ * @param data		document chunk
+ * @param length	length of the chunk
+ *
+ * @returns FALSE if the parser stopped because of a fatal error
+ */
+gboolean xml_stream_parser_push (xmlStreamParserPtr parser, const gchar *data, gsize length);
+
+/**
+ * Terminates the document and returns what is left of it
+ * after the element callback consumed elements.
+ *
+ * @param parser	the streaming parser
+ * @param errors	parser error context to add the errors to (can be NULL)
+ *
+ * @returns XML document (or NULL if the document could not be read)
+ */
+xmlDocPtr xml_stream_parser_finish (xmlStreamParserPtr parser, errorCtxtPtr errors);
+
+/**
+ * Returns the user data passed to xml_stream_parser_new().
+ *
+ * @param parser	the streaming parser
+ *
+ * @returns user data
+ */
+gpointer xml_stream_parser_get_user_data (xmlStreamParserPtr parser);
+
+/**
+ * Frees the streaming parser and its user data if a
+ * destroy function was given.
+ *
+ * @param parser	the streaming parser (can be NULL)
+ */
+void xml_stream_parser_free (xmlStreamParserPtr parser);
+
 #endif
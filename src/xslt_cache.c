@@ -0,0 +1,168 @@
+/**
+ * @file xslt_cache.c  compiled XSLT stylesheet cache
+ *
+ * Copyright (C) 2011 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "xslt_cache.h"
+
+#include <glib/gstdio.h>
+#include <libxslt/xslt.h>
+
+#include "debug.h"
+
+/** a cached compiled stylesheet */
+typedef struct xsltCacheEntry {
+	gchar			*filename;	/**< the stylesheet source file */
+	xsltStylesheetPtr	xslt;		/**< the compiled stylesheet */
+	time_t			mtime;		/**< source file modification time when compiled */
+	guint			refCount;	/**< number of users, including the cache itself while not outdated */
+} *xsltCacheEntryPtr;
+
+G_LOCK_DEFINE_STATIC (xsltCache);
+
+/** file name to entry hash of all up-to-date stylesheets */
+static GHashTable	*byFilename = NULL;
+
+/** stylesheet to entry hash of all stylesheets still referenced */
+static GHashTable	*byStylesheet = NULL;
+
+/* to be called with the cache lock held */
+static void
+xslt_cache_entry_unref (xsltCacheEntryPtr entry)
+{
+	g_assert (entry->refCount > 0);
+
+	if (--entry->refCount > 0)
+		return;
+
+	debug1 (DEBUG_HTML, "freeing stylesheet \"%s\"", entry->filename);
+	g_hash_table_remove (byStylesheet, entry->xslt);
+	xsltFreeStylesheet (entry->xslt);
+	g_free (entry->filename);
+	g_free (entry);
+}
+
+/* to be called with the cache lock held */
+static void
+xslt_cache_entry_outdate (xsltCacheEntryPtr entry)
+{
+	g_hash_table_remove (byFilename, entry->filename);
+	xslt_cache_entry_unref (entry);
+}
+
+static time_t
+xslt_cache_get_mtime (const gchar *filename)
+{
+	struct stat	st;
+
+	if (0 != g_stat (filename, &st))
+		return 0;
+
+	return st.st_mtime;
+}
+
+xsltStylesheetPtr
+xslt_cache_get (const gchar *filename, xsltCacheLoadFunc loadFunc, gpointer user_data)
+{
+	xsltCacheEntryPtr	entry;
+	xsltStylesheetPtr	xslt;
+	time_t			mtime;
+
+	mtime = xslt_cache_get_mtime (filename);
+
+	G_LOCK (xsltCache);
+
+	if (!byFilename) {
+		byFilename = g_hash_table_new (g_str_hash, g_str_equal);
+		byStylesheet = g_hash_table_new (g_direct_hash, g_direct_equal);
+	}
+
+	entry = g_hash_table_lookup (byFilename, filename);
+	if (entry && entry->mtime != mtime) {
+		debug1 (DEBUG_HTML, "stylesheet \"%s\" was modified, reloading it", filename);
+		xslt_cache_entry_outdate (entry);
+		entry = NULL;
+	}
+
+	if (!entry) {
+		/* Compiling is done with the lock held so that
+		   concurrent users do not load the same file twice. */
+		if (loadFunc)
+			xslt = (*loadFunc) (filename, user_data);
+		else
+			xslt = xsltParseStylesheetFile (BAD_CAST filename);
+
+		if (!xslt) {
+			G_UNLOCK (xsltCache);
+			return NULL;
+		}
+
+		debug1 (DEBUG_HTML, "caching stylesheet \"%s\"", filename);
+		entry = g_new0 (struct xsltCacheEntry, 1);
+		entry->filename = g_strdup (filename);
+		entry->xslt = xslt;
+		entry->mtime = mtime;
+		entry->refCount = 1;
+		g_hash_table_insert (byFilename, entry->filename, entry);
+		g_hash_table_insert (byStylesheet, entry->xslt, entry);
+	}
+
+	entry->refCount++;
+	xslt = entry->xslt;
+
+	G_UNLOCK (xsltCache);
+
+	return xslt;
+}
+
+void
+xslt_cache_release (xsltStylesheetPtr xslt)
+{
+	xsltCacheEntryPtr	entry;
+
+	if (!xslt)
+		return;
+
+	G_LOCK (xsltCache);
+
+	entry = byStylesheet?g_hash_table_lookup (byStylesheet, xslt):NULL;
+	if (entry)
+		xslt_cache_entry_unref (entry);
+	else
+		g_warning ("xslt_cache_release(): unknown stylesheet!");
+
+	G_UNLOCK (xsltCache);
+}
+
+static gboolean
+xslt_cache_outdate_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	xslt_cache_entry_unref ((xsltCacheEntryPtr)value);
+	return TRUE;
+}
+
+void
+xslt_cache_free (void)
+{
+	G_LOCK (xsltCache);
+
+	if (byFilename)
+		g_hash_table_foreach_remove (byFilename, xslt_cache_outdate_cb, NULL);
+
+	G_UNLOCK (xsltCache);
+}
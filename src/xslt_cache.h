@@ -0,0 +1,71 @@
+/**
+ * @file xslt_cache.h  compiled XSLT stylesheet cache
+ *
+ * Copyright (C) 2011 Lars Lindner <lars.lindner@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+ 
+#ifndef _XSLT_CACHE_H
+#define _XSLT_CACHE_H
+
+#include <glib.h>
+#include <libxslt/xsltInternals.h>
+
+/* Compiled stylesheets are read-only once parsed and can be
+   applied by several threads at once. The cache hands out
+   referenced stylesheets keyed by their source file name and
+   reloads them when the modification time of the file changes.
+   Outdated stylesheets are freed when their last user releases
+   them. The cache may be used from any thread. */
+
+/**
+ * Callback to compile the stylesheet for a given source file.
+ *
+ * @param filename	the stylesheet source file
+ * @param user_data	user data passed to xslt_cache_get()
+ *
+ * @returns a new stylesheet or NULL on errors
+ */
+typedef xsltStylesheetPtr (*xsltCacheLoadFunc) (const gchar *filename, gpointer user_data);
+
+/**
+ * Returns the compiled stylesheet for the given source file. When
+ * not yet cached or if the file was modified since it was compiled
+ * the stylesheet is (re)loaded.
+ *
+ * @param filename	the stylesheet source file
+ * @param loadFunc	custom compile callback or NULL to parse the file as XSLT
+ * @param user_data	user data for loadFunc
+ *
+ * @returns a referenced stylesheet (to be released using
+ * xslt_cache_release()) or NULL if it could not be loaded
+ */
+xsltStylesheetPtr xslt_cache_get (const gchar *filename, xsltCacheLoadFunc loadFunc, gpointer user_data);
+
+/**
+ * Releases a stylesheet returned by xslt_cache_get().
+ *
+ * @param xslt		the stylesheet
+ */
+void xslt_cache_release (xsltStylesheetPtr xslt);
+
+/**
+ * Drops all cached stylesheets. Stylesheets still in
+ * use are freed on their last release.
+ */
+void xslt_cache_free (void);
+
+#endif